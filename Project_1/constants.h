@@ -1,4 +1,7 @@
 #define MAX_RESERVATION_SIZE 256
 #define STATE_ACCESS_DELAY_MS 10
+#define OPTIMISTIC_RETRIES 3
+#define INSERTION_SORT_MAX_SEATS 32
+#define RADIX_BITS 8
 
 #define BARRIER_EXIT 2
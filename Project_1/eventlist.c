@@ -38,7 +38,6 @@ static void free_event(struct Event* event) {
   if (!event) return;
 
   for (size_t i = 0; i < event->rows * event->cols; i++) {
-    pthread_rwlock_destroy(&event->data[i].lock);
     free(event->data[i].reservation_id);
   }
 
@@ -6,18 +6,18 @@
 
 struct Seat {
   unsigned int* reservation_id;  /// Reservation ID for the seat
-  pthread_rwlock_t lock;         /// Read-write lock for the seat
 };
 
 struct Event {
   unsigned int id;               /// Event id
   unsigned int reservations;     /// Number of reservations for the event.
+  unsigned int version;          /// Incremented before and after each reservation, odd while seats change.
 
   size_t cols;                   /// Number of columns.
   size_t rows;                   /// Number of rows.
 
   struct Seat* data;             /// Array of size rows * cols with the seats.
-  pthread_mutex_t lock;          /// Read-write lock for the event
+  pthread_mutex_t lock;          /// Mutex held to change the seats of the event
 };
 
 struct ListNode {
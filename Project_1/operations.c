@@ -4,6 +4,7 @@
 #include <time.h>
 #include <pthread.h>
 
+#include "constants.h"
 #include "eventlist.h"
 #include "operations.h"
 #include "fileOperations.h"
@@ -103,6 +104,7 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   event->rows = num_rows;
   event->cols = num_cols;
   event->reservations = 0;
+  event->version = 0;
   event->data = malloc(num_rows * num_cols * sizeof(struct Seat));
   pthread_mutex_init(&event->lock, NULL);
 
@@ -119,7 +121,6 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
       return 1;
     }
     *(event->data[i].reservation_id) = 0;
-    pthread_rwlock_init(&event->data[i].lock, NULL);
   }
 
   pthread_rwlock_wrlock(&rwl_create);
@@ -127,7 +128,6 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   if (append_to_list(event_list, event) != 0) {
     fprintf(stderr, "Error appending event to list\n");
     for (size_t i = 0; i < event->rows * event->cols; i++) {
-      pthread_rwlock_destroy(&event->data[i].lock);
       free(event->data[i].reservation_id);
     }
     pthread_mutex_destroy(&event->lock);
@@ -140,23 +140,84 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   return 0;
 }
 
-void sort_seats(size_t x[], size_t y[], size_t num_seats) {
-  for (size_t i = 0; i < num_seats - 1; i++) {
-    for (size_t j = 0; j < num_seats - i - 1; j++) {
-      if (x[j] > x[j + 1] || (x[j] == x[j + 1] && y[j] > y[j + 1])) {
-        // Swap x
-        size_t temp = x[j];
-        x[j] = x[j + 1];
-        x[j + 1] = temp;
+/// Sorts seat indexes with a least significant digit radix sort.
+/// @param indexes Array of seat indexes to sort.
+/// @param num_seats Number of seats.
+static void radix_sort_seats(size_t indexes[], size_t num_seats) {
+  size_t buffer[num_seats];
+  size_t *from = indexes, *to = buffer;
 
-        // Swap y
-        temp = y[j];
-        y[j] = y[j + 1];
-        y[j + 1] = temp;
+  size_t max_index = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    if (indexes[i] > max_index) max_index = indexes[i];
+  }
+
+  // Only the digits that some index uses are sorted on
+  for (size_t shift = 0; shift < sizeof(size_t) * 8 && (max_index >> shift) != 0; shift += RADIX_BITS) {
+    size_t counts[1 << RADIX_BITS] = {0};
+    for (size_t i = 0; i < num_seats; i++) {
+      counts[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++;
+    }
+
+    size_t position = 0;
+    for (size_t digit = 0; digit < (1 << RADIX_BITS); digit++) {
+      size_t count = counts[digit];
+      counts[digit] = position;
+      position += count;
+    }
+
+    for (size_t i = 0; i < num_seats; i++) {
+      to[counts[(from[i] >> shift) & ((1 << RADIX_BITS) - 1)]++] = from[i];
+    }
 
+    size_t *temp = from;
+    from = to;
+    to = temp;
+  }
+
+  if (from != indexes) {
+    memcpy(indexes, from, num_seats * sizeof(size_t));
+  }
+}
+
+int sort_seats(size_t indexes[], size_t num_seats) {
+  if (num_seats > INSERTION_SORT_MAX_SEATS) {
+    radix_sort_seats(indexes, num_seats);
+  } else {
+    for (size_t i = 1; i < num_seats; i++) {
+      size_t index = indexes[i];
+      size_t j = i;
+      for (; j > 0 && indexes[j - 1] > index; j--) {
+        indexes[j] = indexes[j - 1];
       }
+      indexes[j] = index;
     }
   }
+
+  // Repeated seats end up next to each other
+  for (size_t i = 1; i < num_seats; i++) {
+    if (indexes[i] == indexes[i - 1]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/// Assigns a new reservation to the given seats.
+/// @note The event lock must be held.
+/// @param event Event of the reservation.
+/// @param seats Seats of the reservation.
+/// @param num_seats Number of seats.
+static void commit_reservation(struct Event* event, struct Seat** seats, size_t num_seats) {
+  __atomic_store_n(&event->version, event->version + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  unsigned int reservation_id = ++event->reservations;
+  for (size_t i = 0; i < num_seats; i++) {
+    __atomic_store_n(seats[i]->reservation_id, reservation_id, __ATOMIC_RELAXED);
+  }
+
+  __atomic_store_n(&event->version, event->version + 1, __ATOMIC_RELEASE);
 }
 
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
@@ -175,52 +236,61 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys)
     return 1;
   }
 
-  sort_seats(xs, ys, num_seats);
-  struct Seat* reservation_seats[num_seats];
-
-  size_t i = 0;
-  for (; i < num_seats; i++) {
-    size_t row = xs[i];
-    size_t col = ys[i];
-
-    if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
+  // Seats are handled by their index, in ascending order
+  size_t indexes[num_seats];
+  for (size_t i = 0; i < num_seats; i++) {
+    if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
       fprintf(stderr, "Invalid seat\n");
-      break;
+      return 1;
     }
+    indexes[i] = seat_index(event, xs[i], ys[i]);
+  }
 
-    struct Seat* seat = get_seat_with_delay(event, seat_index(event, row, col));
+  if (sort_seats(indexes, num_seats) != 0) {
+    fprintf(stderr, "Repeated seat\n");
+    return 1;
+  }
 
-    pthread_rwlock_wrlock(&seat->lock);
+  struct Seat* reservation_seats[num_seats];
 
-    if (*seat->reservation_id != 0) {
-      fprintf(stderr, "Seat already reserved\n");
-      pthread_rwlock_unlock(&seat->lock);
-      break;
-    }
+  for (unsigned int attempt = 0;; attempt++) {
+    unsigned int version = __atomic_load_n(&event->version, __ATOMIC_ACQUIRE);
 
-    reservation_seats[i]=seat;
-  }
+    for (size_t i = 0; i < num_seats; i++) {
+      struct Seat* seat = get_seat_with_delay(event, indexes[i]);
 
-  // If the reservation was not successful, free the seats that were reserved.
-  if (i < num_seats) {
-    for (size_t j = 0; j < i; j++) {
-      struct Seat* seat = get_seat_with_delay(event, seat_index(event, xs[j], ys[j]));
-      pthread_rwlock_unlock(&seat->lock);
+      // Reserved seats are never freed, so a reserved seat fails the reservation even if read mid-commit
+      if (__atomic_load_n(seat->reservation_id, __ATOMIC_RELAXED) != 0) {
+        fprintf(stderr, "Seat already reserved\n");
+        return 1;
+      }
+      reservation_seats[i] = seat;
     }
-    return 1;
-  }
 
-  i = 0;
-  pthread_mutex_lock(&event->lock);                            
-  unsigned int reservation_id = ++event->reservations;
-  pthread_mutex_unlock(&event->lock);
+    pthread_mutex_lock(&event->lock);
+    // The version only changes with the lock held, so if it is the same the seats read are still free
+    int valid = event->version == version;
+
+    // After too many conflicts the seats read are checked again with the lock held, so the reservation cannot
+    // starve. They were already read with the delay, so the lock is only held for the check and the commit.
+    if (!valid && attempt >= OPTIMISTIC_RETRIES) {
+      for (size_t i = 0; i < num_seats; i++) {
+        if (*reservation_seats[i]->reservation_id != 0) {
+          pthread_mutex_unlock(&event->lock);
+          fprintf(stderr, "Seat already reserved\n");
+          return 1;
+        }
+      }
+      valid = 1;
+    }
 
-  for (; i < num_seats; i++) {
-    *reservation_seats[i]->reservation_id=reservation_id;
-    pthread_rwlock_unlock(&reservation_seats[i]->lock);
+    if (valid) {
+      commit_reservation(event, reservation_seats, num_seats);
+      pthread_mutex_unlock(&event->lock);
+      return 0;
+    }
+    pthread_mutex_unlock(&event->lock);
   }
-
-  return 0;
 }
 
 int ems_show(int fdOut, unsigned int event_id) {
@@ -239,42 +309,57 @@ int ems_show(int fdOut, unsigned int event_id) {
   }
 
   size_t nr_cols = event->cols; // To get the number of seats in a row
-  unsigned int *row = (unsigned int*)malloc(nr_cols * sizeof(unsigned int));
+  size_t nr_seats = event->rows * nr_cols;
+  unsigned int *seats = (unsigned int*)malloc(nr_seats * sizeof(unsigned int));
 
-  if (row == NULL) {
-    fprintf(stderr, "Memory allocation for row failed\n");
+  if (seats == NULL) {
+    fprintf(stderr, "Memory allocation for seats failed\n");
     return 1;
   }
 
-  char *char_buffer = (char *)malloc((event->rows * nr_cols * (UNS_INT_SIZE + 1) + 1 )* sizeof(char));
+  char *char_buffer = (char *)malloc((nr_seats * (UNS_INT_SIZE + 1) + 1 )* sizeof(char));
   if (char_buffer == NULL) {
     fprintf(stderr, "Memory allocation for char_buffer failed\n");
+    free(seats);
     return 1;
   }
-  char_buffer[0]=0;
+  for (unsigned int attempt = 0;; attempt++) {
+    // The seats are read without the lock, and read again if a reservation changed them meanwhile
+    unsigned int version = __atomic_load_n(&event->version, __ATOMIC_ACQUIRE);
+
+    for (size_t i = 1, k = 0; i <= event->rows; i++) {
+      for (size_t j = 1; j <= event->cols; j++) {
+        struct Seat* seat = get_seat_with_delay(event, seat_index(event, i, j));
+        seats[k++] = __atomic_load_n(seat->reservation_id, __ATOMIC_RELAXED);
+      }
+    }
 
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1, k = 0; j <= event->cols; j++) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (version % 2 == 0 && __atomic_load_n(&event->version, __ATOMIC_RELAXED) == version) {
+      break;
+    }
 
-      struct Seat* seat = get_seat_with_delay(event, seat_index(event, i, j));
-      pthread_rwlock_rdlock(&seat->lock);
-      row[k++] = *seat->reservation_id;
+    // After too many conflicts the seats, already read with the delay, are copied again with the lock held,
+    // so the show cannot starve and the lock is only held for the copy
+    if (attempt >= OPTIMISTIC_RETRIES) {
+      pthread_mutex_lock(&event->lock);
+      for (size_t k = 0; k < nr_seats; k++) {
+        seats[k] = *event->data[k].reservation_id;
+      }
+      pthread_mutex_unlock(&event->lock);
+      break;
     }
-    char *buffer = buffer_to_string(row, nr_cols, SHOW_KEY);
-    strcat(char_buffer,buffer);
-    free(buffer);
   }
 
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1; j <= event->cols; j++) {
-
-      struct Seat* seat = get_seat_with_delay(event, seat_index(event, i, j));
-      pthread_rwlock_unlock(&seat->lock);
-    }
+  char_buffer[0] = 0;
+  for (size_t i = 0; i < event->rows; i++) {
+    char *buffer = buffer_to_string(&seats[i * nr_cols], nr_cols, SHOW_KEY);
+    strcat(char_buffer, buffer);
+    free(buffer);
   }
 
   write_inFile(fdOut, char_buffer);
-  free(row);
+  free(seats);
   free(char_buffer);
   return 0;
 }
@@ -51,11 +51,11 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
 
-/// Sorts the seats in ascending order
-/// @param x Array of rows of the seats to reserve.
-/// @param y Array of columns of the seats to reserve.
+/// Sorts the indexes of the seats to reserve in ascending order.
+/// @param indexes Array of indexes of the seats to reserve.
 /// @param num_seats Number of seats to reserve.
-void sort_seats(size_t x[], size_t y[], size_t num_seats);
+/// @return 0 if the seats are all different, 1 if a seat is repeated.
+int sort_seats(size_t indexes[], size_t num_seats);
 
 /// Prints the given event.
 /// @param fd File descriptor to write in.
@@ -1,6 +1,7 @@
 #include "api.h"
 #include <fcntl.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -9,11 +10,14 @@
 #include <sys/stat.h>
 
 
+#include "common/encoding.h"
 #include "common/io.h"
 #include "common/constants.h"
+#include "common/watch.h"
 
 
 unsigned int active_session;
+int show_encoding = ENCODING_RAW;
 
 char req_path[MAX_FIFO_PATHNAME];
 char resp_path[MAX_FIFO_PATHNAME];
@@ -91,6 +95,13 @@ int ems_setup(char *req_pipe_path, char *resp_pipe_path, char const* server_pipe
   // Receives the session ID from the server
   if (parse_uns_int_pipe(resp_pipe, &active_session)) { return 1; }
 
+  // Negotiates a compact encoding for the SHOW responses
+  op = ENCODING;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, 1u << ENCODING_RLE)) { return 1; }
+  if (parse_int_pipe(resp_pipe, &show_encoding)) { return 1; }
+
   return 0;
 }
 
@@ -162,6 +173,284 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
   return returned_value;
 }
 
+int ems_hold(int out_fd, unsigned int hold_s, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+
+  // Makes the request
+  char op = HOLD;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, hold_s)) { return 1; }
+
+  // The rest of the request is the same as the one of a reservation
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+  if (print_size_t_pipe(req_pipe, num_seats)) { return 1; }
+  if (print_size_t_array_pipe(req_pipe, xs, num_seats)) { return 1; }
+  if (print_size_t_array_pipe(req_pipe, ys, num_seats)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return returned_value; }
+
+  unsigned int reservation_id;
+  if (parse_uns_int_pipe(resp_pipe, &reservation_id)) { return 1; }
+
+  char line[64];
+  int len = snprintf(line, sizeof(line), "Held as reservation %u\n", reservation_id);
+  if (len < 0 || (size_t)len >= sizeof(line)) { return 1; }
+
+  return print_str(out_fd, line);
+}
+
+/// Sends a request about an existing reservation and waits for its result.
+/// @param op Operation of the request.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the operation was successful, 1 otherwise.
+static int reservation_request(char op, unsigned int event_id, unsigned int reservation_id) {
+
+  // Makes the request
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, reservation_id)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+
+  return returned_value;
+}
+
+int ems_confirm(unsigned int event_id, unsigned int reservation_id) {
+  return reservation_request(CONFIRM, event_id, reservation_id);
+}
+
+int ems_release(unsigned int event_id, unsigned int reservation_id) {
+  return reservation_request(RELEASE, event_id, reservation_id);
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  return reservation_request(CANCEL, event_id, reservation_id);
+}
+
+int ems_reserve_multi(int out_fd, size_t num_events, unsigned int* event_ids, size_t* num_seats,
+                      size_t (*xs)[MAX_RESERVATION_SIZE], size_t (*ys)[MAX_RESERVATION_SIZE]) {
+
+  // Makes the request, a reservation request for each event
+  char op = RESERVE_MULTI;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_size_t_pipe(req_pipe, num_events)) { return 1; }
+
+  for (size_t i = 0; i < num_events; i++) {
+    if (print_uns_int_pipe(req_pipe, event_ids[i])) { return 1; }
+    if (print_size_t_pipe(req_pipe, num_seats[i])) { return 1; }
+    if (print_size_t_array_pipe(req_pipe, xs[i], num_seats[i])) { return 1; }
+    if (print_size_t_array_pipe(req_pipe, ys[i], num_seats[i])) { return 1; }
+  }
+
+  // Waits for response
+  int returned_value;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return returned_value; }
+
+  unsigned int reservation_ids[MAX_MULTI_EVENTS];
+  if (parse_uns_int_array_pipe(resp_pipe, reservation_ids, num_events)) { return 1; }
+
+  char line[32 + MAX_MULTI_EVENTS * (UNS_INT_SIZE + 1)];
+  int len = snprintf(line, sizeof(line), "Reservations:");
+  for (size_t i = 0; i < num_events && len >= 0 && (size_t)len < sizeof(line); i++) {
+    len += snprintf(line + len, sizeof(line) - (size_t)len, " %u", reservation_ids[i]);
+  }
+  if (len < 0 || (size_t)len + 1 >= sizeof(line)) { return 1; }
+  line[len++] = '\n';
+  line[len] = '\0';
+
+  return print_str(out_fd, line);
+}
+
+int ems_reserve_best(int out_fd, unsigned int event_id, size_t num_seats, int priority, size_t first_row,
+                     size_t last_row) {
+
+  // Makes the request
+  char op = RESERVE_BEST;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+
+  // Event id, the number of seats and the constraints on the rows
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+  if (print_size_t_pipe(req_pipe, num_seats)) { return 1; }
+  if (print_int_pipe(req_pipe, priority)) { return 1; }
+  size_t rows[2] = {first_row, last_row};
+  if (print_size_t_array_pipe(req_pipe, rows, 2)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return returned_value; }
+
+  unsigned int reservation_id;
+  size_t seat[2];
+  if (parse_uns_int_pipe(resp_pipe, &reservation_id)) { return 1; }
+  if (parse_size_t_array_pipe(resp_pipe, seat, 2)) { return 1; }
+
+  char line[128];
+  int len = snprintf(line, sizeof(line), "Reserved (%zu,%zu) to (%zu,%zu) as reservation %u\n",
+                     seat[0], seat[1], seat[0], seat[1] + num_seats - 1, reservation_id);
+  if (len < 0 || (size_t)len >= sizeof(line)) { return 1; }
+
+  return print_str(out_fd, line);
+}
+
+
+/// Receives the seats of a SHOW response in the encoding negotiated with the server.
+/// @param seats The array to store the seats in.
+/// @param num_seats The number of seats of the event.
+/// @return 0 if the seats were received successfully, 1 otherwise.
+static int parse_seats(unsigned int *seats, size_t num_seats) {
+
+  unsigned int encoding = ENCODING_RAW;
+  if (show_encoding != ENCODING_RAW) {
+    if (parse_uns_int_pipe(resp_pipe, &encoding)) { return 1; }
+  }
+
+  if (encoding == ENCODING_RAW) {
+    return parse_uns_int_array_pipe(resp_pipe, seats, num_seats) != 0;
+  }
+
+  if (encoding != ENCODING_RLE) {
+    fprintf(stderr, "Unknown encoding of the seats: %u\n", encoding);
+    return 1;
+  }
+
+  size_t encoded_size;
+  if (parse_size_t_pipe(resp_pipe, &encoded_size)) { return 1; }
+
+  // The size comes from the server, so it is checked before anything is allocated for it
+  if (encoded_size > rle_max_encoded_size(num_seats)) {
+    fprintf(stderr, "Invalid size of the encoded seats: %zu\n", encoded_size);
+    return 1;
+  }
+
+  unsigned char *encoded = (unsigned char*)malloc(encoded_size > 0 ? encoded_size : 1);
+  if (encoded == NULL) {
+    fprintf(stderr, "Failed to allocate memory for the encoded seats\n");
+    return 1;
+  }
+
+  int result = parse_bytes_pipe(resp_pipe, encoded, encoded_size) != 0;
+  if (!result && rle_decode_seats(encoded, encoded_size, seats, num_seats)) {
+    fprintf(stderr, "Invalid encoding of the seats\n");
+    result = 1;
+  }
+
+  free(encoded);
+  return result;
+}
+
+
+/// Receives the changes made to the seats of a SHOW while its chunks were sent, and applies them.
+/// @param seats The seats of the SHOW.
+/// @param num_rows Number of rows of the SHOW.
+/// @param num_cols Number of columns of the SHOW.
+/// @param num_changes The number of changes.
+/// @return 0 if the changes were received and applied successfully, 1 otherwise.
+static int apply_show_changes(unsigned int *seats, size_t num_rows, size_t num_cols, size_t num_changes) {
+
+  for (size_t i = 0; i < num_changes; i++) {
+    struct WatchDelta change;
+    if (parse_bytes_pipe(resp_pipe, &change, sizeof(change))) { return 1; }
+
+    if (change.row == 0 || change.row > num_rows || change.first_col == 0 || change.num_seats == 0 ||
+        change.first_col > num_cols || change.num_seats > num_cols - change.first_col + 1) {
+      fprintf(stderr, "Invalid change in the response\n");
+      return 1;
+    }
+
+    unsigned int *first = &seats[(change.row - 1) * num_cols + change.first_col - 1];
+    for (size_t j = 0; j < change.num_seats; j++) {
+      first[j] = change.reservation_id;
+    }
+  }
+  return 0;
+}
+
+
+/// Receives the seats of a SHOW response, a chunk of rows at a time, and writes them to the
+/// given file once the changes made while they were sent are applied to them.
+/// @param out_fd File descriptor to print the seats to.
+/// @return 0 if the seats were received successfully, 1 otherwise.
+static int receive_show_seats(int out_fd) {
+
+  size_t num_rows, num_cols;
+  if (parse_size_t_pipe(resp_pipe, &num_rows)) { return 1; }
+  if (parse_size_t_pipe(resp_pipe, &num_cols)) { return 1; }
+
+  if (num_cols > 0 && num_rows > SIZE_MAX / sizeof(unsigned int) / num_cols) {
+    fprintf(stderr, "Invalid number of seats in the response\n");
+    return 1;
+  }
+
+  // The server keeps a single chunk, so the seats are only consistent once they all arrived
+  unsigned int *seats = (unsigned int*)malloc(num_rows * num_cols * sizeof(unsigned int) + 1);
+  if (seats == NULL) {
+    fprintf(stderr, "Failed to allocate memory for the seats\n");
+    return 1;
+  }
+
+  int result = 0;
+  size_t num_changes = SHOW_RESTART;
+  while (!result && num_changes == SHOW_RESTART) {
+    size_t received_rows = 0;
+    while (!result && received_rows < num_rows) {
+      size_t chunk_rows;
+      result = parse_size_t_pipe(resp_pipe, &chunk_rows) != 0;
+
+      if (!result && (chunk_rows == 0 || chunk_rows > num_rows - received_rows)) {
+        fprintf(stderr, "Invalid number of rows in the response\n");
+        result = 1;
+      }
+      if (!result) {
+        result = parse_seats(seats + received_rows * num_cols, chunk_rows * num_cols);
+        received_rows += chunk_rows;
+      }
+    }
+
+    // The server sends the chunks again when it no longer knows what changed
+    if (!result) {
+      result = parse_size_t_pipe(resp_pipe, &num_changes) != 0;
+    }
+  }
+
+  if (!result) {
+    result = apply_show_changes(seats, num_rows, num_cols, num_changes);
+  }
+  if (!result) {
+    result = print_output_show(out_fd, num_rows, num_cols, seats);
+  }
+  free(seats);
+  return result;
+}
+
+
+/// Receives the response to a SHOW or SHOW_REGION request and writes the seats to
+/// the given file as each chunk of rows arrives.
+/// @param out_fd File descriptor to print the seats to.
+/// @return 0 if the response was received successfully, 1 otherwise.
+static int receive_show(int out_fd) {
+
+  // Waits for response
+  int returned_value; 
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+
+  if (returned_value) { // Writes the event to the output file only if the returned value is 0
+    return 0;
+  }
+
+  return receive_show_seats(out_fd);
+}
+
 
 int ems_show(int out_fd, unsigned int event_id) {
 
@@ -171,47 +460,350 @@ int ems_show(int out_fd, unsigned int event_id) {
   if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
   if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
 
+  return receive_show(out_fd);
+}
+
+int ems_multi_show(int out_fd, size_t num_events, unsigned int *event_ids) {
+
+  // Makes the request
+  char op = MULTI_SHOW;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_size_t_pipe(req_pipe, num_events)) { return 1; }
+  if (print_uns_int_array_pipe(req_pipe, event_ids, num_events)) { return 1; }
+
   // Waits for response
-  int returned_value; 
-  size_t num_rows, num_cols;
+  int returned_value;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return 1; }
+
+  // Each event comes as in a SHOW response, the ones not found are skipped
+  for (size_t i = 0; i < num_events; i++) {
+    if (receive_show(out_fd)) { return 1; }
+  }
+  return 0;
+}
+
+int ems_show_region(int out_fd, unsigned int event_id, size_t first_row, size_t first_col,
+                    size_t last_row, size_t last_col) {
+
+  // Makes the request
+  char op = SHOW_REGION;
+  size_t corners[4] = {first_row, first_col, last_row, last_col};
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+  if (print_size_t_array_pipe(req_pipe, corners, 4)) { return 1; }
+
+  return receive_show(out_fd);
+}
+
+/// Writes the version of an event to the given file.
+/// @param out_fd File descriptor to print the version to.
+/// @param event_id Id of the event.
+/// @param version Version of the event.
+/// @return 0 if the version was printed successfully, 1 otherwise.
+static int print_version(int out_fd, unsigned int event_id, unsigned int version) {
+
+  char line[64];
+  int len = snprintf(line, sizeof(line), "Event: %u (version %u)\n", event_id, version);
+  if (len < 0 || (size_t)len >= sizeof(line)) { return 1; }
+
+  return print_str(out_fd, line);
+}
+
+
+/// Writes a change to the seats of an event to the given file.
+/// @param out_fd File descriptor to print the change to.
+/// @param delta The change.
+/// @return 0 if the change was printed successfully, 1 otherwise.
+static int print_delta(int out_fd, const struct WatchDelta *delta) {
+
+  // Seats of a cancelled reservation are changed back to no reservation
+  char line[128];
+  int len;
+  if (delta->reservation_id == 0) {
+    len = snprintf(line, sizeof(line), "Event: %u (version %u) released: (%zu,%zu) to (%zu,%zu)\n",
+                   delta->event_id, delta->version, delta->row, delta->first_col,
+                   delta->row, delta->first_col + delta->num_seats - 1);
+  } else {
+    len = snprintf(line, sizeof(line), "Event: %u (version %u) reservation %u: (%zu,%zu) to (%zu,%zu)\n",
+                   delta->event_id, delta->version, delta->reservation_id, delta->row, delta->first_col,
+                   delta->row, delta->first_col + delta->num_seats - 1);
+  }
+  if (len < 0 || (size_t)len >= sizeof(line)) { return 1; }
+
+  return print_str(out_fd, line);
+}
+
+
+int ems_show_since(int out_fd, unsigned int event_id, unsigned int *version) {
+
+  // Makes the request
+  char op = SHOW_SINCE;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, *version)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  unsigned int result;
   if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return 0; }
+
+  if (parse_uns_int_pipe(resp_pipe, version)) { return 1; }
+  if (parse_uns_int_pipe(resp_pipe, &result)) { return 1; }
+  if (print_version(out_fd, event_id, *version)) { return 1; }
+
+  if (result == SINCE_SNAPSHOT) {
+    return receive_show_seats(out_fd);
+  }
 
-  if (!returned_value){ // Writes the event to the output file if the returned value is 0
-    if (parse_size_t_pipe(resp_pipe, &num_rows)) { return 1; }
-    if (parse_size_t_pipe(resp_pipe, &num_cols)) { return 1; }
+  size_t num_changes;
+  if (parse_size_t_pipe(resp_pipe, &num_changes)) { return 1; }
 
-    unsigned int seats[num_cols*num_rows];
-    if (parse_uns_int_array_pipe(resp_pipe, seats, num_cols * num_rows)) { return 1; }
-    if (print_output_show(out_fd, num_rows, num_cols, seats)) { return 1; }
+  for (size_t i = 0; i < num_changes; i++) {
+    struct WatchDelta change;
+    if (parse_bytes_pipe(resp_pipe, &change, sizeof(change))) { return 1; }
+    if (print_delta(out_fd, &change)) { return 1; }
   }
   return 0;
 }
 
-int ems_list_events(int out_fd) {
 
+int ems_watch(size_t num_events, unsigned int *event_ids) {
+
+  // Makes the request
+  char op = WATCH;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_size_t_pipe(req_pipe, num_events)) { return 1; }
+  if (print_uns_int_array_pipe(req_pipe, event_ids, num_events)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+
+  return returned_value;
+}
+
+
+/// Receives a record pushed to a watching client.
+/// @param out_fd File descriptor to print the record to, -1 to discard it.
+/// @param type Variable to store the type of the record.
+/// @param num_records Variable to store the number of snapshots and deltas received.
+/// @return 0 if the record was received successfully, 1 otherwise.
+static int receive_watch_record(int out_fd, unsigned char *type, size_t *num_records) {
+
+  *num_records = 0;
+  if (parse_bytes_pipe(resp_pipe, type, 1)) { return 1; }
+
+  if (*type == WATCH_DELTA) {
+    size_t num_deltas;
+    if (parse_size_t_pipe(resp_pipe, &num_deltas)) { return 1; }
+
+    for (size_t i = 0; i < num_deltas; i++) {
+      struct WatchDelta delta;
+      if (parse_bytes_pipe(resp_pipe, &delta, sizeof(delta))) { return 1; }
+      if (out_fd != -1 && print_delta(out_fd, &delta)) { return 1; }
+    }
+
+    *num_records = num_deltas;
+    return 0;
+  }
+
+  if (*type == WATCH_RESYNC) {
+    struct WatchResync resync;
+    if (parse_bytes_pipe(resp_pipe, &resync, sizeof(resync))) { return 1; }
+
+    size_t num_seats = resync.rows * resync.cols;
+    unsigned int *seats = alloc_pipe_buffer(num_seats);
+    if (seats == NULL) {
+      fprintf(stderr, "Failed to allocate memory for the seats\n");
+      return 1;
+    }
+
+    int result = parse_uns_int_array_pipe(resp_pipe, seats, num_seats) != 0;
+    if (!result && out_fd != -1) {
+      result = print_version(out_fd, resync.event_id, resync.version) ||
+               print_output_show(out_fd, resync.rows, resync.cols, seats);
+    }
+    free_pipe_buffer(seats, num_seats);
+
+    *num_records = 1;
+    return result;
+  }
+
+  if (*type == WATCH_END) {
+    return 0;
+  }
+
+  fprintf(stderr, "Unknown record pushed by the server: %u\n", *type);
+  return 1;
+}
+
+
+int ems_watch_next(int out_fd, size_t *num_records) {
+
+  unsigned char type;
+  if (receive_watch_record(out_fd, &type, num_records)) { return 1; }
+
+  // The watch only ends when the client asks for it
+  return type == WATCH_END;
+}
+
+
+int ems_unwatch(void) {
+
+  // Makes the request
+  char op = UNWATCH;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+
+  // The changes pushed before the request was received are discarded
+  unsigned char type;
+  size_t num_records;
+  do {
+    if (receive_watch_record(-1, &type, &num_records)) { return 1; }
+  } while (type != WATCH_END);
+
+  return 0;
+}
+
+
+int ems_free_count(int out_fd, unsigned int event_id) {
+
+  // Makes the request
+  char op = FREE_COUNT;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  size_t free_seats;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return 0; }
+  if (parse_size_t_pipe(resp_pipe, &free_seats)) { return 1; }
+
+  char line[64];
+  int len = snprintf(line, sizeof(line), "Free seats: %zu\n", free_seats);
+  if (len < 0 || (size_t)len >= sizeof(line)) { return 1; }
+
+  return print_str(out_fd, line);
+}
+
+
+int ems_row_availability(int out_fd, unsigned int event_id) {
+
+  // Makes the request
+  char op = ROW_AVAILABILITY;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, event_id)) { return 1; }
+
+  // Waits for response
+  int returned_value;
+  size_t num_rows;
+  if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return 0; }
+  if (parse_size_t_pipe(resp_pipe, &num_rows)) { return 1; }
+
+  size_t *row_free = (size_t*)malloc(num_rows * sizeof(size_t) + 1);
+  // "Free seats per row:", then a space and the count of each row, and a newline
+  size_t size = 20 + num_rows * (UNS_INT_SIZE * 2 + 1) + 2;
+  char *line = (char*)malloc(size);
+  if (row_free == NULL || line == NULL) {
+    fprintf(stderr, "Failed to allocate memory for the row availability\n");
+    free(row_free);
+    free(line);
+    return 1;
+  }
+
+  int result = parse_size_t_array_pipe(resp_pipe, row_free, num_rows) != 0;
+  if (!result) {
+    size_t len = (size_t)snprintf(line, size, "Free seats per row:");
+    for (size_t i = 0; i < num_rows; i++) {
+      len += (size_t)snprintf(line + len, size - len, " %zu", row_free[i]);
+    }
+    snprintf(line + len, size - len, "\n");
+    result = print_str(out_fd, line);
+  }
+
+  free(row_free);
+  free(line);
+  return result;
+}
+
+
+int ems_list_events_page(unsigned int *cursor, size_t page_size, unsigned int *event_ids,
+                         size_t *num_events, int *more) {
+
+  // Makes the request
   char op = LIST_EVENTS;
   if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
   if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
-  
-  int returned_value; 
-  size_t num_events;
+  if (print_uns_int_pipe(req_pipe, *cursor)) { return 1; }
+  if (print_size_t_pipe(req_pipe, page_size)) { return 1; }
+
+  // Waits for response
+  int returned_value;
   if (parse_int_pipe(resp_pipe, &returned_value)) { return 1; }
+  if (returned_value) { return 1; }
+
+  if (parse_size_t_pipe(resp_pipe, num_events)) { return 1; }
+  if (*num_events > page_size) {
+    fprintf(stderr, "Invalid number of events in the response\n");
+    return 1;
+  }
+  if (*num_events && parse_uns_int_array_pipe(resp_pipe, event_ids, *num_events)) { return 1; }
+  if (parse_int_pipe(resp_pipe, more)) { return 1; }
+
+  // The next page starts right after the last id of this one
+  if (*more) {
+    *cursor = event_ids[*num_events - 1] + 1;
+  }
+  return 0;
+}
+
+
+int ems_list_events(int out_fd) {
+
+  unsigned int event_ids[LIST_PAGE_SIZE];
+  unsigned int cursor = 0;
+  size_t num_events;
+  int more, first_page = 1;
 
-  if (returned_value == 0){ // Lists the events sent from the server to the output file
-    if (parse_size_t_pipe(resp_pipe, &num_events)) { return 1; }
+  // Only one page is kept in memory, however many events exist
+  do {
+    if (ems_list_events_page(&cursor, LIST_PAGE_SIZE, event_ids, &num_events, &more)) { return 1; }
 
-    if (num_events == 0){
+    if (first_page && num_events == 0) {
       if (print_str(out_fd, "No events\n")) { return 1; }
       return 0;
     }
+    first_page = 0;
 
-    unsigned int list_event_ids[num_events];
-    if (parse_uns_int_array_pipe(resp_pipe, list_event_ids, num_events)) { return 1; }
+    if (print_output_list(out_fd, num_events, event_ids)) { return 1; }
+  } while (more && num_events > 0);
 
-    if (print_output_list(out_fd, num_events,list_event_ids)) { return 1; }
-    return 0;
-  } 
-  return 1;
+  return 0;
+}
+
+
+int ems_snapshot() {
+
+  // Makes the request
+  char op = SNAPSHOT;
+  if (print_str_pipe(req_pipe, &op, 1)) { return 1; }
+  if (print_uns_int_pipe(req_pipe, active_session)) { return 1; }
+
+  // Waits for response
+  int return_value;
+  if (parse_int_pipe(resp_pipe, &return_value)) { return 1; }
+
+  return return_value;
 }
 
 
@@ -227,24 +819,25 @@ void addNullCharacters(char *str, size_t targetLength) {
 
 int print_output_list(int out_fd, size_t num_events, unsigned int *events) {
 
-  char* buffer_list = (char*)malloc((num_events*(8+UNS_INT_SIZE)+1)*sizeof(char));
+  // "Event: ", the id and a newline for each event
+  size_t size = num_events * (8 + UNS_INT_SIZE) + 1;
+  char* buffer_list = (char*)malloc(size * sizeof(char));
   if (buffer_list == NULL) {
     fprintf(stderr, "Failed to allocate memory for buffer_list\n");
     return 1;
   }
 
-  buffer_list[0]=0;
+  buffer_list[0] = 0;
 
-  for (size_t k = 0; k < num_events; k++){
-    strcat(buffer_list, "Event: ");
-    char *buffer = buffer_to_string(&events[k], 1, LIST_KEY);
-    strcat(buffer_list,buffer);
-    free(buffer);
+  // Written at the end of the buffer, instead of looking for it with strcat for every event
+  size_t len = 0;
+  for (size_t k = 0; k < num_events; k++) {
+    len += (size_t)snprintf(buffer_list + len, size - len, "Event: %u\n", events[k]);
   }
 
-  if (print_str(out_fd, buffer_list)) { return 1; }
+  int result = print_str(out_fd, buffer_list);
   free(buffer_list);
 
-  return 0;
+  return result;
 }
 
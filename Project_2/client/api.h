@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "common/constants.h"
+
 
 /// Connects to an EMS server.
 /// @param req_pipe_path Path to the name pipe to be created for requests.
@@ -30,17 +32,137 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
+/// Holds seats of the given event for a limited time and prints the id of the reservation of the hold.
+/// @param out_fd File descriptor to print the id to.
+/// @param hold_s Number of seconds the seats are held for.
+/// @param event_id Id of the event to hold the seats of.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(int out_fd, unsigned int hold_s, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
+
+/// Confirms a hold that has not expired, keeping its seats.
+/// @param event_id Id of the event of the hold.
+/// @param reservation_id Id of the reservation of the hold.
+/// @return 0 if the hold was confirmed successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int reservation_id);
+
+/// Releases a hold that has not expired, freeing its seats.
+/// @param event_id Id of the event of the hold.
+/// @param reservation_id Id of the reservation of the hold.
+/// @return 0 if the hold was released successfully, 1 otherwise.
+int ems_release(unsigned int event_id, unsigned int reservation_id);
+
+/// Cancels a reservation of the given event, freeing its seats.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Creates a reservation in each of several events, either all of them or none, and prints their ids.
+/// @param out_fd File descriptor to print the ids of the reservations to.
+/// @param num_events Number of events.
+/// @param event_ids Array of ids of the events.
+/// @param num_seats Array of the number of seats to reserve in each event.
+/// @param xs Arrays of rows of the seats to reserve in each event.
+/// @param ys Arrays of columns of the seats to reserve in each event.
+/// @return 0 if the reservations were created successfully, 1 otherwise.
+int ems_reserve_multi(int out_fd, size_t num_events, unsigned int* event_ids, size_t* num_seats,
+                      size_t (*xs)[MAX_RESERVATION_SIZE], size_t (*ys)[MAX_RESERVATION_SIZE]);
+
+/// Reserves consecutive free seats of a row chosen by the server and prints them.
+/// @param out_fd File descriptor to print the reserved seats to.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param priority Order in which the server searches the rows, a value of enum ROW_PRIORITY.
+/// @param first_row First row that may be chosen, 0 for the first row of the event.
+/// @param last_row Last row that may be chosen, 0 for the last row of the event.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(int out_fd, unsigned int event_id, size_t num_seats, int priority, size_t first_row,
+                     size_t last_row);
+
 /// Prints the given event to the given file.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
 int ems_show(int out_fd, unsigned int event_id);
 
-/// Prints all the events to the given file.
+/// Prints several events to the given file with a single request.
+/// @param out_fd File descriptor to print the events to.
+/// @param num_events Number of events to print.
+/// @param event_ids Ids of the events to print.
+/// @return 0 if the events were printed successfully, 1 otherwise.
+int ems_multi_show(int out_fd, size_t num_events, unsigned int *event_ids);
+
+/// Prints a rectangular region of the given event to the given file.
+/// @param out_fd File descriptor to print the region to.
+/// @param event_id Id of the event to print.
+/// @param first_row First row of the region.
+/// @param first_col First column of the region.
+/// @param last_row Last row of the region.
+/// @param last_col Last column of the region.
+/// @return 0 if the region was printed successfully, 1 otherwise.
+int ems_show_region(int out_fd, unsigned int event_id, size_t first_row, size_t first_col,
+                    size_t last_row, size_t last_col);
+
+/// Prints the changes made to the given event after the given version, or the whole
+/// event when the server no longer has all of them.
+/// @param out_fd File descriptor to print the changes to.
+/// @param event_id Id of the event to print.
+/// @param version Version of the event known by the client, updated to the current one.
+/// @return 0 if the changes were printed successfully, 1 otherwise.
+int ems_show_since(int out_fd, unsigned int event_id, unsigned int *version);
+
+/// Starts watching the changes of the given events. Until ems_unwatch is called,
+/// ems_watch_next is the only request that may be made besides ems_quit.
+/// @param num_events Number of events to watch.
+/// @param event_ids Ids of the events to watch.
+/// @return 0 if the events are being watched, 1 otherwise.
+int ems_watch(size_t num_events, unsigned int *event_ids);
+
+/// Waits for the next changes pushed by the server and prints them to the given file.
+/// A snapshot of each event comes first, and again whenever the client falls behind.
+/// @param out_fd File descriptor to print the changes to.
+/// @param num_records Variable to store the number of snapshots and deltas printed.
+/// @return 0 if the changes were printed successfully, 1 otherwise.
+int ems_watch_next(int out_fd, size_t *num_records);
+
+/// Stops watching events, discarding the changes that were not received yet.
+/// @return 0 in case of success, 1 otherwise.
+int ems_unwatch(void);
+
+/// Prints the number of seats of the given event without a reservation.
+/// @param out_fd File descriptor to print the count to.
+/// @param event_id Id of the event.
+/// @return 0 if the count was printed successfully, 1 otherwise.
+int ems_free_count(int out_fd, unsigned int event_id);
+
+/// Prints the number of seats without a reservation in each row of the given event.
+/// @param out_fd File descriptor to print the counts to.
+/// @param event_id Id of the event.
+/// @return 0 if the counts were printed successfully, 1 otherwise.
+int ems_row_availability(int out_fd, unsigned int event_id);
+
+/// Gets a page of the ids of the existing events, in increasing order.
+/// @param cursor Lowest id to be listed, updated to the first id of the next page.
+/// @param page_size Maximum number of ids to be listed.
+/// @param event_ids Array to store the ids in, with room for page_size ids.
+/// @param num_events Variable to store the number of ids listed.
+/// @param more Variable to store whether there are events after the page.
+/// @return 0 if the page was received successfully, 1 otherwise.
+int ems_list_events_page(unsigned int *cursor, size_t page_size, unsigned int *event_ids,
+                         size_t *num_events, int *more);
+
+/// Prints all the events to the given file, a page at a time.
 /// @param out_fd File descriptor to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int out_fd);
 
+/// Makes the server write every event to its snapshot file in the background.
+/// @return 0 if the snapshot was started successfully, 1 otherwise.
+int ems_snapshot();
+
 /// Modifies a string size by adding at its end a number of null characters ('\0').
 /// @param str The string to add the \0 to.
 /// @param targetLength The target length for the modified string.
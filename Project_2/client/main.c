@@ -48,9 +48,16 @@ int main(int argc, char* argv[]) {
   
   while (1) {
     unsigned int event_id;
-    size_t num_rows, num_columns, num_coords;
-    unsigned int delay = 0;
+    size_t num_rows, num_columns, num_coords, num_seats, first_row, last_row;
+    int priority;
+    unsigned int delay = 0, version, reservation_id, hold_s;
     size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    unsigned int multi_ids[MAX_MULTI_EVENTS];
+    size_t multi_seats[MAX_MULTI_EVENTS];
+    size_t multi_xs[MAX_MULTI_EVENTS][MAX_RESERVATION_SIZE], multi_ys[MAX_MULTI_EVENTS][MAX_RESERVATION_SIZE];
+    unsigned int event_ids[MAX_SHOW_EVENTS];
+    unsigned int watch_ids[MAX_WATCHED_EVENTS];
+    size_t num_events, num_records, received;
 
     switch (get_next(in_fd)) {
       case CMD_CREATE:
@@ -73,6 +80,68 @@ int main(int argc, char* argv[]) {
         if (ems_reserve(event_id, num_coords, xs, ys)) fprintf(stderr, "Failed to reserve seats\n");
         break;
 
+      case CMD_HOLD:
+        num_coords = parse_hold(in_fd, MAX_RESERVATION_SIZE, &hold_s, &event_id, xs, ys);
+
+        if (num_coords == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_hold(out_fd, hold_s, event_id, num_coords, xs, ys)) fprintf(stderr, "Failed to hold seats\n");
+        break;
+
+      case CMD_CONFIRM:
+        if (parse_cancel(in_fd, &event_id, &reservation_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_confirm(event_id, reservation_id)) fprintf(stderr, "Failed to confirm hold\n");
+        break;
+
+      case CMD_RELEASE:
+        if (parse_cancel(in_fd, &event_id, &reservation_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_release(event_id, reservation_id)) fprintf(stderr, "Failed to release hold\n");
+        break;
+
+      case CMD_CANCEL:
+        if (parse_cancel(in_fd, &event_id, &reservation_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_cancel(event_id, reservation_id)) fprintf(stderr, "Failed to cancel reservation\n");
+        break;
+
+      case CMD_RESERVE_MULTI:
+        num_events = parse_reserve_multi(in_fd, MAX_MULTI_EVENTS, multi_ids, multi_seats, multi_xs, multi_ys);
+
+        if (num_events == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_multi(out_fd, num_events, multi_ids, multi_seats, multi_xs, multi_ys)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
+      case CMD_RESERVE_BEST:
+        if (parse_reserve_best(in_fd, &event_id, &num_seats, &priority, &first_row, &last_row) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_best(out_fd, event_id, num_seats, priority, first_row, last_row)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
       case CMD_SHOW:
         if (parse_show(in_fd, &event_id) != 0) {
           fprintf(stderr, "Invalid command. See HELP for usage\n");
@@ -82,10 +151,85 @@ int main(int argc, char* argv[]) {
         if (ems_show(out_fd, event_id)) fprintf(stderr, "Failed to show event\n");
         break;
 
+      case CMD_SHOW_REGION:
+        if (parse_show_region(in_fd, &event_id, xs, ys) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_show_region(out_fd, event_id, xs[0], ys[0], xs[1], ys[1])) fprintf(stderr, "Failed to show event\n");
+        break;
+
+      case CMD_MULTI_SHOW:
+        num_events = parse_multi_show(in_fd, MAX_SHOW_EVENTS, event_ids);
+
+        if (num_events == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_multi_show(out_fd, num_events, event_ids)) fprintf(stderr, "Failed to show events\n");
+        break;
+
+      case CMD_SHOW_SINCE:
+        if (parse_show_since(in_fd, &event_id, &version) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_show_since(out_fd, event_id, &version)) fprintf(stderr, "Failed to show event\n");
+        break;
+
+      case CMD_FREE_COUNT:
+        if (parse_show(in_fd, &event_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_free_count(out_fd, event_id)) fprintf(stderr, "Failed to count the free seats\n");
+        break;
+
+      case CMD_ROW_AVAILABILITY:
+        if (parse_show(in_fd, &event_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_row_availability(out_fd, event_id)) fprintf(stderr, "Failed to count the free seats\n");
+        break;
+
       case CMD_LIST_EVENTS:
         if (ems_list_events(out_fd)) fprintf(stderr, "Failed to list events\n");
         break;
 
+      case CMD_SNAPSHOT:
+        if (ems_snapshot()) fprintf(stderr, "Failed to take a snapshot\n");
+        break;
+
+      case CMD_WATCH:
+        num_events = parse_watch(in_fd, &num_records, MAX_WATCHED_EVENTS, watch_ids);
+
+        if (num_events == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_watch(num_events, watch_ids)) {
+          fprintf(stderr, "Failed to watch events\n");
+          break;
+        }
+
+        // Prints the changes until the given number of snapshots and deltas is received
+        for (size_t printed = 0; printed < num_records; printed += received) {
+          if (ems_watch_next(out_fd, &received)) {
+            fprintf(stderr, "Failed to receive the changes\n");
+            break;
+          }
+        }
+
+        if (ems_unwatch()) fprintf(stderr, "Failed to stop watching events\n");
+        break;
+
       case CMD_WAIT:
         if (parse_wait(in_fd, &delay, NULL) == -1) {
             fprintf(stderr, "Invalid command. See HELP for usage\n");
@@ -107,8 +251,21 @@ int main(int argc, char* argv[]) {
             "Available commands:\n"
             "  CREATE <event_id> <num_rows> <num_columns>\n"
             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  RESERVE_MULTI <event_id> [(<x1>,<y1>) ...] <event_id> [(<x1>,<y1>) ...] ...\n"
+            "  RESERVE_BEST <event_id> <num_seats> <FRONT|BACK|CENTER> [<first_row> <last_row>]\n"
+            "  CANCEL <event_id> <reservation_id>\n"
+            "  HOLD <seconds> <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  CONFIRM <event_id> <reservation_id>\n"
+            "  RELEASE <event_id> <reservation_id>\n"
             "  SHOW <event_id>\n"
+            "  SHOW_REGION <event_id> (<x1>,<y1>) (<x2>,<y2>)\n"
+            "  SHOW_SINCE <event_id> <version>\n"
+            "  MULTI_SHOW <event_id> [<event_id> ...]\n"
+            "  FREE_COUNT <event_id>\n"
+            "  ROW_AVAILABILITY <event_id>\n"
             "  LIST\n"
+            "  SNAPSHOT\n"
+            "  WATCH <num_records> <event_id> [<event_id> ...]\n"
             "  WAIT <delay_ms>\n"
             "  HELP\n");
 
@@ -17,14 +17,32 @@ static void cleanup(int fd) {
 }
 
 enum Command get_next(int fd) {
-  char buf[16];
+  char buf[32];
   if (read(fd, buf, 1) != 1) {
     return EOC;
   }
 
   switch (buf[0]) {
     case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
+      if (read(fd, buf + 1, 6) != 6) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "CANCEL ", 7) == 0) {
+        return CMD_CANCEL;
+      }
+
+      if (strncmp(buf, "CONFIRM", 7) == 0) {
+        if (read(fd, buf + 7, 1) != 1 || buf[7] != ' ') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_CONFIRM;
+      }
+
+      if (strncmp(buf, "CREATE ", 7) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
@@ -32,20 +50,105 @@ enum Command get_next(int fd) {
       return CMD_CREATE;
 
     case 'R':
-      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
+      if (read(fd, buf + 1, 1) == 1 && buf[1] == 'O') {
+        if (read(fd, buf + 2, 15) != 15 || strncmp(buf, "ROW_AVAILABILITY ", 17) != 0) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_ROW_AVAILABILITY;
+      }
+
+      if (read(fd, buf + 2, 6) != 6) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "RELEASE ", 8) == 0) {
+        return CMD_RELEASE;
+      }
+
+      if (strncmp(buf, "RESERVE", 7) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (buf[7] == ' ') {
+        return CMD_RESERVE;
+      }
+
+      if (read(fd, buf + 8, 5) != 5) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "RESERVE_BEST ", 13) == 0) {
+        return CMD_RESERVE_BEST;
+      }
+
+      if (strncmp(buf, "RESERVE_MULTI", 13) != 0 || read(fd, buf + 13, 1) != 1 || buf[13] != ' ') {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_RESERVE_MULTI;
+
+    case 'F':
+      if (read(fd, buf + 1, 10) != 10 || strncmp(buf, "FREE_COUNT ", 11) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_RESERVE;
+      return CMD_FREE_COUNT;
 
     case 'S':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
+      if (read(fd, buf + 1, 3) != 3) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "SNAP", 4) == 0) {
+        if (read(fd, buf + 4, 4) != 4 || strncmp(buf, "SNAPSHOT", 8) != 0 ||
+            (read(fd, buf + 8, 1) != 0 && buf[8] != '\n')) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_SNAPSHOT;
+      }
+
+      if (read(fd, buf + 4, 1) != 1 || (strncmp(buf, "SHOW ", 5) != 0 && strncmp(buf, "SHOW_", 5) != 0)) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (buf[4] == ' ') {
+        return CMD_SHOW;
+      }
+
+      if (read(fd, buf + 5, 1) == 1 && buf[5] == 'S') {
+        if (read(fd, buf + 6, 5) != 5 || strncmp(buf, "SHOW_SINCE ", 11) != 0) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_SHOW_SINCE;
+      }
+
+      if (read(fd, buf + 6, 6) != 6 || strncmp(buf, "SHOW_REGION ", 12) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_SHOW_REGION;
+
+    case 'M':
+      if (read(fd, buf + 1, 10) != 10 || strncmp(buf, "MULTI_SHOW ", 11) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_SHOW;
+      return CMD_MULTI_SHOW;
 
     case 'L':
       if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
@@ -61,15 +164,38 @@ enum Command get_next(int fd) {
       return CMD_LIST_EVENTS;
 
     case 'W':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
+      if (read(fd, buf + 1, 4) != 4 || (strncmp(buf, "WAIT ", 5) != 0 && strncmp(buf, "WATCH", 5) != 0)) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (buf[2] == 'I') {
+        return CMD_WAIT;
+      }
+
+      if (read(fd, buf + 5, 1) != 1 || buf[5] != ' ') {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_WAIT;
+      return CMD_WATCH;
 
     case 'H':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
+      if (read(fd, buf + 1, 3) != 3) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "HOLD", 4) == 0) {
+        if (read(fd, buf + 4, 1) != 1 || buf[4] != ' ') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_HOLD;
+      }
+
+      if (strncmp(buf, "HELP", 4) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
@@ -119,7 +245,15 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+/// Parses the event ID and the list of coordinates of a reservation, up to the character after the list.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @param next Pointer to the variable to store the character after the list in.
+/// @return Number of coordinates read. 0 on failure.
+static size_t parse_event_seats(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys, char *next) {
   char ch;
 
   if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
@@ -170,7 +304,22 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
     return 0;
   }
 
-  if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+  if (read(fd, next, 1) != 1) {
+    *next = '\0';
+  }
+
+  return num_coords;
+}
+
+size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  size_t num_coords = parse_event_seats(fd, max, event_id, xs, ys, &ch);
+  if (num_coords == 0) {
+    return 0;
+  }
+
+  if (ch != '\n' && ch != '\0') {
     cleanup(fd);
     return 0;
   }
@@ -178,6 +327,123 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   return num_coords;
 }
 
+size_t parse_reserve_multi(int fd, size_t max_events, unsigned int *event_ids, size_t *num_seats,
+                           size_t (*xs)[MAX_RESERVATION_SIZE], size_t (*ys)[MAX_RESERVATION_SIZE]) {
+  char ch = ' ';
+
+  size_t num_events = 0;
+  while (ch == ' ') {
+    if (num_events == max_events) {
+      cleanup(fd);
+      return 0;
+    }
+
+    num_seats[num_events] = parse_event_seats(fd, MAX_RESERVATION_SIZE, &event_ids[num_events],
+                                              xs[num_events], ys[num_events], &ch);
+    if (num_seats[num_events] == 0) {
+      return 0;
+    }
+    num_events++;
+  }
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_events;
+}
+
+size_t parse_hold(int fd, size_t max, unsigned int *hold_s, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, hold_s, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return parse_reserve(fd, max, event_id, xs, ys);
+}
+
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  if (parse_uint(fd, reservation_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats, int *priority,
+                       size_t *first_row, size_t *last_row) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  unsigned int seats;
+  if (parse_uint(fd, &seats, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+  *num_seats = (size_t)seats;
+
+  char word[8];
+  size_t len = 0;
+  while (read(fd, &ch, 1) == 1 && ch != ' ' && ch != '\n') {
+    if (len == sizeof(word) - 1) {
+      cleanup(fd);
+      return 1;
+    }
+    word[len++] = ch;
+  }
+  word[len] = '\0';
+
+  if (strcmp(word, "FRONT") == 0) {
+    *priority = ROWS_FRONT;
+  } else if (strcmp(word, "BACK") == 0) {
+    *priority = ROWS_BACK;
+  } else if (strcmp(word, "CENTER") == 0) {
+    *priority = ROWS_CENTER;
+  } else {
+    if (ch != '\n') {
+      cleanup(fd);
+    }
+    return 1;
+  }
+
+  // The range of rows is optional, every row may be chosen without it
+  *first_row = 0;
+  *last_row = 0;
+  if (ch != ' ') {
+    return 0;
+  }
+
+  unsigned int row;
+  if (parse_uint(fd, &row, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+  *first_row = (size_t)row;
+
+  if (parse_uint(fd, &row, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+  *last_row = (size_t)row;
+
+  return 0;
+}
+
 int parse_show(int fd, unsigned int *event_id) {
   char ch;
 
@@ -189,6 +455,105 @@ int parse_show(int fd, unsigned int *event_id) {
   return 0;
 }
 
+int parse_show_since(int fd, unsigned int *event_id, unsigned int *version) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  if (parse_uint(fd, version, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_show_region(int fd, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  for (size_t i = 0; i < 2; i++) {
+    if (read(fd, &ch, 1) != 1 || ch != '(') {
+      cleanup(fd);
+      return 1;
+    }
+
+    unsigned int x;
+    if (parse_uint(fd, &x, &ch) != 0 || ch != ',') {
+      cleanup(fd);
+      return 1;
+    }
+    xs[i] = (size_t)x;
+
+    unsigned int y;
+    if (parse_uint(fd, &y, &ch) != 0 || ch != ')') {
+      cleanup(fd);
+      return 1;
+    }
+    ys[i] = (size_t)y;
+
+    // The corners are separated by a space and followed by the end of the line
+    if (read(fd, &ch, 1) != 1) {
+      ch = '\0';
+    }
+    if ((i == 0 && ch != ' ') || (i == 1 && ch != '\n' && ch != '\0')) {
+      cleanup(fd);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/// Parses a list of event IDs separated by spaces, up to the end of the line.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of event IDs to read.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @return Number of event IDs read. 0 on failure.
+static size_t parse_event_ids(int fd, size_t max, unsigned int *event_ids) {
+  char ch = ' ';
+
+  size_t num_events = 0;
+  while (ch == ' ') {
+    if (num_events == max || parse_uint(fd, &event_ids[num_events], &ch) != 0) {
+      cleanup(fd);
+      return 0;
+    }
+    num_events++;
+  }
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_events;
+}
+
+size_t parse_multi_show(int fd, size_t max, unsigned int *event_ids) {
+  return parse_event_ids(fd, max, event_ids);
+}
+
+size_t parse_watch(int fd, size_t *num_records, size_t max, unsigned int *event_ids) {
+  char ch;
+
+  unsigned int u_num_records;
+  if (parse_uint(fd, &u_num_records, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+  *num_records = (size_t)u_num_records;
+
+  return parse_event_ids(fd, max, event_ids);
+}
+
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
   char ch;
 
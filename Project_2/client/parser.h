@@ -3,12 +3,27 @@
 
 #include <stddef.h>
 
+#include "common/constants.h"
+
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
+  CMD_RESERVE_BEST,
+  CMD_RESERVE_MULTI,
+  CMD_CANCEL,
+  CMD_HOLD,
+  CMD_CONFIRM,
+  CMD_RELEASE,
   CMD_SHOW,
+  CMD_SHOW_REGION,
+  CMD_SHOW_SINCE,
+  CMD_MULTI_SHOW,
+  CMD_FREE_COUNT,
+  CMD_ROW_AVAILABILITY,
   CMD_LIST_EVENTS,
+  CMD_SNAPSHOT,
   CMD_WAIT,
+  CMD_WATCH,
   CMD_HELP,
   CMD_EMPTY,
   CMD_INVALID,
@@ -37,12 +52,81 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
 /// @return Number of coordinates read. 0 on failure.
 size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
 
+/// Parses a HOLD command, which is the duration of the hold followed by the arguments of a RESERVE.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param hold_s Pointer to the variable to store the duration of the hold in seconds in.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @return Number of coordinates read. 0 on failure.
+size_t parse_hold(int fd, size_t max, unsigned int *hold_s, unsigned int *event_id, size_t *xs, size_t *ys);
+
+/// Parses a CANCEL command, or a CONFIRM or RELEASE command, which have the same arguments.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id);
+
+/// Parses a RESERVE_MULTI command, which has the arguments of a RESERVE for each event.
+/// @param fd File descriptor to read from.
+/// @param max_events Maximum number of events to read.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @param num_seats Pointer to the array to store the number of coordinates of each event in.
+/// @param xs Pointer to the arrays to store the X coordinates of each event in.
+/// @param ys Pointer to the arrays to store the Y coordinates of each event in.
+/// @return Number of events read. 0 on failure.
+size_t parse_reserve_multi(int fd, size_t max_events, unsigned int *event_ids, size_t *num_seats,
+                           size_t (*xs)[MAX_RESERVATION_SIZE], size_t (*ys)[MAX_RESERVATION_SIZE]);
+
+/// Parses a RESERVE_BEST command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param num_seats Pointer to the variable to store the number of seats in.
+/// @param priority Pointer to the variable to store the order of the rows in.
+/// @param first_row Pointer to the variable to store the first row in, 0 if no range is given.
+/// @param last_row Pointer to the variable to store the last row in, 0 if no range is given.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats, int *priority,
+                       size_t *first_row, size_t *last_row);
+
 /// Parses a SHOW command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_show(int fd, unsigned int *event_id);
 
+/// Parses a SHOW_REGION command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param xs Pointer to the array to store the rows of the two corners of the region in.
+/// @param ys Pointer to the array to store the columns of the two corners of the region in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_show_region(int fd, unsigned int *event_id, size_t *xs, size_t *ys);
+
+/// Parses a SHOW_SINCE command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param version Pointer to the variable to store the version in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_show_since(int fd, unsigned int *event_id, unsigned int *version);
+
+/// Parses a MULTI_SHOW command.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of event IDs to read.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @return Number of event IDs read. 0 on failure.
+size_t parse_multi_show(int fd, size_t max, unsigned int *event_ids);
+
+/// Parses a WATCH command.
+/// @param fd File descriptor to read from.
+/// @param num_records Pointer to the variable to store the number of records to wait for in.
+/// @param max Maximum number of event IDs to read.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @return Number of event IDs read. 0 on failure.
+size_t parse_watch(int fd, size_t *num_records, size_t max, unsigned int *event_ids);
+
 /// Parses a WAIT command.
 /// @param fd File descriptor to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
@@ -14,6 +14,24 @@
 #define STDOUT 1
 #define SIGNAL_DETECTED 2
 #define PIPE_CLOSED 3
+#define SESSION_IDLE_TIMEOUT_S 120      // 0 disables the timeout
+#define SESSION_TOTAL_TIMEOUT_S 0       // 0 disables the timeout
+#define TIMER_TICK_MS 100
+#define COMPACTION_INTERVAL_MS 1000     // Period of the compaction of the reservation indexes
+#define STORE_SYNC_INTERVAL_MS 1000     // Period of the syncs of the persistent store to its file
+#define CHECKPOINT_INTERVAL_S 60        // Period of the checkpoints of the write-ahead log
+#define COMBINE_HOT_THRESHOLD 16        // Contended reservations after which an event uses combining
+#define COMBINE_COLD_PASSES 64          // Combining passes with a single reservation after which it stops
+#define ZERO_COPY_MIN_BYTES 16384       // Smaller arrays are copied to the pipe
+#define SHOW_CHUNK_BYTES 65536          // Seats streamed at a time by SHOW
+#define OPTIMISTIC_COPIES 2             // Copies of an event made without its mutex before one is made with it
+#define SHOW_RESTARTS 2                 // Times a SHOW is streamed again when its changes left the log, before it is copied whole
+#define SHOW_RESTART ((size_t)-1)       // Sent instead of the number of changes of a SHOW whose chunks are sent again
+#define MAX_WATCHED_EVENTS 16           // Events a session may watch at the same time
+#define MAX_SHOW_EVENTS 16              // Events a MULTI_SHOW may show at once
+#define MAX_MULTI_EVENTS 16             // Events a RESERVE_MULTI may reserve seats of at once
+#define MAX_LIST_PAGE_SIZE 1024         // Events listed at a time by LIST_EVENTS
+#define LIST_PAGE_SIZE 256              // Events requested at a time by the client's LIST
 
 enum OP_CODE {
   SETUP = 1,
@@ -22,6 +40,40 @@ enum OP_CODE {
   RESERVE,
   SHOW,
   LIST_EVENTS,
+  ENCODING,
+  SHOW_REGION,
+  WATCH,
+  UNWATCH,
+  SHOW_SINCE,
+  MULTI_SHOW,
+  FREE_COUNT,
+  ROW_AVAILABILITY,
+  RESERVE_BEST,
+  CANCEL,
+  HOLD,
+  CONFIRM,
+  RELEASE,
+  RESERVE_MULTI,
+  SNAPSHOT,
+};
+
+// Encodings of the seats in a SHOW response, negotiated with the ENCODING request
+enum SHOW_ENCODING {
+  ENCODING_RAW = 0,   // rows * cols unsigned ints
+  ENCODING_RLE,       // Size of the encoding, followed by varint (run length, reservation id) pairs
+};
+
+// Contents of a SHOW_SINCE response, after the current version of the event
+enum SHOW_SINCE_RESULT {
+  SINCE_CHANGES = 0,  // Number of changes, followed by that many struct WatchDelta
+  SINCE_SNAPSHOT,     // The whole event, as in a SHOW response
+};
+
+// Order in which RESERVE_BEST looks for free seats in the rows
+enum ROW_PRIORITY {
+  ROWS_FRONT = 0,  // From the first row to the last
+  ROWS_BACK,       // From the last row to the first
+  ROWS_CENTER,     // From the middle row outwards, alternating between the rows behind and in front
 };
 
 
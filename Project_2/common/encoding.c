@@ -0,0 +1,97 @@
+#include "encoding.h"
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Maximum number of bytes of a size_t and of an unsigned int written as varints
+#define VARINT_MAX_SIZE 10
+#define UINT_VARINT_MAX_SIZE 5
+
+
+/// Writes a value as a LEB128 varint.
+/// @param value The value to write.
+/// @param out The buffer to write to.
+/// @return The number of bytes written.
+static size_t write_varint(size_t value, unsigned char *out) {
+  size_t len = 0;
+
+  while (value >= 0x80) {
+    out[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = (unsigned char)value;
+
+  return len;
+}
+
+/// Reads a LEB128 varint.
+/// @param in The buffer to read from.
+/// @param in_size The number of bytes available in the buffer.
+/// @param value Pointer to the variable to store the value in.
+/// @return The number of bytes read, 0 if the varint is invalid.
+static size_t read_varint(const unsigned char *in, size_t in_size, size_t *value) {
+  size_t result = 0;
+
+  for (size_t i = 0; i < in_size && i < VARINT_MAX_SIZE; i++) {
+    result |= (size_t)(in[i] & 0x7f) << (7 * i);
+
+    if ((in[i] & 0x80) == 0) {
+      *value = result;
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+size_t rle_encode_seats(const unsigned int *seats, size_t num_seats, unsigned char *out, size_t out_size) {
+  size_t len = 0;
+
+  for (size_t i = 0; i < num_seats;) {
+    if (len + VARINT_MAX_SIZE + UINT_VARINT_MAX_SIZE > out_size) {
+      return 0;
+    }
+
+    size_t run = 1;
+    while (i + run < num_seats && seats[i + run] == seats[i]) {
+      run++;
+    }
+
+    len += write_varint(run, out + len);
+    len += write_varint(seats[i], out + len);
+    i += run;
+  }
+
+  return len;
+}
+
+size_t rle_max_encoded_size(size_t num_seats) {
+  // A run of n seats has a length of at most n bytes, so every seat adds at most a byte and an id
+  return num_seats * (1 + UINT_VARINT_MAX_SIZE);
+}
+
+int rle_decode_seats(const unsigned char *in, size_t in_size, unsigned int *seats, size_t num_seats) {
+  size_t pos = 0;
+  size_t decoded = 0;
+
+  while (pos < in_size) {
+    size_t run, value;
+
+    size_t len = read_varint(in + pos, in_size - pos, &run);
+    if (len == 0) return 1;
+    pos += len;
+
+    len = read_varint(in + pos, in_size - pos, &value);
+    if (len == 0 || value > UINT_MAX) return 1;
+    pos += len;
+
+    if (run == 0 || run > num_seats - decoded) return 1;
+
+    for (size_t i = 0; i < run; i++) {
+      seats[decoded++] = (unsigned int)value;
+    }
+  }
+
+  return decoded != num_seats;
+}
@@ -0,0 +1,28 @@
+#ifndef COMMON_ENCODING_H
+#define COMMON_ENCODING_H
+
+#include <stddef.h>
+
+/// Encodes an array of seats as a sequence of (run length, reservation id) pairs,
+/// both written as LEB128 varints.
+/// @param seats The seats to be encoded.
+/// @param num_seats The number of seats of the array.
+/// @param out The buffer to write to.
+/// @param out_size The size of the buffer.
+/// @return The number of bytes written to the buffer, 0 if the encoding does not fit in it.
+size_t rle_encode_seats(const unsigned int *seats, size_t num_seats, unsigned char *out, size_t out_size);
+
+/// Gets the largest number of bytes rle_encode_seats may take for an array of seats.
+/// @param num_seats The number of seats of the array.
+/// @return The number of bytes of the encoding when every seat is a run of its own.
+size_t rle_max_encoded_size(size_t num_seats);
+
+/// Decodes an array of seats encoded with rle_encode_seats.
+/// @param in The encoded seats.
+/// @param in_size The number of bytes of the encoding.
+/// @param seats The array to store the seats in.
+/// @param num_seats The number of seats the array must have.
+/// @return 0 if the seats were decoded successfully, 1 if the encoding is invalid.
+int rle_decode_seats(const unsigned char *in, size_t in_size, unsigned int *seats, size_t num_seats);
+
+#endif  // COMMON_ENCODING_H
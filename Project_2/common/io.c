@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // vmsplice and MAP_ANONYMOUS
+#endif
+
 #include "io.h"
 
 #include <limits.h>
@@ -7,6 +11,12 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stddef.h>
+#include <fcntl.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
 
 
 #include "common/constants.h"
@@ -120,21 +130,27 @@ int parse_size_t_array_pipe(int pipe, size_t *values, size_t num_elements) {
 }
 
 int parse_uns_int_array_pipe(int pipe, unsigned int *values, size_t num_elements) {
-  ssize_t bytes_read = read(pipe, values, num_elements * sizeof(unsigned int));
+  size_t bytes_to_read = num_elements * sizeof(unsigned int);
+  size_t bytes_read = 0;
 
-  if (bytes_read == -1) {
-    fprintf(stderr, "read error: %s\n", strerror(errno));
-    return 1;
-  }
+  // Arrays larger than the pipe capacity arrive in several reads
+  while (bytes_read < bytes_to_read) {
+    ssize_t result = read(pipe, (char*)values + bytes_read, bytes_to_read - bytes_read);
 
-  if (bytes_read == 0) {
-    return PIPE_CLOSED;
-  }
+    if (result == -1) {
+      fprintf(stderr, "read error: %s\n", strerror(errno));
+      return 1;
+    }
 
-  // Check if the correct number of bytes were read
-  if ((size_t)bytes_read != num_elements * sizeof(unsigned int)) {
-    fprintf(stderr, "incomplete read from pipe\n");
-    return 1;
+    if (result == 0) {
+      if (bytes_read == 0) {
+        return PIPE_CLOSED;
+      }
+      fprintf(stderr, "incomplete read from pipe\n");
+      return 1;
+    }
+
+    bytes_read += (size_t)result;
   }
 
   return 0;
@@ -286,6 +302,127 @@ int print_uns_int_array_pipe(int pipe, const unsigned int *values, size_t num_el
 
 
 
+int parse_bytes_pipe(int pipe, void *buffer, size_t size) {
+  size_t bytes_read = 0;
+
+  while (bytes_read < size) {
+    ssize_t result = read(pipe, (char*)buffer + bytes_read, size - bytes_read);
+
+    if (result == -1) {
+      fprintf(stderr, "read error: %s\n", strerror(errno));
+      return 1;
+    }
+
+    if (result == 0) {
+      return PIPE_CLOSED;
+    }
+
+    bytes_read += (size_t)result;
+  }
+
+  return 0;
+}
+
+
+int print_bytes_pipe(int pipe, const void *buffer, size_t size) {
+  size_t written_bytes = 0;
+
+  while (written_bytes < size) {
+    errno = 0;
+    ssize_t written = write(pipe, (const char*)buffer + written_bytes, size - written_bytes);
+
+    if (errno == EPIPE) {
+      // The write was interrupted by the sigpipe signal, meaning the pipe was closed
+      return PIPE_CLOSED;
+    }
+
+    if (written == -1) {
+      fprintf(stderr, "write error: %s\n", strerror(errno));
+      return 1;
+    }
+
+    written_bytes += (size_t)written;
+  }
+
+  return 0;
+}
+
+
+unsigned int *alloc_pipe_buffer(size_t num_elements) {
+  size_t size = num_elements * sizeof(unsigned int);
+
+#ifdef __linux__
+  if (size >= ZERO_COPY_MIN_BYTES) {
+    // Whole pages that nothing else in the process will ever write to
+    void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return buffer == MAP_FAILED ? NULL : (unsigned int*)buffer;
+  }
+#endif
+
+  return (unsigned int*)malloc(size > 0 ? size : 1);
+}
+
+
+void free_pipe_buffer(unsigned int *buffer, size_t num_elements) {
+  if (buffer == NULL) {
+    return;
+  }
+
+#ifdef __linux__
+  size_t size = num_elements * sizeof(unsigned int);
+  if (size >= ZERO_COPY_MIN_BYTES) {
+    // The pipe keeps its own references to the pages that were gifted
+    munmap(buffer, size);
+    return;
+  }
+#else
+  (void)num_elements;
+#endif
+
+  free(buffer);
+}
+
+
+int splice_uns_int_array_pipe(int pipe, const unsigned int *values, size_t num_elements) {
+  size_t size = num_elements * sizeof(unsigned int);
+
+#ifdef __linux__
+  if (size >= ZERO_COPY_MIN_BYTES) {
+    struct iovec iov = {(void*)values, size};
+
+    while (iov.iov_len > 0) {
+      errno = 0;
+      ssize_t spliced = vmsplice(pipe, &iov, 1, SPLICE_F_GIFT);
+
+      if (spliced == -1) {
+        if (errno == EPIPE) {
+          // The write was interrupted by the sigpipe signal, meaning the pipe was closed
+          return PIPE_CLOSED;
+        }
+        if (errno == EINVAL || errno == ENOSYS) {
+          // Not a pipe, or no vmsplice support: copies what is left
+          break;
+        }
+        fprintf(stderr, "vmsplice error: %s\n", strerror(errno));
+        return 1;
+      }
+
+      iov.iov_base = (char*)iov.iov_base + spliced;
+      iov.iov_len -= (size_t)spliced;
+    }
+
+    if (iov.iov_len == 0) {
+      return 0;
+    }
+    return print_uns_int_array_pipe(pipe, (const unsigned int*)iov.iov_base, iov.iov_len / sizeof(unsigned int));
+  }
+#endif
+
+  return print_uns_int_array_pipe(pipe, values, num_elements);
+}
+
+
+
 int parse_str_pipe(int pipe, char *str, unsigned int size) {
 
   unsigned int done = 0;
@@ -417,4 +554,28 @@ char *buffer_to_string(const unsigned int *buffer, size_t buffer_size, int funct
 
   snprintf(char_buffer + len, size - len, "\n");
   return char_buffer;
-}
\ No newline at end of file
+}
+
+int sync_directory(const char *path) {
+  // The path is copied to the stack, so that this can run where allocating memory is not safe
+  char directory[PATH_MAX];
+  const char *slash = strrchr(path, '/');
+  if (slash == NULL) {
+    strcpy(directory, ".");
+  } else if (slash == path) {
+    strcpy(directory, "/");
+  } else if ((size_t)(slash - path) < sizeof(directory)) {
+    memcpy(directory, path, (size_t)(slash - path));
+    directory[slash - path] = '\0';
+  } else {
+    return 1;
+  }
+
+  int fd = open(directory, O_RDONLY);
+  if (fd == -1) {
+    return 1;
+  }
+  int result = fsync(fd) != 0;
+  close(fd);
+  return result;
+}
@@ -75,6 +75,41 @@ int print_size_t_array_pipe(int pipe, const size_t *values, size_t num_elements)
 /// @return 0 if the unsigned integer array was written successfully, 1 otherwise.
 int print_uns_int_array_pipe(int pipe, const unsigned int *values, size_t num_elements);
 
+/// Parses a number of raw bytes from the given pipe.
+/// @param pipe The pipe to read from.
+/// @param buffer Pointer to the buffer to store the bytes in.
+/// @param size The number of bytes to read.
+/// @return 0 if the bytes were read successfully, 1 otherwise.
+int parse_bytes_pipe(int pipe, void *buffer, size_t size);
+
+/// Prints a number of raw bytes to the given pipe.
+/// @param pipe The pipe to write to.
+/// @param buffer Pointer to the bytes to write.
+/// @param size The number of bytes to write.
+/// @return 0 if the bytes were written successfully, 1 otherwise.
+int print_bytes_pipe(int pipe, const void *buffer, size_t size);
+
+/// Allocates a buffer for an array of unsigned integers exchanged through a pipe.
+/// @note Large buffers are made of whole anonymous pages, so that they can be
+/// handed to a pipe with splice_uns_int_array_pipe without being copied.
+/// @param num_elements The number of elements of the array.
+/// @return Pointer to the buffer, NULL on failure.
+unsigned int *alloc_pipe_buffer(size_t num_elements);
+
+/// Deallocates a buffer allocated with alloc_pipe_buffer.
+/// @param buffer The buffer to be deallocated.
+/// @param num_elements The number of elements the buffer was allocated with.
+void free_pipe_buffer(unsigned int *buffer, size_t num_elements);
+
+/// Writes an array allocated with alloc_pipe_buffer to the given pipe, gifting
+/// its pages to the pipe with vmsplice when it is large enough.
+/// @note The buffer must not be modified afterwards, only deallocated.
+/// @param pipe The pipe to write to.
+/// @param values The pointer to the values to write.
+/// @param num_elements The size of the array to write.
+/// @return 0 if the array was written successfully, 1 otherwise.
+int splice_uns_int_array_pipe(int pipe, const unsigned int *values, size_t num_elements);
+
 /// Parses a string from the given pipe.
 /// @param pipe The pipe to read from.
 /// @param str Pointer to the variable to store the value in.
@@ -117,4 +152,10 @@ int print_output_show(int out_fd, size_t num_rows, size_t num_cols, unsigned int
 /// @return Pointer to the resulting string.
 char *buffer_to_string(const unsigned int *buffer, size_t buffer_size, int function_called);
 
+/// Makes the entries of the directory of a file durable, such as the one of a file that was
+/// created or renamed there.
+/// @param path Pathname of the file.
+/// @return 0 if the directory was synced successfully, 1 otherwise.
+int sync_directory(const char *path);
+
 #endif  // COMMON_IO_H
@@ -0,0 +1,32 @@
+#ifndef COMMON_WATCH_H
+#define COMMON_WATCH_H
+
+#include <stddef.h>
+
+// Records pushed to the response pipe of a session that is watching events
+enum WATCH_RECORD {
+  WATCH_DELTA = 1,  // Number of deltas, followed by that many struct WatchDelta
+  WATCH_RESYNC,     // struct WatchResync, followed by rows * cols unsigned ints with the seats
+  WATCH_END,        // Answer to UNWATCH, nothing else is pushed afterwards
+};
+
+// Consecutive seats of a row taken by a reservation
+struct WatchDelta {
+  unsigned int event_id;        /// Event the seats belong to
+  unsigned int version;         /// Version of the event after the reservation
+  unsigned int reservation_id;  /// Reservation that took the seats
+  size_t row;                   /// Row of the seats
+  size_t first_col;             /// Column of the first seat
+  size_t num_seats;             /// Number of seats
+};
+
+// Full state of an event, sent instead of the deltas a slow watcher could not keep up with.
+// Deltas with a version not greater than the one of the snapshot are already part of it.
+struct WatchResync {
+  unsigned int event_id;  /// Event of the snapshot
+  unsigned int version;   /// Version of the event when the snapshot was taken
+  size_t rows;            /// Number of rows of the event
+  size_t cols;            /// Number of columns of the event
+};
+
+#endif  // COMMON_WATCH_H
@@ -0,0 +1,92 @@
+# Helpers of the scripted tests, which run servers and clients on the fixtures of this
+# directory. Each test works in a temporary directory, and stops its servers when it ends.
+
+JOBS_DIR=$(cd "$(dirname "$0")" && pwd)
+EMS="$JOBS_DIR/../server/ems"
+CLIENT="$JOBS_DIR/../client/client"
+WORK_DIR=$(mktemp -d)
+TEST_NAME=$(basename "$0" .sh)
+SERVER_PIDS=""
+CLIENT_PIDS=""
+
+cleanup() {
+  for pid in $SERVER_PIDS $CLIENT_PIDS; do
+    kill "$pid" 2>/dev/null
+  done
+  wait 2>/dev/null
+  rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+# Fails the test with a message.
+fail() {
+  echo "$TEST_NAME: FAIL: $*"
+  exit 1
+}
+
+# Starts a server on a pipe of the work directory: start_server <name> [options...]
+start_server() {
+  name=$1
+  shift
+  "$EMS" "$WORK_DIR/$name" 0 "$@" > "$WORK_DIR/$name.log" 2>&1 &
+  SERVER_PIDS="$SERVER_PIDS $!"
+  eval "SERVER_$name=$!"
+
+  tries=0
+  while [ ! -p "$WORK_DIR/$name" ]; do
+    tries=$((tries + 1))
+    [ $tries -le 50 ] || fail "server $name did not start"
+    sleep 0.1
+  done
+}
+
+# Stops a server: stop_server <name>
+stop_server() {
+  pid=$(eval "echo \$SERVER_$1")
+  kill "$pid" 2>/dev/null
+  wait "$pid" 2>/dev/null
+}
+
+# Prints the statistics of a server to its log: server_stats <name>
+server_stats() {
+  kill -USR1 "$(eval "echo \$SERVER_$1")"
+  sleep 0.2
+}
+
+# Gets a statistic last printed by a server: stat_value <name> <label>
+stat_value() {
+  grep -a "^$2: " "$WORK_DIR/$1.log" | tail -1 | sed "s/^$2: //"
+}
+
+# Runs the client on a fixture against a server: run_client <server> <fixture>
+# Fixtures a test wrote to the work directory are used instead of those of this directory.
+run_client() {
+  [ -f "$WORK_DIR/$2.jobs" ] || cp "$JOBS_DIR/$2.jobs" "$WORK_DIR/$2.jobs"
+  timeout 20 "$CLIENT" "$WORK_DIR/$2.req" "$WORK_DIR/$2.resp" "$WORK_DIR/$1" "$WORK_DIR/$2.jobs" > /dev/null 2>&1 ||
+    fail "client of $2 failed"
+}
+
+# Runs the client on a fixture in the background: start_client <server> <fixture>
+start_client() {
+  [ -f "$WORK_DIR/$2.jobs" ] || cp "$JOBS_DIR/$2.jobs" "$WORK_DIR/$2.jobs"
+  timeout 20 "$CLIENT" "$WORK_DIR/$2.req" "$WORK_DIR/$2.resp" "$WORK_DIR/$1" "$WORK_DIR/$2.jobs" > /dev/null 2>&1 &
+  CLIENT_PIDS="$CLIENT_PIDS $!"
+}
+
+# Waits for the clients started in the background.
+wait_clients() {
+  for pid in $CLIENT_PIDS; do
+    wait "$pid" || fail "a client failed"
+  done
+  CLIENT_PIDS=""
+}
+
+# Compares the output of a fixture with the expected one: check_output <fixture>
+check_output() {
+  diff "$JOBS_DIR/$1.out" "$WORK_DIR/$1.out" > /dev/null || fail "unexpected output of $1"
+}
+
+# Ends a test that passed.
+pass() {
+  echo "$TEST_NAME: ok"
+}
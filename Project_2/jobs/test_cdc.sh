@@ -0,0 +1,21 @@
+#!/bin/sh
+# A server started with --cdc feeds its committed changes to a file in the record format of the
+# log, so a server that replays the file as its log has the events the first one had.
+. "$(dirname "$0")/common.sh"
+
+FEED="$WORK_DIR/ems.cdc"
+
+start_server ems --wal "$WORK_DIR/ems.wal" --cdc "$FEED"
+run_client ems cdc_changes
+server_stats ems
+[ "$(stat_value ems "CDC dropped")" = 0 ] || fail "changes were dropped"
+
+# The remaining records are written when the server stops
+stop_server ems
+[ -s "$FEED" ] || fail "the feed is empty"
+
+cp "$FEED" "$WORK_DIR/replay.wal"
+start_server replayed --wal "$WORK_DIR/replay.wal"
+run_client replayed cdc_show
+check_output cdc_show
+pass
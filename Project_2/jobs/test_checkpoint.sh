@@ -0,0 +1,27 @@
+#!/bin/sh
+# A server with a write-ahead log and checkpoints drops the records each checkpoint has from the
+# log, and a server restarted from them after a crash has every change.
+. "$(dirname "$0")/common.sh"
+
+LOG="$WORK_DIR/ems.wal"
+CHECKPOINT="$WORK_DIR/ems.checkpoint"
+
+start_server ems --wal "$LOG" --checkpoint "$CHECKPOINT" --checkpoint-interval 1
+run_client ems ckpt_before
+sleep 1.5
+run_client ems ckpt_after
+sleep 1.5
+
+server_stats ems
+[ "$(stat_value ems Checkpoints)" -ge 2 ] || fail "no checkpoints were written"
+[ "$(head -c 4 "$LOG")" = "EMSL" ] || fail "the log was not truncated"
+run_client ems ckpt_last
+
+# The server is killed, as in a crash, and the new one replays what the log kept after the checkpoint
+kill -KILL "$SERVER_ems"
+wait "$SERVER_ems" 2>/dev/null
+rm -f "$WORK_DIR/ems"
+start_server ems --wal "$LOG" --checkpoint "$CHECKPOINT"
+run_client ems ckpt_show
+check_output ckpt_show
+pass
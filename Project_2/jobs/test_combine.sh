@@ -0,0 +1,36 @@
+#!/bin/sh
+# Sessions reserving seats of the same event at once have their reservations combined, and each
+# combined reservation gets its seats and a reservation id of its own.
+. "$(dirname "$0")/common.sh"
+
+SESSIONS=8
+ROWS=320
+COLS=200
+
+# Each session reserves whole rows, one reservation per row
+echo "CREATE 1 $ROWS $COLS" > "$WORK_DIR/combine_create.jobs"
+echo "SHOW 1" > "$WORK_DIR/combine_show.jobs"
+for session in $(seq $SESSIONS); do
+  for row in $(seq "$session" $SESSIONS $ROWS); do
+    seq $COLS | sed "s/.*/($row,&)/" | paste -sd ' ' | sed 's/.*/RESERVE 1 [&]/'
+  done > "$WORK_DIR/combine_$session.jobs"
+done
+
+start_server ems --combine-threshold 0
+run_client ems combine_create
+for session in $(seq $SESSIONS); do
+  start_client ems "combine_$session"
+done
+wait_clients
+run_client ems combine_show
+
+# Every row is reserved by a reservation of its own, numbered 1 to the number of rows
+tr ' ' '\n' < "$WORK_DIR/combine_show.out" | grep -v '^$' | uniq -c | awk '{ print $1, $2 }' > "$WORK_DIR/rows"
+[ "$(wc -l < "$WORK_DIR/rows")" -eq $ROWS ] || fail "rows share reservations"
+awk '{ print $2 }' "$WORK_DIR/rows" | sort -n > "$WORK_DIR/ids"
+seq $ROWS | diff - "$WORK_DIR/ids" > /dev/null || fail "reservation ids are not unique"
+awk -v cols=$COLS '$1 != cols { exit 1 }' "$WORK_DIR/rows" || fail "a row was not reserved whole"
+
+server_stats ems
+[ "$(stat_value ems "Combined reservations")" -gt 0 ] || fail "no reservation was combined"
+pass
@@ -0,0 +1,24 @@
+#!/bin/sh
+# SNAPSHOT writes the events to the file of --save while the server goes on, and a server started
+# with --load from that file has the events as they were when the snapshot was taken.
+. "$(dirname "$0")/common.sh"
+
+SNAPSHOT="$WORK_DIR/ems.snapshot"
+
+start_server ems --save "$SNAPSHOT"
+run_client ems snap_save
+
+tries=0
+while server_stats ems; [ "$(stat_value ems Snapshots)" != 1 ]; do
+  tries=$((tries + 1))
+  [ $tries -le 25 ] || fail "the snapshot was not written"
+done
+
+# Changes after the snapshot are not in it
+run_client ems snap_after
+stop_server ems
+
+start_server loaded --load "$SNAPSHOT"
+run_client loaded snap_show
+check_output snap_show
+pass
@@ -0,0 +1,35 @@
+#!/bin/sh
+# A standby gets the state of its primary when it connects and then every change the primary makes,
+# refuses the requests that change the state, and refuses to show the events once the primary leaves.
+. "$(dirname "$0")/common.sh"
+
+FEED="$WORK_DIR/feed"
+
+start_server standby --standby "$FEED"
+start_server primary --cdc "$FEED"
+run_client primary stby_before
+
+# A standby that connects after the changes gets them with the state of the primary
+stop_server standby
+start_server standby --standby "$FEED"
+run_client primary stby_after
+
+tries=0
+while run_client standby stby_show; ! diff "$JOBS_DIR/stby_show.out" "$WORK_DIR/stby_show.out" > /dev/null; do
+  tries=$((tries + 1))
+  [ $tries -le 50 ] || fail "the standby did not get the changes of the primary"
+  sleep 0.1
+done
+
+run_client standby stby_write
+grep -q "Standby server is read-only" "$WORK_DIR/standby.log" || fail "the standby made a change"
+run_client standby stby_show
+check_output stby_show
+
+# Without a primary the events may be behind
+stop_server primary
+sleep 0.5
+run_client standby stby_show
+[ ! -s "$WORK_DIR/stby_show.out" ] || fail "the standby showed the events without a primary"
+grep -q "not in sync with its primary" "$WORK_DIR/standby.log" || fail "the standby did not refuse to show the events"
+pass
@@ -0,0 +1,15 @@
+#!/bin/sh
+# A server started with --store on the store of a previous one has its events, and the ids of new
+# reservations go on from those in the seats of the store.
+. "$(dirname "$0")/common.sh"
+
+STORE="$WORK_DIR/ems.store"
+
+start_server ems --store "$STORE"
+run_client ems store_write
+stop_server ems
+
+start_server restarted --store "$STORE"
+run_client restarted store_show
+check_output store_show
+pass
@@ -0,0 +1,12 @@
+#!/bin/sh
+# A session watching an event gets its snapshot, then the deltas of the reservations and
+# cancellations made by another session, in the order of the versions.
+. "$(dirname "$0")/common.sh"
+
+start_server ems
+start_client ems watch
+sleep 0.2
+run_client ems watch_changes
+wait_clients
+check_output watch
+pass
@@ -0,0 +1,351 @@
+#include "cdc.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+
+/// Finds the end of the complete records that follow an offset.
+/// @param cdc The feed.
+/// @param start Offset of the first record.
+/// @param num_records Variable to store the number of complete records in.
+/// @return Offset after the last complete record, start if the first one is not complete.
+static uint64_t ready_end(Cdc *cdc, uint64_t start, unsigned long *num_records) {
+  uint64_t reserved = atomic_load(&cdc->reserved);
+  uint64_t end = start;
+
+  *num_records = 0;
+  while (end < reserved) {
+    uint32_t size = __atomic_load_n((uint32_t *)&cdc->ring[end % CDC_BUFFER_SIZE], __ATOMIC_ACQUIRE);
+    if (size == 0) {
+      break;  // The record is still being copied, the next ones wait for it
+    }
+    end += size;
+    (*num_records)++;
+  }
+  return end;
+}
+
+/// Closes a pipe or socket, so that the output gets the state again when it is reopened.
+/// @param cdc The feed.
+static void close_output(Cdc *cdc) {
+  close(cdc->fd);
+  cdc->fd = -1;
+  cdc->sequence = 0;
+}
+
+/// Opens a named pipe or connects to a Unix socket if it has a reader and is not open yet, and
+/// closes one whose reader left.
+/// @param cdc The feed.
+/// @return 0 if the output is open, 1 otherwise.
+static int open_output(Cdc *cdc) {
+  // A reader that leaves while there is nothing to write is noticed all the same
+  if (cdc->fd != -1 && (cdc->is_fifo || cdc->is_socket)) {
+    struct pollfd output = {.fd = cdc->fd, .events = 0};
+    if (poll(&output, 1, 0) > 0 && (output.revents & (POLLERR | POLLHUP)) != 0) {
+      close_output(cdc);
+    }
+  }
+  if (cdc->fd != -1) {
+    return 0;
+  }
+
+  if (cdc->is_socket) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strcpy(address.sun_path, cdc->path);
+    cdc->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (cdc->fd != -1 && connect(cdc->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+      close(cdc->fd);
+      cdc->fd = -1;
+    }
+    return cdc->fd == -1;
+  }
+
+  // Opening without a reader fails instead of waiting, and the records wait in the ring meanwhile
+  cdc->fd = open(cdc->path, O_WRONLY | O_NONBLOCK);
+  if (cdc->fd == -1) {
+    return 1;
+  }
+
+  int flags = fcntl(cdc->fd, F_GETFL);
+  if (flags == -1 || fcntl(cdc->fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+    close(cdc->fd);
+    cdc->fd = -1;
+    return 1;
+  }
+  return 0;
+}
+
+/// Writes bytes to the output.
+/// @note A pipe or socket whose reader left is closed, and the next reader gets the state first.
+/// @param cdc The feed.
+/// @param bytes The bytes.
+/// @param size Number of bytes.
+/// @return 0 if the bytes were written, 1 otherwise.
+static int write_bytes(Cdc *cdc, const unsigned char *bytes, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t written = write(cdc->fd, &bytes[done], size - done);
+    if (written < 0) {
+      if (cdc->is_fifo || cdc->is_socket) {
+        close_output(cdc);
+      }
+      return 1;
+    }
+    done += (size_t)written;
+  }
+  return 0;
+}
+
+/// Numbers the records of the ring between two offsets, following a sequence number.
+/// @param cdc The feed.
+/// @param start Offset of the first record.
+/// @param end Offset after the last record.
+/// @param sequence Number of the record before the first one.
+/// @return Number of the last record.
+static uint64_t number_records(Cdc *cdc, uint64_t start, uint64_t end, uint64_t sequence) {
+  // Records take a multiple of 8 bytes, so neither their size nor their sequence is split by the end of the ring
+  for (uint64_t offset = start; offset < end;) {
+    uint64_t *number = (uint64_t *)&cdc->ring[(offset + offsetof(struct WalRecord, sequence)) % CDC_BUFFER_SIZE];
+    *number = ++sequence;
+    offset += *(uint32_t *)&cdc->ring[offset % CDC_BUFFER_SIZE];
+  }
+  return sequence;
+}
+
+/// Numbers the records of the ring between two offsets and writes them to the output.
+/// @note The numbers of the records dropped since the last ones are skipped.
+/// @param cdc The feed.
+/// @param start Offset of the first record.
+/// @param end Offset after the last record.
+/// @param dropped Number of records dropped so far.
+/// @return 0 if the records were written, 1 otherwise.
+static int write_records(Cdc *cdc, uint64_t start, uint64_t end, unsigned long dropped) {
+  uint64_t sequence = number_records(cdc, start, end, cdc->sequence + (dropped - cdc->dropped_seen));
+
+  for (uint64_t offset = start; offset < end;) {
+    size_t position = offset % CDC_BUFFER_SIZE;
+    size_t length = CDC_BUFFER_SIZE - position;
+    if (length > end - offset) {
+      length = end - offset;
+    }
+
+    if (write_bytes(cdc, &cdc->ring[position], length) != 0) {
+      return 1;
+    }
+    offset += length;
+  }
+
+  cdc->sequence = sequence;
+  cdc->dropped_seen = dropped;
+  return 0;
+}
+
+/// Writes the state of the server to an output that has not got it yet, ended by a WAL_SYNC record.
+/// @note The records of the ring the state has are not written after it.
+/// @param cdc The feed.
+/// @return 0 if the state was written, 1 otherwise.
+static int write_state(Cdc *cdc) {
+  // Changes appended from here on may be in the copy too, and are written after it anyway
+  uint64_t position = atomic_load(&cdc->reserved);
+  unsigned long dropped = atomic_load(&cdc->dropped);
+  size_t size;
+  unsigned char *records = cdc->state(cdc->arg, &size);
+  if (records == NULL) {
+    return 1;
+  }
+
+  // Like the records, the state is only fed once the log has every change it has
+  if (cdc->wal != NULL && wal_wait(cdc->wal, wal_end(cdc->wal)) != 0) {
+    free(records);
+    return 1;
+  }
+
+  uint32_t now = cdc_time_ms();
+  uint64_t sequence = 0;
+  for (size_t offset = 0; offset < size;) {
+    struct WalRecord *record = (struct WalRecord *)&records[offset];
+    record->sequence = ++sequence;
+    record->time_ms = now;
+    record->checksum = wal_checksum(record);
+    offset += record->size;
+  }
+
+  struct WalRecord sync = {.size = sizeof(struct WalRecord), .sequence = ++sequence, .type = WAL_SYNC, .time_ms = now};
+  sync.checksum = wal_checksum(&sync);
+
+  int result = write_bytes(cdc, records, size) != 0 || write_bytes(cdc, (unsigned char *)&sync, sizeof(sync)) != 0;
+  free(records);
+  if (result == 0) {
+    cdc->sequence = sequence;
+    cdc->skip = position;
+    cdc->dropped_seen = dropped;
+  }
+  return result;
+}
+
+static void *cdc_consumer(void *arg) {
+  Cdc *cdc = (Cdc *)arg;
+
+  // Signals are handled by the other threads, and a pipe without a reader fails the write instead
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  struct timespec interval = {.tv_sec = 0, .tv_nsec = CDC_DRAIN_INTERVAL_MS * 1000000L};
+  uint64_t consumed = atomic_load(&cdc->consumed);
+
+  while (1) {
+    int stop = atomic_load(&cdc->stop);
+
+    // An output that was just opened gets the state before any record
+    int ready = open_output(cdc) == 0 && (cdc->sequence != 0 || write_state(cdc) == 0);
+
+    // Every record that is complete is written at once, but for the ones the state has
+    unsigned long dropped = atomic_load(&cdc->dropped);
+    unsigned long num_records;
+    uint64_t end = ready_end(cdc, consumed, &num_records);
+    uint64_t first = consumed >= cdc->skip ? consumed : cdc->skip < end ? cdc->skip : end;
+
+    // The log has every complete record already, so once what it has is durable so are they
+    int lost = ready && end > first && cdc->wal != NULL && wal_wait(cdc->wal, wal_end(cdc->wal)) != 0;
+    int written = ready && !lost && end > consumed && (end == first || write_records(cdc, first, end, dropped) == 0);
+
+    // Records the log failed to write are never durable, so they are dropped as if the ring was full
+    if (lost) {
+      atomic_fetch_add(&cdc->dropped, num_records);
+      atomic_fetch_sub(&server_stats.cdc_records, num_records);
+      atomic_fetch_add(&server_stats.cdc_dropped, num_records);
+    } else if (written) {
+      atomic_fetch_add(&server_stats.cdc_written, num_records);
+    }
+
+    if (written || lost) {
+      // The space is cleared, so that the size of the record copied there next starts as 0
+      for (uint64_t offset = consumed; offset < end;) {
+        size_t position = offset % CDC_BUFFER_SIZE;
+        size_t length = CDC_BUFFER_SIZE - position < end - offset ? CDC_BUFFER_SIZE - position : end - offset;
+        memset(&cdc->ring[position], 0, length);
+        offset += length;
+      }
+      consumed = end;
+      atomic_store(&cdc->consumed, end);
+    }
+
+    // Records the output does not take by then are lost
+    if (stop && (!(written || lost) || end == atomic_load(&cdc->reserved))) {
+      break;
+    }
+    if (!(written || lost)) {
+      nanosleep(&interval, NULL);
+    }
+  }
+
+  return NULL;
+}
+
+Cdc *cdc_open(const char *path, Wal *wal, cdc_state state, void *arg) {
+  Cdc *cdc = (Cdc *)malloc(sizeof(Cdc));
+  if (cdc == NULL) {
+    return NULL;
+  }
+
+  cdc->ring = (unsigned char *)calloc(CDC_BUFFER_SIZE, 1);
+  if (cdc->ring == NULL) {
+    free(cdc);
+    return NULL;
+  }
+
+  // A named pipe or socket is opened by the consumer once it has a reader, a file right away
+  struct stat file_stat;
+  int exists = stat(path, &file_stat) == 0;
+  cdc->path = path;
+  cdc->wal = wal;
+  cdc->state = state;
+  cdc->arg = arg;
+  cdc->sequence = 0;
+  cdc->skip = 0;
+  cdc->dropped_seen = 0;
+  cdc->is_fifo = exists && S_ISFIFO(file_stat.st_mode);
+  cdc->is_socket = exists && S_ISSOCK(file_stat.st_mode);
+  if (cdc->is_socket && strlen(path) >= sizeof(((struct sockaddr_un *)NULL)->sun_path)) {
+    free(cdc->ring);
+    free(cdc);
+    return NULL;
+  }
+  cdc->fd = cdc->is_fifo || cdc->is_socket ? -1 : open(path, O_WRONLY | O_CREAT | O_APPEND, 0640);
+  if (!cdc->is_fifo && !cdc->is_socket && cdc->fd == -1) {
+    free(cdc->ring);
+    free(cdc);
+    return NULL;
+  }
+
+  atomic_init(&cdc->reserved, 0);
+  atomic_init(&cdc->consumed, 0);
+  atomic_init(&cdc->dropped, 0);
+  atomic_init(&cdc->stop, 0);
+
+  if (pthread_create(&cdc->thread, NULL, cdc_consumer, cdc) != 0) {
+    if (cdc->fd != -1) close(cdc->fd);
+    free(cdc->ring);
+    free(cdc);
+    return NULL;
+  }
+
+  return cdc;
+}
+
+void cdc_close(Cdc *cdc) {
+  if (cdc == NULL) return;
+
+  atomic_store(&cdc->stop, 1);
+  pthread_join(cdc->thread, NULL);
+
+  if (cdc->fd != -1) close(cdc->fd);
+  free(cdc->ring);
+  free(cdc);
+}
+
+uint32_t cdc_time_ms() {
+  // The clock is shared by the processes of the machine, and read without a system call
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000);
+}
+
+void cdc_append(Cdc *cdc, struct WalRecord *record) {
+  uint32_t size = (uint32_t)(sizeof(struct WalRecord) + record->num_runs * sizeof(struct WalRun));
+  record->size = size;
+  record->time_ms = cdc_time_ms();
+  record->checksum = wal_checksum(record);
+
+  // Room is only reserved if the ring has it, so a slow output costs records but never waits
+  uint64_t offset = atomic_load(&cdc->reserved);
+  do {
+    if (offset + size - atomic_load(&cdc->consumed) > CDC_BUFFER_SIZE) {
+      atomic_fetch_add(&cdc->dropped, 1);
+      atomic_fetch_add(&server_stats.cdc_dropped, 1);
+      return;
+    }
+  } while (!atomic_compare_exchange_weak(&cdc->reserved, &offset, offset + size));
+
+  // The size is stored last, since the consumer takes a record as complete once it sees it
+  const unsigned char *bytes = (const unsigned char *)record;
+  for (size_t done = sizeof(uint32_t); done < size;) {
+    size_t position = (offset + done) % CDC_BUFFER_SIZE;
+    size_t length = CDC_BUFFER_SIZE - position < size - done ? CDC_BUFFER_SIZE - position : size - done;
+    memcpy(&cdc->ring[position], &bytes[done], length);
+    done += length;
+  }
+  __atomic_store_n((uint32_t *)&cdc->ring[offset % CDC_BUFFER_SIZE], size, __ATOMIC_RELEASE);
+  atomic_fetch_add(&server_stats.cdc_records, 1);
+}
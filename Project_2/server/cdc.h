@@ -0,0 +1,76 @@
+#ifndef SERVER_CDC_H
+#define SERVER_CDC_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wal.h"
+
+#define CDC_BUFFER_SIZE ((size_t)1 << 22)  // Bytes of records that may wait for the consumer, a power of 2
+#define CDC_DRAIN_INTERVAL_MS 10           // Time the consumer sleeps when there is nothing to write
+
+/// Function that copies the state of the server for a change feed, as the records that recreate it.
+/// @note Changes made while the state is copied are fed after it as well, so applying a record
+/// the state already has must do nothing.
+/// @param arg Argument given to cdc_open.
+/// @param size Variable to store the bytes of the records in.
+/// @return The records one after the other, with their sizes filled in, to be freed by the caller;
+/// NULL on failure.
+typedef unsigned char *(*cdc_state)(void *arg, size_t *size);
+
+// Feed of the committed changes for downstream systems, in the record format of the write-ahead
+// log. Workers copy their records to a ring without locks or system calls, and drop them if the
+// ring is full. A consumer thread polls the ring and writes the records to a file, a named pipe
+// or a Unix socket in large writes. A pipe or socket is reopened whenever it has no reader, while
+// the records wait. With a write-ahead log, records are only fed once the log has them, so the
+// feed never has a change that a crash could undo.
+//
+// Each time the output is opened it first gets the whole state, ended by a WAL_SYNC record, and
+// the records written to it are numbered from 1. Numbers of dropped records are skipped, so a
+// reader finds out which changes it missed, and a reader that leaves gets the state again.
+typedef struct {
+  int fd;                          /// File descriptor of the output, -1 while a pipe or socket has no reader
+  const char *path;                /// Pathname of the output
+  int is_fifo;                     /// Whether the output is a named pipe
+  int is_socket;                   /// Whether the output is a listening Unix socket
+  Wal *wal;                        /// Log the records are appended to first, NULL if none
+  cdc_state state;                 /// Function that copies the state each output starts with
+  void *arg;                       /// Argument given to the function
+  unsigned char *ring;             /// Records not yet written, at their offset modulo CDC_BUFFER_SIZE
+  atomic_uint_least64_t reserved;  /// Offset after the last record that a worker reserved room for
+  atomic_uint_least64_t consumed;  /// Every record before this offset was written
+  atomic_ulong dropped;            /// Number of records dropped so far
+  uint64_t sequence;               /// Number of the last record written to the output, 0 until it got the state
+  uint64_t skip;                   /// Records before this offset are in the state the output got
+  unsigned long dropped_seen;      /// Number of records dropped when the last record was numbered
+  atomic_int stop;                 /// Whether the consumer should terminate
+  pthread_t thread;                /// The consumer thread
+} Cdc;
+
+/// Opens the output of a change feed and starts its consumer.
+/// @param path Pathname of a named pipe, of a Unix socket, or of a file to append to, created if it
+/// does not exist.
+/// @param wal Log the records are appended to before the feed, which must be closed after the feed, or NULL.
+/// @param state Function that copies the state the output starts with.
+/// @param arg Argument given to the function.
+/// @return The feed, NULL on failure.
+Cdc *cdc_open(const char *path, Wal *wal, cdc_state state, void *arg);
+
+/// Writes the remaining records if the output allows it, stops the consumer and closes the feed.
+/// @param cdc The feed.
+void cdc_close(Cdc *cdc);
+
+/// Gets the time the records of a feed are stamped with.
+/// @return Milliseconds of the monotonic clock, modulo 2^32.
+uint32_t cdc_time_ms();
+
+/// Adds a record to the feed, or drops it if the ring is full. Never waits nor makes system calls.
+/// @note The size, time and checksum of the record are filled in, and its sequence once it is
+/// written. A record of a log must be appended to it first.
+/// @param cdc The feed.
+/// @param record The record, followed by its runs of seats.
+void cdc_append(Cdc *cdc, struct WalRecord *record);
+
+#endif  // SERVER_CDC_H
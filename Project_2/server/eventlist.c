@@ -2,6 +2,9 @@
 
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+
+static atomic_uint next_provisional_tag;  // Source of the provisional tags of the seats being claimed
 
 struct EventList* create_list() {
   struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
@@ -13,15 +16,73 @@ struct EventList* create_list() {
   list->head = NULL;
   list->tail = NULL;
   list->num_events = 0;
+  list->index = NULL;
+  list->index_capacity = 0;
   return list;
 }
 
+size_t list_lower_bound(struct EventList* list, unsigned int event_id) {
+  size_t low = 0;
+  size_t high = list->num_events;
+
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (list->index[middle]->id < event_id) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+struct Event* list_find(struct EventList* list, unsigned int event_id) {
+  size_t position = list_lower_bound(list, event_id);
+  if (position == list->num_events || list->index[position]->id != event_id) {
+    return NULL;
+  }
+  return list->index[position];
+}
+
+/// Adds an event to the index, keeping it sorted by id.
+/// @param list Event list to be modified.
+/// @param event Event to be added.
+/// @return 0 if the event was added successfully, 1 otherwise.
+static int index_insert(struct EventList* list, struct Event* event) {
+  if (list->num_events == list->index_capacity) {
+    size_t capacity = list->index_capacity > 0 ? list->index_capacity * 2 : 16;
+    struct Event** index = (struct Event**)realloc(list->index, capacity * sizeof(struct Event*));
+    if (!index) return 1;
+
+    list->index = index;
+    list->index_capacity = capacity;
+  }
+
+  // Events are usually created with increasing ids, which only appends to the index
+  size_t position = list->num_events;
+  if (position > 0 && list->index[position - 1]->id > event->id) {
+    position = list_lower_bound(list, event->id);
+    memmove(&list->index[position + 1], &list->index[position],
+            (list->num_events - position) * sizeof(struct Event*));
+  }
+
+  list->index[position] = event;
+  list->num_events++;
+  return 0;
+}
+
 int append_to_list(struct EventList* list, struct Event* event) {
   if (!list) return 1;
 
   struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode));
   if (!new_node) return 1;
 
+  if (index_insert(list, event) != 0) {
+    free(new_node);
+    return 1;
+  }
+
   new_node->event = event;
   new_node->next = NULL;
 
@@ -38,7 +99,17 @@ int append_to_list(struct EventList* list, struct Event* event) {
 
 static void free_event(struct Event* event) {
   if (!event) return;
-  free(event->data);
+  for (unsigned int id = 1; id <= event->reservations; id++) {
+    free(event->seat_lists[id - 1].hold);
+  }
+  if (event->stored == NULL) {
+    free(event->data);
+  }
+  free(event->row_free);
+  free(event->free_map);
+  free(event->log);
+  free(event->seat_lists);
+  free(event->arena);
   free(event);
 }
 
@@ -54,6 +125,7 @@ void free_list(struct EventList* list) {
     free(temp);
   }
 
+  free(list->index);
   free(list);
 }
 
@@ -73,3 +145,380 @@ struct Event* get_event(struct EventList* list, unsigned int event_id, struct Li
     current = current->next;
   }
 }
+
+void event_log_append(struct Event* event, const struct WatchDelta* changes, size_t num_changes) {
+  if (event->log == NULL) {
+    event->log = (struct WatchDelta*)malloc(EVENT_LOG_SIZE * sizeof(struct WatchDelta));
+    if (event->log == NULL) {
+      // Every change made so far is forgotten, so incremental SHOWs fall back to snapshots
+      event->log_base = event->version;
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < num_changes; i++) {
+    if (event->log_count == EVENT_LOG_SIZE) {
+      event->log_base = event->log[event->log_head].version;
+      event->log_head = (event->log_head + 1) % EVENT_LOG_SIZE;
+      event->log_count--;
+    }
+
+    event->log[(event->log_head + event->log_count) % EVENT_LOG_SIZE] = changes[i];
+    event->log_count++;
+  }
+}
+
+int event_log_since(struct Event* event, unsigned int version, struct WatchDelta** changes, size_t* num_changes) {
+  *changes = NULL;
+  *num_changes = 0;
+
+  if (version < event->log_base || version > event->version) {
+    return 1;
+  }
+
+  // The changes are ordered by version, so the newer ones are at the end of the ring
+  size_t count = 0;
+  while (count < event->log_count &&
+         event->log[(event->log_head + event->log_count - count - 1) % EVENT_LOG_SIZE].version > version) {
+    count++;
+  }
+
+  if (count == 0) {
+    return 0;
+  }
+
+  *changes = (struct WatchDelta*)malloc(count * sizeof(struct WatchDelta));
+  if (*changes == NULL) {
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    (*changes)[i] = event->log[(event->log_head + event->log_count - count + i) % EVENT_LOG_SIZE];
+  }
+  *num_changes = count;
+  return 0;
+}
+
+int event_init_availability(struct Event* event) {
+  event->row_words = (event->cols + 63) / 64;
+  event->free_seats = event->rows * event->cols;
+  event->row_free = (size_t*)malloc(event->rows * sizeof(size_t) + 1);
+  event->free_map = (uint64_t*)malloc(event->rows * event->row_words * sizeof(uint64_t) + 1);
+
+  if (event->row_free == NULL || event->free_map == NULL) {
+    free(event->row_free);
+    free(event->free_map);
+    event->row_free = NULL;
+    event->free_map = NULL;
+    return 1;
+  }
+
+  // The bits after the last column stay clear, so they are never part of a free run
+  for (size_t row = 0; row < event->rows; row++) {
+    event->row_free[row] = event->cols;
+
+    uint64_t* words = &event->free_map[row * event->row_words];
+    for (size_t word = 0; word < event->row_words; word++) {
+      size_t remaining = event->cols - word * 64;
+      words[word] = remaining >= 64 ? UINT64_MAX : (UINT64_C(1) << remaining) - 1;
+    }
+  }
+  return 0;
+}
+
+unsigned int event_provisional_tag() {
+  return PROVISIONAL_SEAT | (atomic_fetch_add(&next_provisional_tag, 1) & ~PROVISIONAL_SEAT);
+}
+
+int event_claim_seats(struct Event* event, size_t num_seats, const size_t* xs, const size_t* ys,
+                      unsigned int expected, unsigned int value) {
+  for (size_t i = 0; i < num_seats; i++) {
+    unsigned int* seat = &event->data[(xs[i] - 1) * event->cols + ys[i] - 1];
+    unsigned int current = expected;
+
+    if (__atomic_compare_exchange_n(seat, &current, value, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+
+    // Only the seats changed so far are put back, which still have the new value
+    for (size_t j = 0; j < i; j++) {
+      unsigned int changed = value;
+      __atomic_compare_exchange_n(&event->data[(xs[j] - 1) * event->cols + ys[j] - 1], &changed, expected, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+void event_copy_seats(struct Event* event, unsigned int* seats, size_t first_seat, size_t num_seats) {
+  // Seats are only claimed or given back without the mutex, so any value read from them is free
+  for (size_t i = 0; i < num_seats; i++) {
+    unsigned int seat = __atomic_load_n(&event->data[first_seat + i], __ATOMIC_RELAXED);
+    seats[i] = (seat & PROVISIONAL_SEAT) ? 0 : seat;
+  }
+}
+
+void event_take_seats(struct Event* event, size_t row, size_t first_col, size_t num_seats) {
+  uint64_t* words = &event->free_map[(row - 1) * event->row_words];
+
+  for (size_t col = first_col - 1; col < first_col - 1 + num_seats; col++) {
+    words[col / 64] &= ~(UINT64_C(1) << (col % 64));
+  }
+
+  event->row_free[row - 1] -= num_seats;
+  event->free_seats -= num_seats;
+}
+
+void event_release_seats(struct Event* event, size_t row, size_t first_col, size_t num_seats) {
+  uint64_t* words = &event->free_map[(row - 1) * event->row_words];
+
+  for (size_t col = first_col - 1; col < first_col - 1 + num_seats; col++) {
+    words[col / 64] |= UINT64_C(1) << (col % 64);
+  }
+
+  event->row_free[row - 1] += num_seats;
+  event->free_seats += num_seats;
+}
+
+/// Finds the next seat of a row with the given state, starting at a column.
+/// @param words Bitmap of the row.
+/// @param row_words Number of words of the bitmap.
+/// @param col Column (counted from 0) where the search starts.
+/// @param free Whether a free or a taken seat is wanted.
+/// @return Column (counted from 0) of the seat, row_words * 64 if there is none.
+static size_t next_seat(const uint64_t* words, size_t row_words, size_t col, int free) {
+  size_t word = col / 64;
+  if (word >= row_words) {
+    return row_words * 64;
+  }
+
+  // Whole words without the wanted state are skipped at once
+  uint64_t bits = (free ? words[word] : ~words[word]) & (UINT64_MAX << (col % 64));
+  while (bits == 0) {
+    if (++word == row_words) {
+      return row_words * 64;
+    }
+    bits = free ? words[word] : ~words[word];
+  }
+
+  return word * 64 + (size_t)__builtin_ctzll(bits);
+}
+
+int event_find_free_run(struct Event* event, size_t row, size_t num_seats, size_t* first_col) {
+  if (num_seats == 0 || event->row_free[row - 1] < num_seats) {
+    return 1;
+  }
+
+  const uint64_t* words = &event->free_map[(row - 1) * event->row_words];
+  size_t col = 0;
+
+  while (col < event->cols) {
+    size_t start = next_seat(words, event->row_words, col, 1);
+    if (start + num_seats > event->cols) {
+      return 1;
+    }
+
+    size_t end = next_seat(words, event->row_words, start, 0);
+    if (end - start >= num_seats) {
+      *first_col = start + 1;
+      return 0;
+    }
+    col = end;
+  }
+
+  return 1;
+}
+
+/// Grows an array to have room for at least the given number of elements, doubling its capacity.
+/// @param array Pointer to the array, updated when it moves.
+/// @param capacity Pointer to the capacity of the array, in elements.
+/// @param needed Number of elements needed.
+/// @param element_size Size of each element.
+/// @return 0 if the array has room for the elements, 1 otherwise.
+static int reserve_capacity(void** array, size_t* capacity, size_t needed, size_t element_size) {
+  if (needed <= *capacity) {
+    return 0;
+  }
+
+  size_t new_capacity = *capacity > 0 ? *capacity : 16;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+
+  void* new_array = realloc(*array, new_capacity * element_size);
+  if (new_array == NULL) {
+    return 1;
+  }
+
+  *array = new_array;
+  *capacity = new_capacity;
+  return 0;
+}
+
+int event_restore_seats(struct Event* event) {
+  size_t num_seats = event->rows * event->cols;
+  for (size_t i = 0; i < num_seats; i++) {
+    // Seats claimed by a reservation that was never committed are free
+    if (event->data[i] & PROVISIONAL_SEAT) {
+      event->data[i] = 0;
+    }
+    if (event->data[i] > event->reservations) {
+      event->reservations = event->data[i];
+    }
+  }
+
+  size_t* runs_per_id = (size_t*)calloc((size_t)event->reservations + 1, sizeof(size_t));
+  if (runs_per_id == NULL) {
+    return 1;
+  }
+
+  // The runs of each row are counted first, so the runs of each reservation end up together in the arena
+  size_t num_runs = 0;
+  for (size_t row = 0; row < event->rows; row++) {
+    const unsigned int* seats = &event->data[row * event->cols];
+    for (size_t col = 0, length; col < event->cols; col += length) {
+      for (length = 1; col + length < event->cols && seats[col + length] == seats[col]; length++) {
+      }
+
+      if (seats[col] != 0) {
+        runs_per_id[seats[col]]++;
+        num_runs++;
+        event_take_seats(event, row + 1, col + 1, length);
+      }
+    }
+  }
+
+  if (reserve_capacity((void**)&event->seat_lists, &event->seat_lists_capacity, event->reservations,
+                       sizeof(struct SeatList)) != 0 ||
+      reserve_capacity((void**)&event->arena, &event->arena_capacity, num_runs, sizeof(struct SeatRun)) != 0) {
+    free(runs_per_id);
+    return 1;
+  }
+
+  size_t offset = 0;
+  for (unsigned int id = 1; id <= event->reservations; id++) {
+    struct SeatList* list = &event->seat_lists[id - 1];
+    list->offset = offset;
+    list->num_runs = 0;
+    list->hold = NULL;
+    offset += runs_per_id[id];
+  }
+  free(runs_per_id);
+
+  for (size_t row = 0; row < event->rows; row++) {
+    const unsigned int* seats = &event->data[row * event->cols];
+    for (size_t col = 0, length; col < event->cols; col += length) {
+      for (length = 1; col + length < event->cols && seats[col + length] == seats[col]; length++) {
+      }
+
+      if (seats[col] != 0) {
+        struct SeatList* list = &event->seat_lists[seats[col] - 1];
+        struct SeatRun* run = &event->arena[list->offset + list->num_runs++];
+        run->first_seat = row * event->cols + col;
+        run->num_seats = length;
+      }
+    }
+  }
+  event->arena_size = num_runs;
+
+  return 0;
+}
+
+int event_reserve_index(struct Event* event, size_t num_changes) {
+  if (reserve_capacity((void**)&event->seat_lists, &event->seat_lists_capacity, (size_t)event->reservations + 1,
+                       sizeof(struct SeatList)) != 0 ||
+      reserve_capacity((void**)&event->arena, &event->arena_capacity, event->arena_size + num_changes,
+                       sizeof(struct SeatRun)) != 0) {
+    return 1;
+  }
+  return 0;
+}
+
+int event_index_reservation(struct Event* event, unsigned int reservation_id, const struct WatchDelta* changes,
+                            size_t num_changes) {
+  if (event_reserve_index(event, num_changes) != 0) {
+    return 1;
+  }
+
+  struct SeatList* list = &event->seat_lists[reservation_id - 1];
+  list->offset = event->arena_size;
+  list->num_runs = num_changes;
+  list->hold = NULL;
+
+  for (size_t i = 0; i < num_changes; i++) {
+    struct SeatRun* run = &event->arena[event->arena_size++];
+    run->first_seat = (changes[i].row - 1) * event->cols + changes[i].first_col - 1;
+    run->num_seats = changes[i].num_seats;
+  }
+
+  return 0;
+}
+
+const struct SeatRun* event_reservation_seats(struct Event* event, unsigned int reservation_id, size_t* num_runs) {
+  if (reservation_id == 0 || reservation_id > event->reservations) {
+    return NULL;
+  }
+
+  struct SeatList* list = &event->seat_lists[reservation_id - 1];
+  if (list->num_runs == 0) {
+    return NULL;
+  }
+
+  *num_runs = list->num_runs;
+  return &event->arena[list->offset];
+}
+
+void event_forget_reservation(struct Event* event, unsigned int reservation_id) {
+  struct SeatList* list = &event->seat_lists[reservation_id - 1];
+  event->arena_dead += list->num_runs;
+  list->num_runs = 0;
+}
+
+void event_attach_hold(struct Event* event, unsigned int reservation_id, struct Hold* hold) {
+  event->seat_lists[reservation_id - 1].hold = hold;
+}
+
+struct Hold* event_detach_hold(struct Event* event, unsigned int reservation_id) {
+  struct SeatList* list = &event->seat_lists[reservation_id - 1];
+  struct Hold* hold = list->hold;
+  list->hold = NULL;
+  return hold;
+}
+
+int event_needs_compaction(struct Event* event) {
+  return event->arena_dead > 0 && event->arena_dead * 2 >= event->arena_size;
+}
+
+int event_compact_reservations(struct Event* event) {
+  size_t live = event->arena_size - event->arena_dead;
+  struct SeatRun* arena = NULL;
+
+  if (live > 0) {
+    arena = (struct SeatRun*)malloc(live * sizeof(struct SeatRun));
+    if (arena == NULL) {
+      return 1;
+    }
+  }
+
+  // The lists are copied in the order of the ids, which is also the order they had in the old arena
+  size_t size = 0;
+  for (unsigned int id = 1; id <= event->reservations; id++) {
+    struct SeatList* list = &event->seat_lists[id - 1];
+    if (list->num_runs == 0) {
+      continue;
+    }
+
+    memcpy(&arena[size], &event->arena[list->offset], list->num_runs * sizeof(struct SeatRun));
+    list->offset = size;
+    size += list->num_runs;
+  }
+
+  free(event->arena);
+  event->arena = arena;
+  event->arena_size = size;
+  event->arena_capacity = live;
+  event->arena_dead = 0;
+  return 0;
+}
@@ -2,17 +2,96 @@
 #define SERVER_EVENT_LIST_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "common/constants.h"
+#include "common/watch.h"
+#include "timer_wheel.h"
+
+#define EVENT_LOG_SIZE 1024  // Changes to the seats remembered by each event
+#define COMBINE_SLOTS MAX_SESSION_COUNT  // Every worker may have a reservation published at once
+#define PROVISIONAL_SEAT 0x80000000u     // Bit of the tags of seats claimed by reservations not yet committed
+
+struct WatchSubscription;
+struct StoreEntry;
+struct Event;
+
+// Reservation that is released when its timer expires, unless it is confirmed before
+struct Hold {
+  TimerNode timer;              /// Timer of the expiration, scheduled in the timer wheel of the server.
+  struct Event* event;          /// Event of the reservation.
+  unsigned int reservation_id;  /// Id of the reservation.
+};
+
+// Consecutive seats of a row that belong to a reservation
+struct SeatRun {
+  size_t first_seat;  /// Index in the data of the event of the first seat.
+  size_t num_seats;   /// Number of seats.
+};
+
+// Runs of seats of a reservation, stored consecutively in the arena of its event
+struct SeatList {
+  size_t offset;      /// Position of the first run in the arena.
+  size_t num_runs;    /// Number of runs, 0 once the reservation is cancelled.
+  struct Hold* hold;  /// Hold of the reservation, NULL if it was never held or once it is confirmed.
+};
+
+enum CombineState {
+  COMBINE_EMPTY = 0,  // The slot is free
+  COMBINE_CLAIMED,    // A worker is filling the slot
+  COMBINE_PENDING,    // The reservation waits for a combiner
+  COMBINE_DONE,       // The reservation was applied and its result is available
+};
+
+// Reservation published by a worker for the combiner of a hot event to apply
+struct CombineSlot {
+  _Alignas(64) atomic_int state;  /// State of the slot, a value of enum CombineState.
+  size_t num_seats;               /// Number of seats of the reservation.
+  size_t* xs;                     /// Rows of the seats, owned by the publishing worker.
+  size_t* ys;                     /// Columns of the seats, owned by the publishing worker.
+  unsigned int reservation_id;    /// Id of the reservation once applied, 0 if it failed.
+};
 
 struct Event {
   unsigned int id;            /// Event id
   unsigned int reservations;  /// Number of reservations for the event.
+  unsigned int version;       /// Incremented whenever the seats of the event change.
 
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
 
-  unsigned int* data;     /// Array of size rows * cols with the reservations for each seat.
+  unsigned int* data;     /// Array of size rows * cols with the reservations for each seat, changed with CAS.
+  struct StoreEntry* stored;  /// Entry of the event in the persistent store that has its data, NULL if malloc'd.
+  size_t free_seats;      /// Number of seats without a reservation.
+  size_t* row_free;       /// Array of size rows with the number of seats without a reservation in each row.
+  uint64_t* free_map;     /// Bitmap of the seats without a reservation, row_words words per row.
+  size_t row_words;       /// Number of words of the bitmap of each row.
   pthread_mutex_t mutex;  // Mutex to protect the event
+  atomic_int restored;    /// Whether what is derived from the seats is built, done for stored events on first access.
+
+  struct WatchSubscription* watchers;  /// Sessions watching the event, protected by the mutex.
+
+  struct WatchDelta* log;  /// Ring with the last changes to the seats, NULL until the first one.
+  size_t log_head;         /// Position of the oldest change in the log.
+  size_t log_count;        /// Number of changes in the log.
+  unsigned int log_base;   /// The log has every change made after this version.
+
+  struct SeatList* seat_lists;  /// Array with the seats of each reservation, indexed by its id - 1.
+  size_t seat_lists_capacity;   /// Number of reservations seat_lists has room for.
+  struct SeatRun* arena;        /// Runs of every reservation, including cancelled ones until compacted.
+  size_t arena_size;            /// Number of runs in the arena.
+  size_t arena_capacity;        /// Number of runs the arena has room for.
+  size_t arena_dead;            /// Number of runs in the arena that belong to cancelled reservations.
+
+  struct CombineSlot combine[COMBINE_SLOTS];  /// Reservations published while the event is hot.
+  atomic_uint contention;                     /// Reservations that found the mutex taken while the event was cold.
+  atomic_int hot;                             /// Whether reservations are published instead of taking the mutex.
+  unsigned int lonely_passes;                 /// Consecutive combining passes that applied a single reservation.
+  pthread_mutex_t combine_mutex;              /// Mutex to wait for a combining pass with.
+  pthread_cond_t combined;                    /// Signaled when a combining pass ends.
+  int combining;                              /// Whether a combining pass is running, protected by combine_mutex.
 };
 
 struct ListNode {
@@ -26,18 +105,33 @@ struct EventList {
   struct ListNode* tail;  // Tail of the list
   pthread_rwlock_t rwl;   // Mutex to protect the list
   size_t num_events;
+
+  struct Event** index;   // The events sorted by id
+  size_t index_capacity;  // Number of events the index has room for
 };
 
 /// Creates a new event list.
 /// @return Newly created event list, NULL on failure
 struct EventList* create_list();
 
-/// Appends a new node to the list.
+/// Appends a new node to the list and adds the event to the index.
 /// @param list Event list to be modified.
 /// @param data Event to be stored in the new node.
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList* list, struct Event* data);
 
+/// Gets the position in the index of the first event whose id is not lower than the given one.
+/// @param list Event list to be searched.
+/// @param event_id Event id.
+/// @return Position of the event in list->index, list->num_events if there is none.
+size_t list_lower_bound(struct EventList* list, unsigned int event_id);
+
+/// Retrieves an event through the index of the list.
+/// @param list Event list to be searched.
+/// @param event_id Event id.
+/// @return Pointer to the event if found, NULL otherwise.
+struct Event* list_find(struct EventList* list, unsigned int event_id);
+
 /// Removes a node from the list.
 /// @param list Event list to be modified.
 /// @return 0 if the node was removed successfully, 1 otherwise.
@@ -51,4 +145,140 @@ void free_list(struct EventList* list);
 /// @return Pointer to the event if found, NULL otherwise.
 struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to);
 
+/// Allocates the availability counters and the free seat map of a new event, with every seat free.
+/// @param event Event whose dimensions are already set.
+/// @return 0 if they were allocated successfully, 1 otherwise.
+int event_init_availability(struct Event* event);
+
+/// Rebuilds the availability counters and the reservation index of an event from its seats,
+/// for events whose seats were kept elsewhere, such as a persistent store.
+/// @note Seats with a provisional tag are freed, and the number of reservations is raised to the
+/// highest id in the seats. Reservations without seats are restored as cancelled.
+/// @param event Event whose seats and number of reservations are set, with every seat available.
+/// @return 0 if the event was restored successfully, 1 otherwise.
+int event_restore_seats(struct Event* event);
+
+/// Gets a provisional tag to claim seats with, which is never a reservation id. Tags come from a
+/// single counter for every event, so no two reservations being made claim seats with the same one.
+/// @return The tag, with PROVISIONAL_SEAT set.
+unsigned int event_provisional_tag();
+
+/// Changes the value of seats from an expected one to a new one with compare-and-swap, either all
+/// of them or none. The mutex of the event is not needed to claim free seats with a provisional tag.
+/// @param event Event of the seats.
+/// @param num_seats Number of seats, none of them repeated.
+/// @param xs Array of rows of the seats, all valid.
+/// @param ys Array of columns of the seats, all valid.
+/// @param expected Value the seats must have.
+/// @param value Value stored in the seats.
+/// @return 0 if every seat was changed, 1 if one of them did not have the expected value.
+int event_claim_seats(struct Event* event, size_t num_seats, const size_t* xs, const size_t* ys,
+                      unsigned int expected, unsigned int value);
+
+/// Copies consecutive seats of an event, showing seats with a provisional tag as free.
+/// @note The mutex of the event must be held, so that committed reservations are copied whole.
+/// @param event Event of the seats.
+/// @param seats Array to store the seats in.
+/// @param first_seat Index in the data of the event of the first seat.
+/// @param num_seats Number of seats.
+void event_copy_seats(struct Event* event, unsigned int* seats, size_t first_seat, size_t num_seats);
+
+/// Marks consecutive seats of a row as taken, updating the availability counters.
+/// @note The mutex of the event must be held.
+/// @param event Event of the seats.
+/// @param row Row of the seats.
+/// @param first_col Column of the first seat.
+/// @param num_seats Number of seats, which must all be free.
+void event_take_seats(struct Event* event, size_t row, size_t first_col, size_t num_seats);
+
+/// Marks consecutive seats of a row as free, updating the availability counters.
+/// @note The mutex of the event must be held.
+/// @param event Event of the seats.
+/// @param row Row of the seats.
+/// @param first_col Column of the first seat.
+/// @param num_seats Number of seats, which must all be taken.
+void event_release_seats(struct Event* event, size_t row, size_t first_col, size_t num_seats);
+
+/// Finds the first run of consecutive free seats of a row.
+/// @note The mutex of the event must be held.
+/// @param event Event of the seats.
+/// @param row Row to search.
+/// @param num_seats Number of consecutive seats wanted.
+/// @param first_col Variable to store the column of the first seat of the run.
+/// @return 0 if the run was found, 1 otherwise.
+int event_find_free_run(struct Event* event, size_t row, size_t num_seats, size_t* first_col);
+
+/// Makes room in the reservation index of an event for its next reservation.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param num_changes Maximum number of runs of seats of the reservation.
+/// @return 0 if there is room for the reservation, 1 otherwise.
+int event_reserve_index(struct Event* event, size_t num_changes);
+
+/// Records the seats of a new reservation in the reservation index of an event.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param reservation_id Id of the reservation, the one after the last reservation of the event.
+/// @param changes The runs of seats of the reservation.
+/// @param num_changes Number of runs.
+/// @return 0 if the seats were recorded successfully, 1 otherwise.
+int event_index_reservation(struct Event* event, unsigned int reservation_id, const struct WatchDelta* changes,
+                            size_t num_changes);
+
+/// Gets the seats of a reservation from the reservation index of an event.
+/// @note The mutex of the event must be held, and the runs are only valid while it is.
+/// @param event Event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @param num_runs Variable to store the number of runs of seats in.
+/// @return The runs of seats, NULL if the reservation does not exist or was cancelled.
+const struct SeatRun* event_reservation_seats(struct Event* event, unsigned int reservation_id, size_t* num_runs);
+
+/// Removes a cancelled reservation from the reservation index of an event.
+/// @note The mutex of the event must be held. Its runs stay in the arena until it is compacted.
+/// @param event Event of the reservation.
+/// @param reservation_id Id of the reservation, which must exist.
+void event_forget_reservation(struct Event* event, unsigned int reservation_id);
+
+/// Makes a reservation a hold, which owns the seats until it is confirmed or detached.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param reservation_id Id of the reservation, which must exist.
+/// @param hold The hold, freed by free_list if it is never detached.
+void event_attach_hold(struct Event* event, unsigned int reservation_id, struct Hold* hold);
+
+/// Removes the hold of a reservation, if it has one.
+/// @note The mutex of the event must be held. The caller becomes the owner of the hold.
+/// @param event Event of the reservation.
+/// @param reservation_id Id of the reservation, which must exist.
+/// @return The hold of the reservation, NULL if it has none.
+struct Hold* event_detach_hold(struct Event* event, unsigned int reservation_id);
+
+/// Checks whether most of the arena of an event belongs to cancelled reservations.
+/// @note The mutex of the event must be held.
+/// @param event Event to check.
+/// @return 1 if the arena should be compacted, 0 otherwise.
+int event_needs_compaction(struct Event* event);
+
+/// Moves the runs of the reservations that were not cancelled to a new arena without gaps.
+/// @note The mutex of the event must be held.
+/// @param event Event whose arena is compacted.
+/// @return 0 if the arena was compacted successfully, 1 otherwise.
+int event_compact_reservations(struct Event* event);
+
+/// Records changes to the seats of an event, forgetting the oldest ones when the log is full.
+/// @note The mutex of the event must be held.
+/// @param event Event whose seats changed.
+/// @param changes The changes, all with versions greater than the ones already in the log.
+/// @param num_changes Number of changes.
+void event_log_append(struct Event* event, const struct WatchDelta* changes, size_t num_changes);
+
+/// Copies the changes made to the seats of an event after the given version.
+/// @note The mutex of the event must be held.
+/// @param event Event whose changes are copied.
+/// @param version Version known by the caller.
+/// @param changes Variable to store the changes in, to be released with free. NULL if there are none.
+/// @param num_changes Variable to store the number of changes in.
+/// @return 0 if the changes were copied, 1 if the log no longer has all of them or on failure.
+int event_log_since(struct Event* event, unsigned int version, struct WatchDelta** changes, size_t* num_changes);
+
 #endif  // SERVER_EVENT_LIST_H
@@ -8,18 +8,42 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <pthread.h>
+#include <poll.h>
 #include <signal.h>
 
 #include "common/constants.h"
+#include "common/encoding.h"
 #include "common/io.h"
+#include "common/watch.h"
 #include "operations.h"
 #include "parser_requests.h"
 #include "queue_operations.h"
+#include "stats.h"
 
 
 
 
 
+// Command line configuration of the server
+typedef struct {
+  char *register_fifo;                 /// Pathname of the server's pipe
+  unsigned int state_access_delay_us;  /// Delay of each access to the state
+  unsigned int idle_timeout_s;         /// Seconds a session may stay without requests
+  unsigned int total_timeout_s;        /// Maximum lifetime of a session in seconds
+  int lock_free_reserve;               /// Whether RESERVE claims seats with compare-and-swap
+  unsigned int combine_threshold;      /// Contended reservations after which an event uses combining
+  char *store_path;                    /// Pathname of the persistent store, NULL to keep the events in memory
+  unsigned int store_sync_ms;          /// Milliseconds between the syncs of the store
+  char *wal_path;                      /// Pathname of the write-ahead log, NULL to not log the changes
+  char *checkpoint_path;               /// Pathname of the checkpoint of the log, NULL to replay all of it
+  unsigned int checkpoint_interval_s;  /// Seconds between the checkpoints
+  char *save_path;                     /// Pathname SNAPSHOT writes the events to, NULL to refuse it
+  char *load_path;                     /// Pathname of a snapshot to start from, NULL to start empty
+  char *cdc_path;                      /// Pathname the change feed is written to, NULL to not feed the changes
+  char *standby_path;                  /// Pathname the feed of a primary is read from, NULL if the server is not a standby
+} ServerOptions;
+
+
 // Variable that indicates whether the SIGUSR1 signal has been received.
 volatile sig_atomic_t sigusr1_received = 0;
 
@@ -36,20 +60,333 @@ static void sig_handler() {
 }
 
 
+// Only interrupts the blocking call of the worker, the session timeout is checked afterwards
+static void session_timeout_handler() {}
+
+
+/// Writes the seats of a SHOW response in the encoding negotiated by the session.
+/// @note Sessions that negotiated an encoding get the encoding actually used before
+/// the seats, which is raw whenever compressing would not make the response smaller.
+/// @param session The session to respond to.
+/// @param seats The snapshot of the seats, allocated with alloc_pipe_buffer.
+/// @param num_seats The number of seats of the snapshot.
+/// @return 0 if the seats were written successfully, 1 or PIPE_CLOSED otherwise.
+static int print_seats_pipe(Session *session, const unsigned int *seats, size_t num_seats) {
+
+  int resp_pipe = session->resp_pipe;
+  if (session->show_encoding == ENCODING_RAW) {
+    return splice_uns_int_array_pipe(resp_pipe, seats, num_seats);
+  }
+
+  size_t raw_size = num_seats * sizeof(unsigned int);
+  unsigned char *encoded = (unsigned char*)malloc(raw_size > 0 ? raw_size : 1);
+  if (encoded == NULL) {
+    print_error("Error allocating the encoded seats\n");
+    return 1;
+  }
+
+  size_t encoded_size = rle_encode_seats(seats, num_seats, encoded, raw_size);
+
+  int print_value;
+  if (encoded_size == 0) {
+    print_value = print_uns_int_pipe(resp_pipe, ENCODING_RAW);
+    if (print_value == 0) {
+      print_value = splice_uns_int_array_pipe(resp_pipe, seats, num_seats);
+    }
+  } else {
+    print_value = print_uns_int_pipe(resp_pipe, ENCODING_RLE);
+    if (print_value == 0) {
+      print_value = print_size_t_pipe(resp_pipe, encoded_size);
+    }
+    if (print_value == 0) {
+      print_value = print_bytes_pipe(resp_pipe, encoded, encoded_size);
+    }
+  }
+
+  free(encoded);
+  return print_value;
+}
+
+
+/// Writes the seats of a SHOW, streaming them in chunks of rows, each preceded by
+/// its number of rows, and then the changes made to them meanwhile.
+/// @param session The session to respond to.
+/// @param cursor The position of the SHOW.
+/// @return 0 if the seats were written successfully, 1 or PIPE_CLOSED otherwise.
+static int print_show_seats(Session *session, ShowCursor *cursor) {
+
+  int resp_pipe = session->resp_pipe;
+  int print_value = print_size_t_pipe(resp_pipe, cursor->num_rows);
+  if (print_value != 0) {return print_value;}
+  print_value = print_size_t_pipe(resp_pipe, cursor->num_cols);
+  if (print_value != 0) {return print_value;}
+
+  while (1) {
+    // Each chunk is copied when it is written, however large the event is
+    while (cursor->next_row < cursor->num_rows) {
+      unsigned int *seats;
+      size_t rows;
+
+      if (ems_show_next(cursor, &seats, &rows) != 0) {return 1;}
+
+      // The pages of the copy may be handed to the pipe, it is only released afterwards
+      print_value = print_size_t_pipe(resp_pipe, rows);
+      if (print_value == 0) {
+        print_value = print_seats_pipe(session, seats, rows * cursor->num_cols);
+      }
+      if (print_value != 0) {
+        ems_show_end(cursor);
+        return print_value;
+      }
+    }
+
+    struct WatchDelta *changes;
+    size_t num_changes;
+    int restart;
+    if (ems_show_changes(cursor, &changes, &num_changes, &restart) != 0) {
+      ems_show_end(cursor);
+      return 1;
+    }
+
+    // The client applies the changes to the chunks before printing them, or drops the chunks
+    print_value = print_size_t_pipe(resp_pipe, restart ? SHOW_RESTART : num_changes);
+    if (print_value == 0 && num_changes > 0) {
+      print_value = print_bytes_pipe(resp_pipe, changes, num_changes * sizeof(struct WatchDelta));
+    }
+    free(changes);
+    if (print_value != 0 || !restart) {
+      break;
+    }
+  }
+
+  ems_show_end(cursor);
+  return print_value;
+}
+
+
+/// Writes the response to a SHOW or SHOW_REGION request, streaming the seats in
+/// chunks of rows, each preceded by its number of rows.
+/// @param session The session to respond to.
+/// @param return_value The result of the operation.
+/// @param cursor The position of the SHOW, if the operation succeeded.
+/// @return 0 if the response was written successfully, 1 or PIPE_CLOSED otherwise.
+static int print_show_response(Session *session, int return_value, ShowCursor *cursor) {
+
+  int print_value = print_int_pipe(session->resp_pipe, return_value);
+  if (print_value != 0 || return_value) {return print_value;}
+
+  return print_show_seats(session, cursor);
+}
+
+
+/// Writes the response to a MULTI_SHOW request: for each event, whether it was
+/// found followed by its seats, as in a SHOW response.
+/// @param session The session to respond to.
+/// @param return_value The result of the operation.
+/// @param num_events The number of events requested.
+/// @param results Whether each event was found.
+/// @param cursors The positions of the SHOWs of the events that were found.
+/// @return 0 if the response was written successfully, 1 or PIPE_CLOSED otherwise.
+static int print_multi_show_response(Session *session, int return_value, size_t num_events,
+                                     const int *results, ShowCursor *cursors) {
+
+  int print_value = print_int_pipe(session->resp_pipe, return_value);
+  if (print_value != 0 || return_value) {return print_value;}
+
+  for (size_t i = 0; i < num_events; i++) {
+    print_value = print_show_response(session, results[i], &cursors[i]);
+    if (print_value != 0) {return print_value;}
+  }
+  return 0;
+}
+
+
+/// Writes the response to a SHOW_SINCE request: the current version of the event,
+/// followed by either the changes since the version of the client or the whole event.
+/// @param session The session to respond to.
+/// @param return_value The result of the operation.
+/// @param version The current version of the event.
+/// @param changes The changes since the version of the client.
+/// @param num_changes The number of changes.
+/// @param cursor The position of the SHOW, if the changes were no longer available.
+/// @return 0 if the response was written successfully, 1 or PIPE_CLOSED otherwise.
+static int print_show_since_response(Session *session, int return_value, unsigned int version,
+                                     struct WatchDelta *changes, size_t num_changes, ShowCursor *cursor) {
+
+  int resp_pipe = session->resp_pipe;
+  int print_value = print_int_pipe(resp_pipe, return_value);
+  if (print_value != 0 || return_value) {return print_value;}
+
+  print_value = print_uns_int_pipe(resp_pipe, version);
+  if (print_value != 0) {return print_value;}
+
+  if (cursor->event != NULL) {
+    print_value = print_uns_int_pipe(resp_pipe, SINCE_SNAPSHOT);
+    if (print_value != 0) {return print_value;}
+    return print_show_seats(session, cursor);
+  }
+
+  print_value = print_uns_int_pipe(resp_pipe, SINCE_CHANGES);
+  if (print_value != 0) {return print_value;}
+  print_value = print_size_t_pipe(resp_pipe, num_changes);
+  if (print_value != 0 || num_changes == 0) {return print_value;}
+  return print_bytes_pipe(resp_pipe, changes, num_changes * sizeof(struct WatchDelta));
+}
+
+
+/// Writes a page of the response to a LIST_EVENTS request: the number of ids,
+/// the ids and whether there are events after them.
+/// @param resp_pipe The response pipe to write to.
+/// @param event_ids The ids of the page.
+/// @param num_events The number of ids.
+/// @param more Whether there are events after the page.
+/// @return 0 if the page was written successfully, 1 or PIPE_CLOSED otherwise.
+static int print_list_page(int resp_pipe, const unsigned int *event_ids, size_t num_events, int more) {
+
+  int print_value = print_size_t_pipe(resp_pipe, num_events);
+  if (print_value != 0) {return print_value;}
+
+  if (num_events) {
+    print_value = print_uns_int_array_pipe(resp_pipe, event_ids, num_events);
+    if (print_value != 0) {return print_value;}
+  }
+
+  return print_int_pipe(resp_pipe, more);
+}
+
+
+/// Pushes to a watching session the deltas queued for it, followed by the snapshots
+/// of the events it fell behind on.
+/// @param session The watching session.
+/// @return 0 if everything was pushed successfully, 1 or PIPE_CLOSED otherwise.
+static int push_watch_updates(Session *session) {
+
+  WatchQueue *queue = session->watch;
+  int resp_pipe = session->resp_pipe;
+  struct WatchDelta deltas[WATCH_BATCH_SIZE];
+  unsigned char batch[1 + sizeof(size_t) + sizeof(deltas)];
+  size_t num_deltas;
+
+  // Each batch of deltas is written at once: record type, number of deltas and the deltas
+  while ((num_deltas = watch_queue_take(queue, deltas, WATCH_BATCH_SIZE)) > 0) {
+    size_t deltas_size = num_deltas * sizeof(struct WatchDelta);
+    batch[0] = WATCH_DELTA;
+    memcpy(batch + 1, &num_deltas, sizeof(size_t));
+    memcpy(batch + 1 + sizeof(size_t), deltas, deltas_size);
+
+    int print_value = print_bytes_pipe(resp_pipe, batch, 1 + sizeof(size_t) + deltas_size);
+    if (print_value != 0) {return print_value;}
+  }
+
+  if (!atomic_exchange(&queue->resync_pending, 0)) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < queue->num_subscriptions; i++) {
+    struct WatchResync resync;
+    unsigned int *seats;
+
+    if (ems_watch_resync(&queue->subscriptions[i], &resync, &seats) != 0) {return 1;}
+    if (seats == NULL) {continue;}
+
+    size_t num_seats = resync.rows * resync.cols;
+    unsigned char record = WATCH_RESYNC;
+    int print_value = print_bytes_pipe(resp_pipe, &record, 1);
+    if (print_value == 0) {
+      print_value = print_bytes_pipe(resp_pipe, &resync, sizeof(resync));
+    }
+    if (print_value == 0) {
+      print_value = splice_uns_int_array_pipe(resp_pipe, seats, num_seats);
+    }
+    free_pipe_buffer(seats, num_seats);
+    if (print_value != 0) {return print_value;}
+  }
+
+  return 0;
+}
+
+
+/// Serves a session that is watching events, pushing their changes as they happen
+/// until the client sends UNWATCH.
+/// @param session The watching session.
+/// @return 0 once the session stopped watching, 1 or PIPE_CLOSED otherwise.
+static int process_watch(Session *session) {
+
+  int req_pipe = session->req_pipe;
+  struct pollfd fds[2];
+  fds[0].fd = req_pipe;
+  fds[0].events = POLLIN;
+  fds[1].fd = watch_queue_fd(session->watch);
+  fds[1].events = POLLIN;
+
+  while (1) {
+
+    if (atomic_load(&session->timed_out)) {return PIPE_CLOSED;}
+
+    int print_value = push_watch_updates(session);
+    if (print_value != 0) {return print_value;}
+
+    // Waits for either a request or something to push
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) {continue;}
+      print_error("Error waiting for the watched events\n");
+      return 1;
+    }
+
+    if (fds[0].revents == 0) {continue;}
+
+    char op_code;
+    int session_id;
+    int parse_value = parse_str_pipe(req_pipe, &op_code, 1);
+    if (parse_value == SIGNAL_DETECTED) {continue;}
+    if (parse_value != 0) {return parse_value;}
+
+    parse_value = parse_int_pipe(req_pipe, &session_id);
+    if (parse_value != 0) {return parse_value;}
+
+    if (op_code != UNWATCH) {
+      // Responses cannot be told apart from the pushed records, so only QUIT is accepted
+      if (op_code != QUIT) {
+        print_error("Only UNWATCH and QUIT are accepted while watching events\n");
+      }
+      return PIPE_CLOSED;
+    }
+
+    if (ems_unwatch(session) != 0) {return 1;}
+    if (ems_touch_session(session) != 0) {return 1;}
+
+    unsigned char record = WATCH_END;
+    return print_bytes_pipe(session->resp_pipe, &record, 1);
+  }
+}
+
+
 int process_Op_Codes(Session *session) {
 
   int active_session = 1;
 
   while (active_session) {
     
-    unsigned int event_id;
+    unsigned int event_id, encodings, version, cursor, reservation_id, hold_s;
+    int priority;
     size_t num_rows, num_cols;
-    size_t num_seats, num_events;
+    size_t first_row, first_col, last_row, last_col;
+    size_t num_seats, num_events, num_changes, page_size;
     size_t xs[MAX_RESERVATION_SIZE];
     size_t ys[MAX_RESERVATION_SIZE];
+    unsigned int watch_ids[MAX_WATCHED_EVENTS];
+    unsigned int show_ids[MAX_SHOW_EVENTS];
+    int show_results[MAX_SHOW_EVENTS];
+    ShowCursor show_cursors[MAX_SHOW_EVENTS];
+    ReservationPart *parts = NULL;
+    unsigned int reservation_ids[MAX_MULTI_EVENTS];
 
-    unsigned int *event_seats = NULL;
-    unsigned int *event_ids = NULL;
+    ShowCursor show_cursor;
+    unsigned int event_ids[MAX_LIST_PAGE_SIZE];
+    int more;
+    struct WatchDelta *changes = NULL;
+    size_t *row_free = NULL;
+    size_t free_seats;
 
     int session_id;
     char op_code;
@@ -57,13 +394,21 @@ int process_Op_Codes(Session *session) {
     int req_pipe = session->req_pipe;
     int resp_pipe = session->resp_pipe;
 
+    if (atomic_load(&session->timed_out)) {
+      ems_quit(session);
+      break;
+    }
+
     // Receives the op_code
     int parse_value = parse_str_pipe(req_pipe, &op_code, 1);
     if (parse_value == 1) {return 1;}
+    if (parse_value == SIGNAL_DETECTED) {continue;}
     if (parse_value == PIPE_CLOSED) {
       ems_quit(session);
       break;
     }
+
+    if (ems_touch_session(session) != 0) {return 1;}
     
     // Receives the session_id
     parse_value = parse_int_pipe(req_pipe, &session_id);
@@ -115,6 +460,114 @@ int process_Op_Codes(Session *session) {
           break;
         }
         break;
+      case RESERVE_MULTI:
+        parts = (ReservationPart *)malloc(MAX_MULTI_EVENTS * sizeof(ReservationPart));
+        if (parts == NULL) {return 1;}
+        parse_value = parse_reserve_multi(req_pipe, &num_events, parts, MAX_MULTI_EVENTS);
+        if (parse_value == 1) {free(parts); return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          free(parts);
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_reserve_multi(num_events, parts, reservation_ids);
+        free(parts);
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 0 && return_value == 0) {
+          print_value = print_uns_int_array_pipe(resp_pipe, reservation_ids, num_events);
+        }
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case HOLD:
+        parse_value = parse_hold(req_pipe, &hold_s, &event_id, &num_seats, xs, ys);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_hold(event_id, hold_s, num_seats, xs, ys, &reservation_id);
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 0 && return_value == 0) {
+          print_value = print_uns_int_pipe(resp_pipe, reservation_id);
+        }
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case CONFIRM:
+      case RELEASE:
+        parse_value = parse_cancel(req_pipe, &event_id, &reservation_id);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        if (op_code == CONFIRM) {
+          return_value = ems_confirm(event_id, reservation_id);
+        } else {
+          return_value = ems_release(event_id, reservation_id);
+        }
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case CANCEL:
+        parse_value = parse_cancel(req_pipe, &event_id, &reservation_id);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_cancel(event_id, reservation_id);
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case RESERVE_BEST:
+        parse_value = parse_reserve_best(req_pipe, &event_id, &num_seats, &priority, &first_row, &last_row);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_reserve_best(event_id, num_seats, priority, first_row, last_row,
+                                        &reservation_id, &first_row, &first_col);
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 0 && return_value == 0) {
+          print_value = print_uns_int_pipe(resp_pipe, reservation_id);
+        }
+        if (print_value == 0 && return_value == 0) {
+          size_t seats[2] = {first_row, first_col};
+          print_value = print_size_t_array_pipe(resp_pipe, seats, 2);
+        }
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
       case SHOW:
         parse_value = parse_show(req_pipe, &event_id);
         if (parse_value == 1) {return 1;}
@@ -123,42 +576,134 @@ int process_Op_Codes(Session *session) {
           active_session = 0;
           break;
         }
-        return_value = ems_show(event_id, &event_seats, &num_rows, &num_cols);
+        return_value = ems_show(event_id, &show_cursor);
+        print_value = print_show_response(session, return_value, &show_cursor);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case SHOW_REGION:
+        parse_value = parse_show_region(req_pipe, &event_id, &first_row, &first_col, &last_row, &last_col);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_show_region(event_id, first_row, first_col, last_row, last_col, &show_cursor);
+        print_value = print_show_response(session, return_value, &show_cursor);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case MULTI_SHOW:
+        parse_value = parse_event_ids(req_pipe, &num_events, show_ids, MAX_SHOW_EVENTS);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_multi_show(num_events, show_ids, show_results, show_cursors);
+        print_value = print_multi_show_response(session, return_value, num_events, show_results, show_cursors);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case FREE_COUNT:
+        parse_value = parse_show(req_pipe, &event_id);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_free_count(event_id, &free_seats);
         print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 0 && return_value == 0) {
+          print_value = print_size_t_pipe(resp_pipe, free_seats);
+        }
         if (print_value == 1) {return 1;}
         if (print_value == PIPE_CLOSED) {
           ems_quit(session);
           active_session = 0;
           break;
         }
-
-        if (!return_value) { // Writes the response to the pipe if the event exists
+        break;
+      case ROW_AVAILABILITY:
+        parse_value = parse_show(req_pipe, &event_id);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_row_availability(event_id, &row_free, &num_rows);
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 0 && return_value == 0) {
           print_value = print_size_t_pipe(resp_pipe, num_rows);
-          if (print_value == 1) {return 1;}
-          if (print_value == PIPE_CLOSED) {
-            ems_quit(session);
-            active_session = 0;
-            break;
-          }
-          print_value = print_size_t_pipe(resp_pipe, num_cols);
-          if (print_value == 1) {return 1;}
-          if (print_value == PIPE_CLOSED) {
-            ems_quit(session);
-            active_session = 0;
-            break;
-          }
-          print_value = print_uns_int_array_pipe(resp_pipe, event_seats, num_rows * num_cols);
-          if (print_value == 1) {return 1;}
-          if (print_value == PIPE_CLOSED) {
-            ems_quit(session);
-            active_session = 0;
-            break;
-          }
         }
-        free(event_seats);
+        if (print_value == 0 && return_value == 0) {
+          print_value = print_size_t_array_pipe(resp_pipe, row_free, num_rows);
+        }
+        free(row_free);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case SHOW_SINCE:
+        parse_value = parse_show_since(req_pipe, &event_id, &version);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_show_since(event_id, version, &version, &changes, &num_changes, &show_cursor);
+        print_value = print_show_since_response(session, return_value, version, changes, num_changes,
+                                                &show_cursor);
+        free(changes);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case SNAPSHOT:
+        return_value = ems_snapshot();
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
         break;
       case LIST_EVENTS:
-        return_value = ems_list_events(&event_ids, &num_events);
+        parse_value = parse_list_events(req_pipe, &cursor, &page_size);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        if (page_size > MAX_LIST_PAGE_SIZE) {
+          page_size = MAX_LIST_PAGE_SIZE;
+        }
+        return_value = ems_list_events(cursor, page_size, event_ids, &num_events, &more);
         print_value = print_int_pipe(resp_pipe, return_value);
         if (print_value == 1) {return 1;}
         if (print_value == PIPE_CLOSED) {
@@ -167,24 +712,53 @@ int process_Op_Codes(Session *session) {
           break;
         }
         if (return_value == 0) {
-          print_value = print_size_t_pipe(resp_pipe, num_events);
+          print_value = print_list_page(resp_pipe, event_ids, num_events, more);
           if (print_value == 1) {return 1;}
           if (print_value == PIPE_CLOSED) {
             ems_quit(session);
             active_session = 0;
             break;
           }
-          if (num_events) {
-            print_value = print_uns_int_array_pipe(resp_pipe, event_ids, num_events);
-            if (print_value == 1) {return 1;}
-            if (print_value == PIPE_CLOSED) {
-              ems_quit(session);
-              active_session = 0;
-              break;
-            }
-          }
         }
-        free(event_ids);
+        break;
+      case ENCODING:
+        parse_value = parse_encoding(req_pipe, &encodings);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        // Picks the most compact encoding supported by both sides
+        session->show_encoding = (encodings & (1u << ENCODING_RLE)) ? ENCODING_RLE : ENCODING_RAW;
+        print_value = print_int_pipe(resp_pipe, (int)session->show_encoding);
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        break;
+      case WATCH:
+        parse_value = parse_event_ids(req_pipe, &num_events, watch_ids, MAX_WATCHED_EVENTS);
+        if (parse_value == 1) {return 1;}
+        if (parse_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
+        return_value = ems_watch(session, num_events, watch_ids);
+        print_value = print_int_pipe(resp_pipe, return_value);
+        if (print_value == 0 && return_value == 0) {
+          // From now on the response pipe only carries the pushed records
+          print_value = process_watch(session);
+        }
+        if (print_value == 1) {return 1;}
+        if (print_value == PIPE_CLOSED) {
+          ems_quit(session);
+          active_session = 0;
+          break;
+        }
         break;
       default:
         break;
@@ -229,13 +803,21 @@ void* handle_client(void* arg) {
     Session *session = retrieveLastSessionRequest(buffer);
     if (session == NULL) {return NULL;}
     session->session_id = session_id;
+    session->worker = pthread_self();
     setup_result = ems_setup(session);
-    if (setup_result == 1) {return NULL;}
+    if (setup_result == 1) {
+      ems_quit(session);
+      return NULL;
+    }
     if (setup_result == PIPE_CLOSED) {
       ems_quit(session);
       continue;
     }
-    if (process_Op_Codes(session) != 0) {return NULL;}
+    if (process_Op_Codes(session) != 0) {
+      // A request interrupted by a timeout fails, but the worker can be reused
+      if (!atomic_load(&session->timed_out)) {return NULL;}
+      ems_quit(session);
+    }
   }
 }
 
@@ -258,40 +840,188 @@ int createThreads(ThreadData *threads, DynamicBuffer *buffer) {
 }
 
 
+/// Parses an unsigned integer command line value.
+/// @param str The string to be parsed.
+/// @param value Pointer to the variable to store the value in.
+/// @return 0 if the value was parsed successfully, 1 otherwise.
+static int parse_option_value(const char *str, unsigned int *value) {
+  char* endptr;
+  unsigned long int parsed = strtoul(str, &endptr, 10);
+
+  if (*str == '\0' || *endptr != '\0' || parsed > UINT_MAX) {
+    return 1;
+  }
+
+  *value = (unsigned int)parsed;
+  return 0;
+}
+
+
+/// Parses the command line: <pipe_path> [delay] followed by "--name value" options.
+/// @param argc Number of arguments.
+/// @param argv The arguments.
+/// @param options Pointer to the structure to store the options in.
+/// @return 0 if the command line is valid, 1 otherwise.
+static int parse_options(int argc, char* argv[], ServerOptions *options) {
+
+  options->register_fifo = NULL;
+  options->state_access_delay_us = STATE_ACCESS_DELAY_US;
+  options->idle_timeout_s = SESSION_IDLE_TIMEOUT_S;
+  options->total_timeout_s = SESSION_TOTAL_TIMEOUT_S;
+  options->lock_free_reserve = 0;
+  options->combine_threshold = COMBINE_HOT_THRESHOLD;
+  options->store_path = NULL;
+  options->store_sync_ms = STORE_SYNC_INTERVAL_MS;
+  options->wal_path = NULL;
+  options->checkpoint_path = NULL;
+  options->checkpoint_interval_s = CHECKPOINT_INTERVAL_S;
+  options->save_path = NULL;
+  options->load_path = NULL;
+  options->cdc_path = NULL;
+  options->standby_path = NULL;
+
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+
+    if (strncmp(argv[i], "--", 2) != 0) {
+      if (positional == 0) {
+        options->register_fifo = argv[i];
+      } else if (positional == 1) {
+        if (parse_option_value(argv[i], &options->state_access_delay_us) != 0) {
+          print_error("Invalid delay value or value too large\n");
+          return 1;
+        }
+      } else {
+        return 1;
+      }
+      positional++;
+      continue;
+    }
+
+    if (i + 1 == argc) {
+      return 1;
+    }
+
+    const char *name = argv[i];
+    const char *value = argv[++i];
+    int result;
+
+    if (strcmp(name, "--idle-timeout") == 0) {
+      result = parse_option_value(value, &options->idle_timeout_s);
+    } else if (strcmp(name, "--session-timeout") == 0) {
+      result = parse_option_value(value, &options->total_timeout_s);
+    } else if (strcmp(name, "--store") == 0) {
+      options->store_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--wal") == 0) {
+      options->wal_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--checkpoint") == 0) {
+      options->checkpoint_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--cdc") == 0) {
+      options->cdc_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--standby") == 0) {
+      options->standby_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--load") == 0) {
+      options->load_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--save") == 0) {
+      options->save_path = argv[i];
+      result = 0;
+    } else if (strcmp(name, "--checkpoint-interval") == 0) {
+      result = parse_option_value(value, &options->checkpoint_interval_s);
+    } else if (strcmp(name, "--sync-interval") == 0) {
+      result = parse_option_value(value, &options->store_sync_ms);
+    } else if (strcmp(name, "--combine-threshold") == 0) {
+      result = parse_option_value(value, &options->combine_threshold);
+    } else if (strcmp(name, "--reserve-mode") == 0) {
+      options->lock_free_reserve = strcmp(value, "cas") == 0;
+      result = !options->lock_free_reserve && strcmp(value, "lock") != 0;
+    } else {
+      return 1;
+    }
+
+    if (result != 0) {
+      print_error("Invalid option value or value too large\n");
+      return 1;
+    }
+  }
+
+  // Checkpoints only make sense along with the log they shorten, and the log replaces the store
+  return options->register_fifo == NULL || (options->checkpoint_path != NULL && options->wal_path == NULL) ||
+         (options->wal_path != NULL && options->store_path != NULL);
+}
+
+
 int main(int argc, char* argv[]) {
 
   // Establish same handler for SIGUSR1.
   if (signal(SIGUSR1, sig_handler) == SIG_ERR) {
     return 1;
   }
-  
-  if (argc < 2 || argc > 3) {
+
+  // Without SA_RESTART, so that the blocking calls of the worker are interrupted
+  struct sigaction timeout_action;
+  memset(&timeout_action, 0, sizeof(timeout_action));
+  timeout_action.sa_handler = session_timeout_handler;
+  sigemptyset(&timeout_action.sa_mask);
+  if (sigaction(SESSION_TIMEOUT_SIGNAL, &timeout_action, NULL) != 0) {
+    return 1;
+  }
+
+  ServerOptions options;
+  if (parse_options(argc, argv, &options) != 0) {
     pthread_mutex_lock(&mutex_terminal);
-    fprintf(stderr, "Usage: %s\n <pipe_path> [delay]\n", argv[0]);
+    fprintf(stderr, "Usage: %s\n <pipe_path> [delay] [--idle-timeout <s>] [--session-timeout <s>]"
+                    " [--reserve-mode lock|cas] [--combine-threshold <n>] [--store <file>] [--sync-interval <ms>]"
+                    " [--wal <file>] [--checkpoint <file>] [--checkpoint-interval <s>]"
+                    " [--load <file>] [--save <file>] [--cdc <file>] [--standby <file>]\n", argv[0]);
     pthread_mutex_unlock(&mutex_terminal);
     return 1;
   }
 
-  char* endptr;
-  unsigned int state_access_delay_us = STATE_ACCESS_DELAY_US;
-  if (argc == 3) {
-    unsigned long int delay = strtoul(argv[2], &endptr, 10);
+  if (ems_init(options.state_access_delay_us)) {
+    print_error("Failed to initialize EMS\n");
+    return 1;
+  }
+  ems_set_session_timeouts(options.idle_timeout_s, options.total_timeout_s);
+  ems_set_lock_free_reserve(options.lock_free_reserve);
+  ems_set_combine_threshold(options.combine_threshold);
+  ems_set_snapshot_path(options.save_path);
 
-    if (*endptr != '\0' || delay > UINT_MAX) {
-      print_error("Invalid delay value or value too large\n");
-      return 1;
-    }
+  if (options.store_path != NULL && ems_open_store(options.store_path, options.store_sync_ms) != 0) {
+    print_error("Failed to open the store\n");
+    return 1;
+  }
 
-    state_access_delay_us = (unsigned int)delay;
+  if (options.load_path != NULL && ems_load_snapshot(options.load_path) != 0) {
+    print_error("Failed to load the snapshot\n");
+    return 1;
   }
 
-  if (ems_init(state_access_delay_us)) {
-    print_error("Failed to initialize EMS\n");
+  if (options.wal_path != NULL && ems_open_wal(options.wal_path, options.checkpoint_path, options.checkpoint_interval_s) != 0) {
+    print_error("Failed to open the log\n");
+    return 1;
+  }
+
+  // Changes restored at startup are not fed again
+  if (options.cdc_path != NULL && ems_open_cdc(options.cdc_path) != 0) {
+    print_error("Failed to open the change feed\n");
+    return 1;
+  }
+
+  // The changes of the primary are applied once the state was restored, and fed on to the
+  // change feed of the standby like its own
+  if (options.standby_path != NULL && ems_open_standby(options.standby_path) != 0) {
+    print_error("Failed to start the standby\n");
     return 1;
   }
 
   // Fifo server pathname
-  char *register_fifo = argv[1];
+  char *register_fifo = options.register_fifo;
 
   // Removes pipe if it exists
   if (unlink(register_fifo) != 0 && errno != ENOENT) {
@@ -347,6 +1077,13 @@ int main(int argc, char* argv[]) {
         print_error("Error in printing requested information\n");
         return 1;
       }
+      pthread_mutex_lock(&mutex_terminal);
+      int stats_result = print_stats(STDOUT);
+      pthread_mutex_unlock(&mutex_terminal);
+      if (stats_result != 0) {
+        print_error("Error in printing the server statistics\n");
+        return 1;
+      }
       sigusr1_received = 0;
     }
 
@@ -5,18 +5,51 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
 
 
 #include "common/io.h"
 #include "common/constants.h"
+#include "cdc.h"
 #include "eventlist.h"
 #include "queue_operations.h"
+#include "replica.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "store.h"
+#include "timer_wheel.h"
+#include "wal.h"
+#include "watch.h"
 
 
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_us = 0;
 
+static TimerWheel* timer_wheel = NULL;
+static TimerNode compaction_timer;
+static Store* store = NULL;
+static TimerNode store_timer;
+static unsigned int store_sync_interval_ms = STORE_SYNC_INTERVAL_MS;
+static Wal* wal = NULL;
+static Cdc* cdc = NULL;
+static Replica* replica = NULL;
+static const char* checkpoint_path = NULL;
+static unsigned int checkpoint_interval_s = CHECKPOINT_INTERVAL_S;
+static pthread_t checkpoint_thread;
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t checkpoint_wake = PTHREAD_COND_INITIALIZER;
+static int checkpoint_stop = 0;
+static const char* snapshot_path = NULL;
+static int snapshot_running = 0;
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snapshot_done = PTHREAD_COND_INITIALIZER;
+static unsigned int session_idle_timeout_s = SESSION_IDLE_TIMEOUT_S;
+static unsigned int session_total_timeout_s = SESSION_TOTAL_TIMEOUT_S;
+static int lock_free_reserve = 0;
+static unsigned int combine_hot_threshold = COMBINE_HOT_THRESHOLD;
+
 pthread_mutex_t mutex_terminal = PTHREAD_MUTEX_INITIALIZER;
 
 
@@ -52,6 +85,79 @@ static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode
   return get_event(event_list, event_id, from, to);
 }
 
+/// Checks that the events may be read, which on a standby is only while it has every change of
+/// its primary.
+/// @return 0 if the events may be read, 1 otherwise.
+static int check_current() {
+  if (replica != NULL && !replica_current(replica)) {
+    print_error("Standby server is not in sync with its primary\n");
+    return 1;
+  }
+  return 0;
+}
+
+/// Rebuilds what is derived from the seats of an event of the store, the first time the event is accessed.
+/// @note The mutex of the event must not be held.
+/// @param event The event.
+/// @return 0 if the event may be used, 1 otherwise.
+static int restore_on_access(struct Event* event) {
+  if (atomic_load_explicit(&event->restored, memory_order_acquire)) {
+    return 0;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  int result = 0;
+  if (!atomic_load_explicit(&event->restored, memory_order_relaxed)) {
+    if ((event->row_free == NULL && event_init_availability(event) != 0) || event_restore_seats(event) != 0) {
+      print_error("Error restoring the event\n");
+      // The counters are built again on the next access
+      free(event->row_free);
+      free(event->free_map);
+      event->row_free = NULL;
+      event->free_map = NULL;
+      result = 1;
+    } else {
+      event->stored->reservations = event->reservations;
+      atomic_store_explicit(&event->restored, 1, memory_order_release);
+    }
+  }
+
+  pthread_mutex_unlock(&event->mutex);
+  return result;
+}
+
+/// Gets the event with the given ID under the event list read lock.
+/// @note Prints the reason to the stderr when the event cannot be obtained.
+/// @param event_id The ID of the event to get.
+/// @return Pointer to the event if found, NULL otherwise.
+static struct Event* find_event(unsigned int event_id) {
+  if (check_current() != 0) {
+    return NULL;
+  }
+
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    print_error("Error locking list rwl\n");
+    return NULL;
+  }
+
+  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+
+  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    print_error("Error unlocking event list rwl\n");
+    return NULL;
+  }
+
+  if (event == NULL) {
+    print_error("Event not found\n");
+    return NULL;
+  }
+  return restore_on_access(event) == 0 ? event : NULL;
+}
+
 /// Gets the index of a seat.
 /// @note This function assumes that the seat exists.
 /// @param event Event to get the seat index from.
@@ -60,6 +166,230 @@ static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode
 /// @return Index of the seat.
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
+/// Gets the number of milliseconds elapsed on the monotonic clock.
+/// @return The current time in milliseconds.
+static unsigned long now_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000 + (unsigned long)now.tv_nsec / 1000000;
+}
+
+/// Called by the timer wheel when one of the timeouts of a session expires.
+/// @note The worker is interrupted with SESSION_TIMEOUT_SIGNAL on every tick until
+/// it closes the session, since the signal may arrive just before it blocks.
+/// @param timer The timer of the session.
+/// @return The number of ticks after which the worker is interrupted again.
+static unsigned long session_timeout(TimerNode *timer) {
+  Session *session = (Session *)timer->arg;
+
+  int expected = TIMEOUT_NONE;
+  atomic_compare_exchange_strong(&session->timed_out, &expected, (int)session->timer_kind);
+  pthread_kill(session->worker, SESSION_TIMEOUT_SIGNAL);
+
+  return 1;
+}
+
+/// Arms the timer of the session for the earliest of its timeouts.
+/// @param session The session to arm the timer for.
+/// @return 0 if the timer was armed successfully, 1 otherwise.
+static int arm_session_timer(Session *session) {
+  unsigned long now = now_ms();
+  unsigned long delay_ms = 0;
+  session->timer_kind = TIMEOUT_NONE;
+
+  // A session watching events is expected not to send requests
+  if (session_idle_timeout_s > 0 && session->watch == NULL) {
+    delay_ms = (unsigned long)session_idle_timeout_s * 1000;
+    session->timer_kind = TIMEOUT_IDLE;
+  }
+
+  if (session_total_timeout_s > 0) {
+    unsigned long deadline = session->started_ms + (unsigned long)session_total_timeout_s * 1000;
+    unsigned long remaining = deadline > now ? deadline - now : 0;
+
+    if (session->timer_kind == TIMEOUT_NONE || remaining <= delay_ms) {
+      delay_ms = remaining;
+      session->timer_kind = TIMEOUT_TOTAL;
+    }
+  }
+
+  if (session->timer_kind == TIMEOUT_NONE) {
+    return timer_wheel_cancel(timer_wheel, &session->timer);
+  }
+
+  return timer_wheel_schedule(timer_wheel, &session->timer, timer_wheel_ms_to_ticks(timer_wheel, delay_ms));
+}
+
+/// Called by the timer wheel to compact the reservation indexes with many cancelled reservations.
+/// @note Events that are busy are skipped, so that the wheel thread never waits for a worker.
+/// @param timer The compaction timer.
+/// @return The number of ticks until the next compaction.
+static unsigned long compact_reservation_indexes(TimerNode *timer) {
+  (void)timer;
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    return timer_wheel_ms_to_ticks(timer_wheel, COMPACTION_INTERVAL_MS);
+  }
+
+  for (size_t i = 0; i < event_list->num_events; i++) {
+    struct Event *event = event_list->index[i];
+    if (pthread_mutex_trylock(&event->mutex) != 0) {
+      continue;
+    }
+
+    if (event_needs_compaction(event) && event_compact_reservations(event) != 0) {
+      print_error("Error compacting the reservation index\n");
+    }
+    pthread_mutex_unlock(&event->mutex);
+  }
+
+  pthread_rwlock_unlock(&event_list->rwl);
+  return timer_wheel_ms_to_ticks(timer_wheel, COMPACTION_INTERVAL_MS);
+}
+
+/// Appends a record to the write-ahead log and to the change feed, if the server has them.
+/// @param record The record, followed by its runs of seats.
+static void log_record(struct WalRecord* record) {
+  if (wal != NULL) {
+    wal_append(wal, record);
+    atomic_fetch_add(&server_stats.wal_records, 1);
+  }
+  if (cdc != NULL) {
+    cdc_append(cdc, record);
+  }
+}
+
+/// Checks that requests may change the state, which on a standby only its primary does.
+/// @return 0 if the state may be changed, 1 otherwise.
+static int check_writable() {
+  if (replica != NULL) {
+    print_error("Standby server is read-only\n");
+    return 1;
+  }
+  return 0;
+}
+
+/// Waits for the records appended so far to the write-ahead log to be durable, so that a
+/// request is only answered once its changes are. The records of other requests appended
+/// meanwhile are written along with them.
+/// @return 0 if the changes are durable, 1 otherwise.
+static int make_durable() {
+  if (wal != NULL && wal_wait(wal, wal_end(wal)) != 0) {
+    print_error("Error writing the log\n");
+    return 1;
+  }
+  return 0;
+}
+
+/// Allocates an event and its availability counters.
+/// @param event_id Id of the event.
+/// @param num_rows Number of rows.
+/// @param num_cols Number of columns.
+/// @param data Seats of the event kept in the store, NULL to allocate them with every seat free.
+/// @param entry Entry of the event in the store, NULL if the seats are allocated.
+/// @param restored 0 if the seats already have reservations, so the availability counters are only built from
+/// them on the first access to the event, 1 if every seat is free.
+/// @return The event, NULL on failure.
+static struct Event* new_event(unsigned int event_id, size_t num_rows, size_t num_cols, unsigned int* data,
+                               struct StoreEntry* entry, int restored) {
+  struct Event* event = malloc(sizeof(struct Event));
+
+  if (event == NULL) {
+    print_error("Error allocating memory for event\n");
+    return NULL;
+  }
+
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  event->reservations = 0;
+  event->version = 0;
+  event->watchers = NULL;
+  event->log = NULL;
+  event->log_head = 0;
+  event->log_count = 0;
+  event->log_base = 0;
+  event->seat_lists = NULL;
+  event->seat_lists_capacity = 0;
+  event->arena = NULL;
+  event->arena_size = 0;
+  event->arena_capacity = 0;
+  event->arena_dead = 0;
+  event->row_free = NULL;
+  event->free_map = NULL;
+  atomic_init(&event->restored, restored);
+  for (size_t i = 0; i < COMBINE_SLOTS; i++) {
+    atomic_init(&event->combine[i].state, COMBINE_EMPTY);
+  }
+  atomic_init(&event->contention, 0);
+  atomic_init(&event->hot, combine_hot_threshold == 0);
+  event->lonely_passes = 0;
+  event->combining = 0;
+  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
+    free(event);
+    return NULL;
+  }
+  if (pthread_mutex_init(&event->combine_mutex, NULL) != 0) {
+    pthread_mutex_destroy(&event->mutex);
+    free(event);
+    return NULL;
+  }
+  if (pthread_cond_init(&event->combined, NULL) != 0) {
+    pthread_mutex_destroy(&event->combine_mutex);
+    pthread_mutex_destroy(&event->mutex);
+    free(event);
+    return NULL;
+  }
+
+  event->stored = entry;
+  event->data = data != NULL ? data : calloc(num_rows * num_cols, sizeof(unsigned int));
+
+  if (event->data == NULL || (restored && event_init_availability(event) != 0)) {
+    print_error("Error allocating memory for event data\n");
+    if (entry == NULL) {
+      free(event->data);
+    }
+    pthread_cond_destroy(&event->combined);
+    pthread_mutex_destroy(&event->combine_mutex);
+    pthread_mutex_destroy(&event->mutex);
+    free(event);
+    return NULL;
+  }
+
+  return event;
+}
+
+/// Deallocates an event that is not in the event list.
+/// @param event The event.
+static void delete_event(struct Event* event) {
+  if (event->stored == NULL) {
+    free(event->data);
+  }
+  free(event->row_free);
+  free(event->free_map);
+  free(event->seat_lists);
+  free(event->arena);
+  pthread_cond_destroy(&event->combined);
+  pthread_mutex_destroy(&event->combine_mutex);
+  pthread_mutex_destroy(&event->mutex);
+  free(event);
+}
+
+/// Called by the timer wheel to make the changes to the persistent store durable.
+/// @param timer The store timer.
+/// @return The number of ticks until the next sync.
+static unsigned long sync_store(TimerNode *timer) {
+  (void)timer;
+
+  // Events are not added to the store while it is synced
+  if (pthread_rwlock_rdlock(&event_list->rwl) == 0) {
+    if (store_sync(store) != 0) {
+      print_error("Error syncing the store\n");
+    }
+    pthread_rwlock_unlock(&event_list->rwl);
+  }
+  return timer_wheel_ms_to_ticks(timer_wheel, store_sync_interval_ms);
+}
+
 int ems_init(unsigned int delay_us) {
   if (event_list != NULL) {
     print_error("EMS state has already been initialized\n");
@@ -69,7 +399,217 @@ int ems_init(unsigned int delay_us) {
   event_list = create_list();
   state_access_delay_us = delay_us;
 
-  return event_list == NULL;
+  if (event_list == NULL) {
+    return 1;
+  }
+
+  timer_wheel = timer_wheel_create(TIMER_TICK_MS);
+  if (timer_wheel == NULL) {
+    return 1;
+  }
+
+  timer_init(&compaction_timer, compact_reservation_indexes, NULL);
+  return timer_wheel_schedule(timer_wheel, &compaction_timer,
+                              timer_wheel_ms_to_ticks(timer_wheel, COMPACTION_INTERVAL_MS));
+}
+
+void ems_set_session_timeouts(unsigned int idle_timeout_s, unsigned int total_timeout_s) {
+  session_idle_timeout_s = idle_timeout_s;
+  session_total_timeout_s = total_timeout_s;
+}
+
+int ems_open_store(const char* path, unsigned int sync_interval_ms) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  store = store_open(path);
+  if (store == NULL) {
+    print_error("Error opening the store\n");
+    return 1;
+  }
+
+  // The seats are used where they are in the store, and what is derived from them is only rebuilt
+  // on the first access to each event, so opening the store does not read every seat
+  for (uint32_t i = 0; i < store->header->num_events; i++) {
+    struct StoreEntry* entry = &store->header->entries[i];
+    struct Event* event =
+        new_event(entry->event_id, entry->rows, entry->cols, store_event_data(store, entry), entry, 0);
+    if (event == NULL) {
+      return 1;
+    }
+
+    event->reservations = entry->reservations;
+    if (append_to_list(event_list, event) != 0) {
+      print_error("Error restoring the event\n");
+      delete_event(event);
+      return 1;
+    }
+  }
+
+  store_sync_interval_ms = sync_interval_ms > 0 ? sync_interval_ms : STORE_SYNC_INTERVAL_MS;
+  timer_init(&store_timer, sync_store, NULL);
+  return timer_wheel_schedule(timer_wheel, &store_timer, timer_wheel_ms_to_ticks(timer_wheel, store_sync_interval_ms));
+}
+
+void ems_set_lock_free_reserve(int enabled) {
+  lock_free_reserve = enabled;
+}
+
+void ems_set_combine_threshold(unsigned int threshold) {
+  combine_hot_threshold = threshold;
+}
+
+void ems_set_snapshot_path(const char* path) {
+  snapshot_path = path;
+}
+
+// Records of the state being copied for a change feed
+struct FeedState {
+  unsigned char* records;  /// The records, one after the other.
+  size_t size;             /// Bytes of the records.
+  size_t capacity;         /// Bytes the buffer has room for.
+};
+
+/// Adds a zeroed record to the state copied for a change feed.
+/// @param state The state.
+/// @param num_runs Number of runs of seats after the record.
+/// @return The record, valid until the next one is added, NULL on failure.
+static struct WalRecord* add_feed_record(struct FeedState* state, size_t num_runs) {
+  size_t size = sizeof(struct WalRecord) + num_runs * sizeof(struct WalRun);
+  if (state->size + size > state->capacity) {
+    size_t capacity = state->capacity * 2 > state->size + size ? state->capacity * 2 : state->size + size;
+    unsigned char* larger = realloc(state->records, capacity);
+    if (larger == NULL) {
+      return NULL;
+    }
+    state->records = larger;
+    state->capacity = capacity;
+  }
+
+  struct WalRecord* record = (struct WalRecord*)&state->records[state->size];
+  memset(record, 0, size);
+  record->size = (uint32_t)size;
+  record->num_runs = (uint16_t)num_runs;
+  state->size += size;
+  return record;
+}
+
+/// Adds the records that recreate an event to the state copied for a change feed: the event is
+/// created, reset, and given its reservations in order of id.
+/// @note The mutex of the event must be held.
+/// @param state The state.
+/// @param event The event.
+/// @return 0 if the records were added successfully, 1 otherwise.
+static int add_feed_event(struct FeedState* state, struct Event* event) {
+  struct WalRecord* record = add_feed_record(state, 0);
+  if (record == NULL) {
+    return 1;
+  }
+  record->type = WAL_CREATE;
+  record->event_id = event->id;
+  record->rows = event->rows;
+  record->cols = event->cols;
+
+  record = add_feed_record(state, 0);
+  if (record == NULL) {
+    return 1;
+  }
+  record->type = WAL_RESET;
+  record->event_id = event->id;
+
+  for (unsigned int reservation_id = 1; reservation_id <= event->reservations; reservation_id++) {
+    size_t num_seat_runs;
+    const struct SeatRun* seats = event_reservation_seats(event, reservation_id, &num_seat_runs);
+    if (seats == NULL) {
+      continue;
+    }
+
+    // A run of the index may go on in the next row, while the runs of a record stay in one
+    struct WalRun runs[MAX_RESERVATION_SIZE];
+    size_t num_runs = 0;
+    for (size_t i = 0; i < num_seat_runs; i++) {
+      for (size_t seat = seats[i].first_seat; seat < seats[i].first_seat + seats[i].num_seats;) {
+        size_t row_end = (seat / event->cols + 1) * event->cols;
+        size_t end = row_end < seats[i].first_seat + seats[i].num_seats ? row_end : seats[i].first_seat + seats[i].num_seats;
+        runs[num_runs++] = (struct WalRun){(uint32_t)(seat / event->cols + 1), (uint32_t)(seat % event->cols + 1),
+                                           (uint32_t)(end - seat), 0};
+        seat = end;
+      }
+    }
+
+    record = add_feed_record(state, num_runs);
+    if (record == NULL) {
+      return 1;
+    }
+    record->type = WAL_RESERVE;
+    record->event_id = event->id;
+    record->reservation_id = reservation_id;
+    memcpy(record + 1, runs, num_runs * sizeof(struct WalRun));
+  }
+  return 0;
+}
+
+/// Copies the state for a change feed, as the records that recreate every event.
+/// @note Events are copied in order of id as for a snapshot, while requests go on. The changes
+/// made meanwhile are fed after the state as well, and applying them again does nothing.
+/// @param arg Unused.
+/// @param size Variable to store the bytes of the records in.
+/// @return The records, NULL on failure.
+static unsigned char* copy_feed_state(void* arg, size_t* size) {
+  (void)arg;
+
+  // A server without events still has a state to send
+  struct FeedState state = {malloc(sizeof(struct WalRecord)), 0, sizeof(struct WalRecord)};
+  if (state.records == NULL) {
+    return NULL;
+  }
+
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    free(state.records);
+    return NULL;
+  }
+
+  int result = 0;
+  struct Event* previous = NULL;
+  for (size_t i = 0; i < event_list->num_events && result == 0; i++) {
+    struct Event* event = event_list->index[i];
+    if (restore_on_access(event) != 0 || pthread_mutex_lock(&event->mutex) != 0) {
+      result = 1;
+      break;
+    }
+    if (previous != NULL) {
+      pthread_mutex_unlock(&previous->mutex);
+    }
+    previous = event;
+    result = add_feed_event(&state, event);
+  }
+  if (previous != NULL) {
+    pthread_mutex_unlock(&previous->mutex);
+  }
+  pthread_rwlock_unlock(&event_list->rwl);
+
+  if (result != 0) {
+    free(state.records);
+    return NULL;
+  }
+  *size = state.size;
+  return state.records;
+}
+
+int ems_open_cdc(const char* path) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  cdc = cdc_open(path, wal, copy_feed_state, NULL);
+  if (cdc == NULL) {
+    print_error("Error opening the change feed\n");
+    return 1;
+  }
+  return 0;
 }
 
 int ems_terminate(DynamicBuffer *buffer, ThreadData *threads) {
@@ -79,365 +619,2241 @@ int ems_terminate(DynamicBuffer *buffer, ThreadData *threads) {
     return 1;
   }
 
+  // A snapshot being written is finished first
+  pthread_mutex_lock(&snapshot_mutex);
+  while (snapshot_running) {
+    pthread_cond_wait(&snapshot_done, &snapshot_mutex);
+  }
+  pthread_mutex_unlock(&snapshot_mutex);
+
+  // The feed of the primary is stopped first, so no change is applied while the state is freed
+  replica_close(replica);
+  replica = NULL;
+
+  // The timers refer to the events and the sessions, so they must be stopped before those are deallocated
+  timer_wheel_destroy(timer_wheel);
+  timer_wheel = NULL;
+  if (checkpoint_path != NULL) {
+    pthread_mutex_lock(&checkpoint_mutex);
+    checkpoint_stop = 1;
+    pthread_cond_signal(&checkpoint_wake);
+    pthread_mutex_unlock(&checkpoint_mutex);
+    pthread_join(checkpoint_thread, NULL);
+    checkpoint_path = NULL;
+  }
+  // The feed waits for the log to have its records
+  cdc_close(cdc);
+  cdc = NULL;
+  wal_close(wal);
+  wal = NULL;
+
   if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
     print_error("Error locking event list rwl\n");
     return 1;
   }
 
-  free_list(event_list);
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-    print_error("Error unlocking event list rwl\n");
+  free_list(event_list);
+  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    print_error("Error unlocking event list rwl\n");
+    return 1;
+  }
+
+  store_close(store);
+  store = NULL;
+
+  if (pthread_mutex_lock(&buffer->mutex) != 0) {
+    print_error("Error locking request list rwl\n");
+    return 1;
+  }
+
+  free_DynamicBuffer(buffer);
+  if (pthread_mutex_unlock(&buffer->mutex) != 0) {
+    print_error("Error unlocking event list rwl\n");
+    return 1;
+  }
+
+  free(threads);
+
+  return 0;
+}
+
+
+int make_session_request(char *req_pipe_path, char *resp_pipe_path,
+                        DynamicBuffer *buffer) {
+
+  if (pthread_mutex_lock(&active_sessions_mutex) != 0) {
+    print_error("Error locking active_sessions_mutex\n");
+    return 1;
+  }
+
+  // Waits for a session to terminate if all sessions are active 
+  while (active_sessions == MAX_SESSION_COUNT) {
+    pthread_cond_wait(&session_terminated_cond, &active_sessions_mutex);
+  }
+
+  if (pthread_mutex_unlock(&active_sessions_mutex) != 0) {
+    print_error("Error unlocking active_sessions_mutex\n");
+    return 1;
+  }
+
+  Session *session = createSession(req_pipe_path, resp_pipe_path);
+  if (session == NULL)
+    return 1;
+
+  // Writes new client to the producer-consumer buffer
+  if (addSessionRequest(buffer, session) != 0) {return 1;}
+
+  return 0;
+}
+
+int ems_setup(Session *session) {
+
+  char *req_pipe_path = session->req_pipe_path;
+  char *resp_pipe_path = session->resp_pipe_path;
+  int session_id = session->session_id;
+
+  timer_init(&session->timer, session_timeout, session);
+
+  if (pthread_mutex_lock(&active_sessions_mutex) != 0) {
+    print_error("Error locking active_sessions_mutex\n");
+    return 1;
+  }
+
+  // This session is now active, the worker is busy from this point on
+  active_sessions++;
+
+  if (pthread_mutex_unlock(&active_sessions_mutex) != 0) {
+    print_error("Error unlocking active_sessions_mutex\n");
+    return 1;
+  }
+
+  // The timeouts also cover a client that never opens its pipes
+  session->started_ms = now_ms();
+  if (arm_session_timer(session) != 0) {
+    print_error("Error arming the session timer\n");
+    return 1;
+  }
+
+  // Opens req_pipe_path
+  session->req_pipe = open(session->req_pipe_path, O_RDONLY);
+  if (session->req_pipe == -1) {
+    if (errno == EINTR && atomic_load(&session->timed_out)) {return PIPE_CLOSED;}
+    pthread_mutex_lock(&mutex_terminal);
+    fprintf(stderr, "[ERR]: open of %s failed: %s\n", req_pipe_path, strerror(errno));
+    pthread_mutex_unlock(&mutex_terminal);
+    return 1;
+  }
+
+  // Opens resp_pipe_path
+  session->resp_pipe = open(session->resp_pipe_path, O_WRONLY);
+  if (session->resp_pipe == -1) {
+    if (errno == EINTR && atomic_load(&session->timed_out)) {return PIPE_CLOSED;}
+    pthread_mutex_lock(&mutex_terminal);
+    fprintf(stderr, "[ERR]: open of %s failed: %s\n", resp_pipe_path, strerror(errno));
+    pthread_mutex_unlock(&mutex_terminal);
+    return 1;
+  }
+
+  // Returns the session ID to the client
+  int print_value = print_int_pipe(session->resp_pipe, session_id);
+  if (print_value == 1) {return 1;}
+  if (print_value == PIPE_CLOSED) {
+    return PIPE_CLOSED;
+  }
+
+  atomic_fetch_add(&server_stats.sessions_started, 1);
+
+  return 0;
+}
+
+
+int ems_touch_session(Session *session) {
+
+  // Once a timeout expired the session is bound to be closed
+  if (atomic_load(&session->timed_out)) {
+    return 0;
+  }
+
+  if (session_idle_timeout_s == 0) {
+    return 0;
+  }
+  return arm_session_timer(session);
+}
+
+
+int ems_quit(Session *session) {
+
+  // No reservation may push changes to the session once it is deallocated
+  if (ems_unwatch(session) != 0) {
+    return 1;
+  }
+
+  // The timer must be stopped before the session is deallocated
+  if (timer_wheel_cancel(timer_wheel, &session->timer) != 0) {
+    print_error("Error cancelling the session timer\n");
+    return 1;
+  }
+
+  switch (atomic_load(&session->timed_out)) {
+    case TIMEOUT_IDLE:
+      atomic_fetch_add(&server_stats.sessions_idle_timeout, 1);
+      break;
+    case TIMEOUT_TOTAL:
+      atomic_fetch_add(&server_stats.sessions_total_timeout, 1);
+      break;
+    default:
+      break;
+  }
+
+  // Closes the pipes
+  if (session->req_pipe != -1) {close(session->req_pipe);}
+  if (session->resp_pipe != -1) {close(session->resp_pipe);}
+
+  if (pthread_mutex_lock(&active_sessions_mutex) != 0) {
+    print_error("Error locking active_sessions_mutex\n");
+    return 1;
+  }
+
+  active_sessions--;
+  // Signal that a session has terminated
+  pthread_cond_signal(&session_terminated_cond);
+
+  if (pthread_mutex_unlock(&active_sessions_mutex) != 0) {
+    print_error("Error unlocking active_sessions_mutex\n");
+    return 1;
+  }
+
+  // Closes the session
+  if (closeSession(session) != 0) {return 1;}
+
+  return 0;
+}
+
+/// Adds a new event to the event list, and to the store and the log if the server has them.
+/// @note The event list must be write locked.
+/// @param event_id Id of the event, which must not exist.
+/// @param num_rows Number of rows.
+/// @param num_cols Number of columns.
+/// @return 0 if the event was added successfully, 1 otherwise.
+static int add_event(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  // The seats of a stored event live in the store, which only keeps the event once it is in the list
+  unsigned int* data = NULL;
+  struct StoreEntry* entry = NULL;
+  if (store != NULL && store_prepare_event(store, event_id, num_rows, num_cols, &entry, &data) != 0) {
+    print_error("Error adding the event to the store\n");
+    return 1;
+  }
+
+  struct Event* event = new_event(event_id, num_rows, num_cols, data, entry, 1);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (append_to_list(event_list, event) != 0) {
+    print_error("Error appending event to list\n");
+    delete_event(event);
+    return 1;
+  }
+
+  if (store != NULL) {
+    store_commit_event(store);
+  }
+
+  struct WalRecord record = {.type = WAL_CREATE, .event_id = event_id, .rows = num_rows, .cols = num_cols};
+  log_record(&record);
+  return 0;
+}
+
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+    print_error("Error locking list rwl\n");
+    return 1;
+  }
+
+  if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
+    print_error("Event already exists\n");
+    pthread_rwlock_unlock(&event_list->rwl);
+    return 1;
+  }
+
+  if (add_event(event_id, num_rows, num_cols) != 0) {
+    pthread_rwlock_unlock(&event_list->rwl);
+    return 1;
+  }
+
+  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    print_error("Error unlocking event list rwl\n");
+    return 1;
+  }
+
+  return make_durable();
+}
+
+/// Compares two seat indexes, for qsort.
+static int compare_seat_indexes(const void *a, const void *b) {
+  size_t first = *(const size_t *)a;
+  size_t second = *(const size_t *)b;
+  return (first > second) - (first < second);
+}
+
+/// Describes a reservation as runs of consecutive seats of the same row.
+/// @param event The event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @param version Version of the event with the reservation.
+/// @param num_seats Number of seats of the reservation.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @param deltas Array to store the runs in, with room for num_seats runs.
+/// @return Number of runs.
+static size_t reservation_deltas(struct Event* event, unsigned int reservation_id, unsigned int version,
+                                 size_t num_seats, size_t* xs, size_t* ys, struct WatchDelta* deltas) {
+  size_t indexes[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    indexes[i] = seat_index(event, xs[i], ys[i]);
+  }
+  qsort(indexes, num_seats, sizeof(size_t), compare_seat_indexes);
+
+  size_t num_deltas = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t row = indexes[i] / event->cols + 1;
+    size_t col = indexes[i] % event->cols + 1;
+
+    if (num_deltas > 0) {
+      struct WatchDelta* last = &deltas[num_deltas - 1];
+      if (last->row == row && last->first_col + last->num_seats >= col) {
+        // Repeated seats are only counted once
+        last->num_seats = col - last->first_col + 1;
+        continue;
+      }
+    }
+
+    deltas[num_deltas].event_id = event->id;
+    deltas[num_deltas].version = version;
+    deltas[num_deltas].reservation_id = reservation_id;
+    deltas[num_deltas].row = row;
+    deltas[num_deltas].first_col = col;
+    deltas[num_deltas].num_seats = 1;
+    num_deltas++;
+  }
+
+  return num_deltas;
+}
+
+/// Sends changes to the seats of an event to the sessions watching it.
+/// @note The mutex of the event must be held, so that the watchers get the changes in the order of the versions.
+/// @param event Event whose seats changed.
+/// @param deltas The changes.
+/// @param num_deltas Number of changes.
+static void publish_deltas(struct Event* event, const struct WatchDelta* deltas, size_t num_deltas) {
+  if (event->watchers != NULL) {
+    size_t fell_behind = watch_publish(event->watchers, deltas, num_deltas);
+    atomic_fetch_add(&server_stats.watch_deltas, num_deltas);
+    atomic_fetch_add(&server_stats.watch_resyncs, fell_behind);
+  }
+}
+
+/// Releases the mutex of an event, then wakes up the sessions sent changes of it meanwhile, so
+/// that watchers never make the mutex wait for a system call.
+/// @param event The event.
+/// @return 0 if the mutex was released successfully, an error number otherwise.
+static int unlock_event(struct Event* event) {
+  int result = pthread_mutex_unlock(&event->mutex);
+  watch_flush();
+  return result;
+}
+
+/// Appends a reservation to the write-ahead log and to the change feed, if the server has them.
+/// @param event Event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @param deltas The runs of seats of the reservation.
+/// @param num_deltas Number of runs.
+static void log_reservation(struct Event* event, unsigned int reservation_id, const struct WatchDelta* deltas,
+                            size_t num_deltas) {
+  if (wal == NULL && cdc == NULL) {
+    return;
+  }
+
+  struct {
+    struct WalRecord record;
+    struct WalRun runs[MAX_RESERVATION_SIZE];
+  } entry;
+  entry.record = (struct WalRecord){.type = WAL_RESERVE, .num_runs = (uint16_t)num_deltas, .event_id = event->id,
+                                    .reservation_id = reservation_id};
+
+  for (size_t i = 0; i < num_deltas; i++) {
+    entry.runs[i] = (struct WalRun){(uint32_t)deltas[i].row, (uint32_t)deltas[i].first_col,
+                                    (uint32_t)deltas[i].num_seats, 0};
+  }
+  log_record(&entry.record);
+}
+
+/// Makes a reservation of seats that are known to be free or claimed with a provisional tag,
+/// recording and publishing its changes.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param num_seats Number of seats of the reservation.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @param claimed Value the seats have, 0 or the provisional tag they were claimed with.
+/// @return Id of the reservation, 0 on failure.
+static unsigned int commit_reservation(struct Event* event, size_t num_seats, size_t* xs, size_t* ys,
+                                       unsigned int claimed) {
+  unsigned int reservation_id = event->reservations + 1;
+  if (reservation_id & PROVISIONAL_SEAT) {
+    print_error("Too many reservations\n");
+    return 0;
+  }
+
+  struct WatchDelta deltas[MAX_RESERVATION_SIZE];
+  size_t num_deltas = reservation_deltas(event, reservation_id, event->version + 1, num_seats, xs, ys, deltas);
+
+  if (event_index_reservation(event, reservation_id, deltas, num_deltas) != 0) {
+    print_error("Error allocating memory for the reservation index\n");
+    return 0;
+  }
+
+  // Free seats may still be claimed without the mutex, so they are taken all at once or not at all
+  if (event_claim_seats(event, num_seats, xs, ys, claimed, reservation_id) != 0) {
+    event_forget_reservation(event, reservation_id);
+    print_error("Seat already reserved\n");
+    return 0;
+  }
+
+  event->reservations = reservation_id;
+  if (event->stored != NULL) {
+    event->stored->reservations = reservation_id;
+  }
+  event->version++;
+  event_log_append(event, deltas, num_deltas);
+  log_reservation(event, reservation_id, deltas, num_deltas);
+
+  // The runs have no repeated seats, so they also keep the availability counters up to date
+  for (size_t i = 0; i < num_deltas; i++) {
+    event_take_seats(event, deltas[i].row, deltas[i].first_col, deltas[i].num_seats);
+  }
+
+  publish_deltas(event, deltas, num_deltas);
+  return reservation_id;
+}
+
+/// Cancels a reservation, freeing its seats and recording and publishing the change.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param seats Runs of seats of the reservation, from the reservation index.
+/// @param num_runs Number of runs.
+/// @param reservation_id Id of the reservation.
+static void release_reservation(struct Event* event, const struct SeatRun* seats, size_t num_runs,
+                                unsigned int reservation_id) {
+  event->version++;
+
+  // Runs are published in batches, a freed run is a change without a reservation
+  struct WatchDelta deltas[MAX_RESERVATION_SIZE];
+  size_t num_deltas = 0;
+  for (size_t i = 0; i < num_runs; i++) {
+    for (size_t j = 0; j < seats[i].num_seats; j++) {
+      __atomic_store_n(&event->data[seats[i].first_seat + j], 0, __ATOMIC_RELEASE);
+    }
+
+    struct WatchDelta* delta = &deltas[num_deltas++];
+    delta->event_id = event->id;
+    delta->version = event->version;
+    delta->reservation_id = 0;
+    delta->row = seats[i].first_seat / event->cols + 1;
+    delta->first_col = seats[i].first_seat % event->cols + 1;
+    delta->num_seats = seats[i].num_seats;
+    event_release_seats(event, delta->row, delta->first_col, delta->num_seats);
+
+    if (num_deltas == MAX_RESERVATION_SIZE || i == num_runs - 1) {
+      event_log_append(event, deltas, num_deltas);
+      publish_deltas(event, deltas, num_deltas);
+      num_deltas = 0;
+    }
+  }
+
+  event_forget_reservation(event, reservation_id);
+
+  struct WalRecord record = {.type = WAL_RELEASE, .event_id = event->id, .reservation_id = reservation_id};
+  log_record(&record);
+}
+
+/// Removes the repeated seats of a reservation, leaving the rest in the order of the seats of the event.
+/// @param event Event of the reservation.
+/// @param num_seats Number of seats of the reservation, all valid.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return Number of seats left.
+static size_t unique_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  size_t indexes[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    indexes[i] = seat_index(event, xs[i], ys[i]);
+  }
+  qsort(indexes, num_seats, sizeof(size_t), compare_seat_indexes);
+
+  size_t num_unique = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    if (num_unique > 0 && indexes[i] == indexes[i - 1]) {
+      continue;
+    }
+    xs[num_unique] = indexes[i] / event->cols + 1;
+    ys[num_unique] = indexes[i] % event->cols + 1;
+    num_unique++;
+  }
+
+  return num_unique;
+}
+
+/// Checks that the given seats are all valid and free, removing the repeated ones, which a seat
+/// claimed with compare-and-swap would otherwise conflict with.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param num_seats Pointer to the number of seats of the reservation, updated to the seats left.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return 0 if the seats can be reserved, 1 otherwise.
+static int check_seats(struct Event* event, size_t* num_seats, size_t* xs, size_t* ys) {
+  for (size_t i = 0; i < *num_seats; i++) {
+    if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
+      print_error("Seat out of bounds\n");
+      return 1;
+    }
+  }
+  *num_seats = unique_seats(event, *num_seats, xs, ys);
+
+  for (size_t i = 0; i < *num_seats; i++) {
+    if (__atomic_load_n(&event->data[seat_index(event, xs[i], ys[i])], __ATOMIC_ACQUIRE) != 0) {
+      print_error("Seat already reserved\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/// Reserves the given seats if they are all valid and free.
+/// @note The mutex of the event must be held.
+/// @param event Event of the reservation.
+/// @param num_seats Number of seats of the reservation.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return Id of the reservation, 0 on failure.
+static unsigned int reserve_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  if (check_seats(event, &num_seats, xs, ys) != 0) {
+    return 0;
+  }
+
+  return commit_reservation(event, num_seats, xs, ys, 0);
+}
+
+/// Applies every reservation published for a hot event, in a single pass.
+/// @note The mutex of the event must be held.
+/// @param event The hot event.
+static void combine_pass(struct Event* event) {
+  size_t applied = 0;
+
+  for (size_t i = 0; i < COMBINE_SLOTS; i++) {
+    struct CombineSlot* slot = &event->combine[i];
+    if (atomic_load_explicit(&slot->state, memory_order_acquire) != COMBINE_PENDING) {
+      continue;
+    }
+
+    slot->reservation_id = reserve_seats(event, slot->num_seats, slot->xs, slot->ys);
+    atomic_store_explicit(&slot->state, COMBINE_DONE, memory_order_release);
+    applied++;
+  }
+
+  // An event whose reservations stopped arriving together goes back to the plain lock path
+  if (applied > 1) {
+    event->lonely_passes = 0;
+  } else if (++event->lonely_passes >= COMBINE_COLD_PASSES && combine_hot_threshold != 0) {
+    event->lonely_passes = 0;
+    atomic_store(&event->contention, 0);
+    atomic_store(&event->hot, 0);
+  }
+
+  atomic_fetch_add(&server_stats.combine_passes, 1);
+  atomic_fetch_add(&server_stats.combined_reservations, applied);
+}
+
+/// Applies the reservations published for a hot event, then wakes up the workers waiting for them.
+/// @note The mutex of the event must be held.
+/// @param event The hot event.
+static void run_combiner(struct Event* event) {
+  pthread_mutex_lock(&event->combine_mutex);
+  event->combining = 1;
+  pthread_mutex_unlock(&event->combine_mutex);
+
+  combine_pass(event);
+
+  pthread_mutex_lock(&event->combine_mutex);
+  event->combining = 0;
+  pthread_cond_broadcast(&event->combined);
+  pthread_mutex_unlock(&event->combine_mutex);
+}
+
+/// Publishes a reservation of a hot event and waits for a combiner to apply it,
+/// becoming the combiner whenever no other is running.
+/// @param event The hot event.
+/// @param num_seats Number of seats of the reservation.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return 0 if the reservation was created, 1 if it failed, -1 if there was no free slot to publish it.
+static int combine_reservation(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  struct CombineSlot* slot = NULL;
+  for (size_t i = 0; i < COMBINE_SLOTS && slot == NULL; i++) {
+    int expected = COMBINE_EMPTY;
+    if (atomic_compare_exchange_strong(&event->combine[i].state, &expected, COMBINE_CLAIMED)) {
+      slot = &event->combine[i];
+    }
+  }
+
+  if (slot == NULL) {
+    return -1;
+  }
+
+  slot->num_seats = num_seats;
+  slot->xs = xs;
+  slot->ys = ys;
+  atomic_store_explicit(&slot->state, COMBINE_PENDING, memory_order_release);
+
+  // Workers sleep while a combiner runs, and one that finds its reservation still pending afterwards
+  // waits for the mutex to become the next combiner, so no worker spins
+  while (atomic_load_explicit(&slot->state, memory_order_acquire) != COMBINE_DONE) {
+    pthread_mutex_lock(&event->combine_mutex);
+    while (event->combining && atomic_load_explicit(&slot->state, memory_order_acquire) != COMBINE_DONE) {
+      pthread_cond_wait(&event->combined, &event->combine_mutex);
+    }
+    pthread_mutex_unlock(&event->combine_mutex);
+
+    if (atomic_load_explicit(&slot->state, memory_order_acquire) == COMBINE_DONE) {
+      break;
+    }
+
+    if (pthread_mutex_lock(&event->mutex) != 0) {
+      print_error("Error locking mutex\n");
+      continue;
+    }
+    if (atomic_load_explicit(&slot->state, memory_order_acquire) != COMBINE_DONE) {
+      run_combiner(event);
+    }
+    if (unlock_event(event) != 0) {
+      print_error("Error unlocking mutex\n");
+    }
+  }
+
+  unsigned int reservation_id = slot->reservation_id;
+  atomic_store_explicit(&slot->state, COMBINE_EMPTY, memory_order_release);
+  return reservation_id == 0;
+}
+
+/// Applies a record of the write-ahead log or of the feed of a primary to the state, unless the
+/// state already has it.
+/// @param record The record, followed by its runs of seats.
+/// @param arg Unused.
+/// @return 0 if the record was applied or skipped, 1 if it could not be applied.
+static int apply_record(const struct WalRecord* record, void* arg) {
+  (void)arg;
+
+  // The end of the state of a primary is only of interest to the receiver of its feed
+  if (record->type == WAL_SYNC) {
+    return 0;
+  }
+
+  // The records of other events are applied meanwhile by other threads
+  if (record->type == WAL_CREATE) {
+    if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+      return 1;
+    }
+    int result = list_find(event_list, record->event_id) == NULL &&
+                 add_event(record->event_id, (size_t)record->rows, (size_t)record->cols) != 0;
+    pthread_rwlock_unlock(&event_list->rwl);
+    return result;
+  }
+
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    return 1;
+  }
+  struct Event* event = list_find(event_list, record->event_id);
+  pthread_rwlock_unlock(&event_list->rwl);
+
+  if (event == NULL || restore_on_access(event) != 0 || pthread_mutex_lock(&event->mutex) != 0) {
+    return 1;
+  }
+
+  int result = 0;
+  if (record->type == WAL_RESERVE && record->reservation_id > event->reservations) {
+    const struct WalRun* runs = (const struct WalRun*)(record + 1);
+    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    size_t num_seats = 0;
+
+    for (size_t i = 0; i < record->num_runs && result == 0; i++) {
+      if (num_seats + runs[i].num_seats > MAX_RESERVATION_SIZE) {
+        result = 1;
+        break;
+      }
+      for (uint32_t j = 0; j < runs[i].num_seats; j++, num_seats++) {
+        xs[num_seats] = runs[i].row;
+        ys[num_seats] = runs[i].first_col + j;
+      }
+    }
+
+    // Ids only grow, so the reservation gets the id it had whatever failed before it
+    event->reservations = record->reservation_id - 1;
+    result = result || check_seats(event, &num_seats, xs, ys) != 0 ||
+             commit_reservation(event, num_seats, xs, ys, 0) == 0;
+  } else if (record->type == WAL_RELEASE) {
+    size_t num_runs;
+    const struct SeatRun* seats = event_reservation_seats(event, record->reservation_id, &num_runs);
+    if (seats != NULL) {
+      release_reservation(event, seats, num_runs, record->reservation_id);
+    }
+  } else if (record->type == WAL_RESET) {
+    // The reservations the primary has come next, with the ids they have there
+    for (unsigned int reservation_id = 1; reservation_id <= event->reservations; reservation_id++) {
+      size_t num_runs;
+      const struct SeatRun* seats = event_reservation_seats(event, reservation_id, &num_runs);
+      if (seats != NULL) {
+        release_reservation(event, seats, num_runs, reservation_id);
+      }
+    }
+    event->reservations = 0;
+    if (event->stored != NULL) {
+      event->stored->reservations = 0;
+    }
+
+    // Replaying the log of the standby takes the ids again from here as well
+    struct WalRecord reset = {.type = WAL_RESET, .event_id = event->id};
+    log_record(&reset);
+  }
+
+  unlock_event(event);
+  return result;
+}
+
+/// Adds an event of a snapshot to the state, unless the state already has it.
+/// @param saved The entry of the event in the snapshot.
+/// @param packed The packed seats of the event.
+/// @param arg Unused.
+/// @return 0 if the event was restored or skipped, 1 if it could not be restored.
+static int restore_event(const struct SnapshotEvent* saved, const void* packed, void* arg) {
+  (void)arg;
+
+  if (list_find(event_list, saved->event_id) != NULL) {
+    return 0;
+  }
+
+  if (add_event(saved->event_id, (size_t)saved->rows, (size_t)saved->cols) != 0) {
+    return 1;
+  }
+
+  // The seats are unpacked straight into the event, which starts with every seat free
+  struct Event* event = list_find(event_list, saved->event_id);
+  snapshot_unpack_seats(saved, packed, event->data);
+  event->reservations = saved->reservations;
+  if (event_restore_seats(event) != 0) {
+    print_error("Error restoring the event\n");
+    return 1;
+  }
+
+  if (event->stored != NULL) {
+    event->stored->reservations = event->reservations;
+  }
+  return 0;
+}
+
+/// Grows a buffer of seats to fit the seats of an event, before its mutex is taken to copy them.
+/// @param event The event.
+/// @param seats Buffer to copy the seats to.
+/// @param capacity Number of seats that fit in the buffer.
+/// @return 0 if the seats of the event fit in the buffer, 1 otherwise.
+static int fit_event_seats(struct Event* event, unsigned int** seats, size_t* capacity) {
+  size_t num_seats = event->rows * event->cols;
+  if (num_seats > *capacity) {
+    unsigned int* larger = realloc(*seats, num_seats * sizeof(unsigned int));
+    if (larger == NULL) {
+      return 1;
+    }
+    *seats = larger;
+    *capacity = num_seats;
+  }
+  return 0;
+}
+
+/// Copies an event to be written to a snapshot once its mutex is released, so that packing and
+/// writing its seats never make requests to the event wait.
+/// @note The mutex of the event must be held.
+/// @param event The event.
+/// @param saved The entry of the event in the snapshot.
+/// @param seats Buffer with room for the seats of the event.
+static void copy_event(struct Event* event, struct SnapshotEvent* saved, unsigned int* seats) {
+  *saved = (struct SnapshotEvent){
+      .event_id = event->id, .reservations = event->reservations, .rows = event->rows, .cols = event->cols};
+  event_copy_seats(event, seats, 0, event->rows * event->cols);
+}
+
+/// Writes every event to the checkpoint, replacing the previous one once it is durable, and then
+/// drops the records before it from the log.
+/// @note Events are copied one at a time while requests go on, and the changes logged after the
+/// checkpoint started are skipped when they are replayed over events that already have them.
+/// @return 0 if the checkpoint was written successfully, 1 otherwise.
+static int write_checkpoint() {
+  uint64_t lsn = wal_end(wal);
+
+  // Events are never removed, so the ones that exist now can be copied without the list lock
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    return 1;
+  }
+  size_t num_events = event_list->num_events;
+  struct Event** events = malloc((num_events > 0 ? num_events : 1) * sizeof(struct Event*));
+  if (events != NULL) {
+    memcpy(events, event_list->index, num_events * sizeof(struct Event*));
+  }
+  pthread_rwlock_unlock(&event_list->rwl);
+
+  SnapshotWriter* writer = events != NULL ? snapshot_create(checkpoint_path, lsn, (uint32_t)num_events) : NULL;
+  if (writer == NULL) {
+    free(events);
+    return 1;
+  }
+
+  unsigned int* seats = NULL;
+  size_t capacity = 0;
+  int result = 0;
+  for (size_t i = 0; i < num_events && result == 0; i++) {
+    if (fit_event_seats(events[i], &seats, &capacity) != 0 || restore_on_access(events[i]) != 0 ||
+        pthread_mutex_lock(&events[i]->mutex) != 0) {
+      result = 1;
+      break;
+    }
+    struct SnapshotEvent saved;
+    copy_event(events[i], &saved, seats);
+    pthread_mutex_unlock(&events[i]->mutex);
+    result = snapshot_add_event(writer, &saved, seats);
+  }
+  free(seats);
+  free(events);
+
+  // The log must reach the checkpoint, or replaying it after a crash would leave a gap
+  if (result != 0 || wal_wait(wal, lsn) != 0) {
+    snapshot_abort(writer);
+    return 1;
+  }
+
+  if (snapshot_commit(writer) != 0) {
+    return 1;
+  }
+  atomic_fetch_add(&server_stats.checkpoints, 1);
+
+  // The records the checkpoint has are never replayed again, so the log drops them
+  if (wal_truncate(wal, lsn) != 0) {
+    print_error("Error truncating the log\n");
+  }
+  return 0;
+}
+
+static void* checkpointer(void* arg) {
+  (void)arg;
+
+  // Signals are handled by the other threads
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  pthread_mutex_lock(&checkpoint_mutex);
+  while (!checkpoint_stop) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += checkpoint_interval_s;
+    while (!checkpoint_stop && pthread_cond_timedwait(&checkpoint_wake, &checkpoint_mutex, &deadline) == 0) {
+    }
+    if (checkpoint_stop) {
+      break;
+    }
+
+    pthread_mutex_unlock(&checkpoint_mutex);
+    if (write_checkpoint() != 0) {
+      print_error("Error writing the checkpoint\n");
+    }
+    pthread_mutex_lock(&checkpoint_mutex);
+  }
+  pthread_mutex_unlock(&checkpoint_mutex);
+
+  return NULL;
+}
+
+int ems_open_wal(const char* path, const char* checkpoint, unsigned int checkpoint_interval) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Records the store seems to have could be lost with the page they were in, and never replayed
+  if (store != NULL) {
+    print_error("The log cannot be used along with a persistent store\n");
+    return 1;
+  }
+
+  // The log is replayed from where the checkpoint was taken, so replay time stays bounded
+  uint64_t checkpoint_lsn = 0;
+  if (checkpoint != NULL && snapshot_load(checkpoint, restore_event, NULL, &checkpoint_lsn) != 0) {
+    print_error("Error loading the checkpoint\n");
+    return 1;
+  }
+
+  // Nothing is logged while the log is replayed, so the records are not appended again
+  long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t valid_size;
+  if (wal_replay(path, checkpoint_lsn, num_cpus > 0 ? (size_t)num_cpus : 1, apply_record, NULL, &valid_size) != 0) {
+    print_error("Error replaying the log\n");
+    return 1;
+  }
+
+  wal = wal_open(path, valid_size);
+  if (wal == NULL) {
+    print_error("Error opening the log\n");
+    return 1;
+  }
+
+  if (checkpoint != NULL) {
+    checkpoint_path = checkpoint;
+    checkpoint_interval_s = checkpoint_interval > 0 ? checkpoint_interval : CHECKPOINT_INTERVAL_S;
+    if (pthread_create(&checkpoint_thread, NULL, checkpointer, NULL) != 0) {
+      print_error("Error creating the checkpoint thread\n");
+      checkpoint_path = NULL;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int ems_load_snapshot(const char* path) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Unlike a checkpoint, a snapshot that was asked for must exist
+  if (access(path, R_OK) != 0) {
+    print_error("Snapshot not found\n");
+    return 1;
+  }
+
+  // Events are restored in order of id, so each one is appended to the end of the index
+  uint64_t lsn;
+  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+    print_error("Error locking list rwl\n");
+    return 1;
+  }
+  int result = snapshot_load(path, restore_event, NULL, &lsn);
+  pthread_rwlock_unlock(&event_list->rwl);
+
+  if (result != 0) {
+    print_error("Error loading the snapshot\n");
+  }
+  return result;
+}
+
+int ems_open_standby(const char* path) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  // The records arrive in the order the primary made the changes, and are applied in that order
+  replica = replica_open(path, apply_record, NULL);
+  if (replica == NULL) {
+    print_error("Error receiving the feed of the primary\n");
+    return 1;
+  }
+  return 0;
+}
+
+/// Reserves seats claiming them with compare-and-swap, so that conflicting reservations fail
+/// without waiting for the mutex of the event, which is only held to record the reservation.
+/// @param event Event of the reservation.
+/// @param num_seats Number of seats of the reservation.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return 0 if the reservation was made, 1 otherwise.
+static int reserve_lock_free(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  // The dimensions of an event never change, so the seats can be validated without the mutex
+  for (size_t i = 0; i < num_seats; i++) {
+    if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
+      print_error("Seat out of bounds\n");
+      return 1;
+    }
+  }
+  num_seats = unique_seats(event, num_seats, xs, ys);
+
+  // The tag is ours alone, so the seats that have it are the ones this reservation claimed
+  unsigned int tag = event_provisional_tag();
+  if (event_claim_seats(event, num_seats, xs, ys, 0, tag) != 0) {
+    atomic_fetch_add(&server_stats.claim_conflicts, 1);
+    print_error("Seat already reserved\n");
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    event_claim_seats(event, num_seats, xs, ys, tag, 0);
+    return 1;
+  }
+
+  // The tags become the id while the mutex is held, so SHOW copies the reservation whole or not at all
+  unsigned int reservation_id = commit_reservation(event, num_seats, xs, ys, tag);
+  if (reservation_id == 0) {
+    event_claim_seats(event, num_seats, xs, ys, tag, 0);
+  }
+
+  if (unlock_event(event) != 0) {
+    print_error("Error unlocking mutex\n");
+    return 1;
+  }
+
+  return reservation_id == 0;
+}
+
+int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (lock_free_reserve) {
+    return reserve_lock_free(event, num_seats, xs, ys) || make_durable();
+  }
+
+  if (atomic_load(&event->hot)) {
+    int result = combine_reservation(event, num_seats, xs, ys);
+    if (result != -1) {
+      return result || make_durable();
+    }
+  }
+
+  // Cold events take the mutex directly, counting how often it is contended to detect when they get hot
+  if (pthread_mutex_trylock(&event->mutex) != 0) {
+    if (atomic_fetch_add(&event->contention, 1) + 1 >= combine_hot_threshold) {
+      atomic_store(&event->hot, 1);
+    }
+
+    if (pthread_mutex_lock(&event->mutex) != 0) {
+      print_error("Error locking mutex\n");
+      return 1;
+    }
+  }
+
+  unsigned int reservation_id = reserve_seats(event, num_seats, xs, ys);
+
+  if (unlock_event(event) != 0) {
+    print_error("Error unlocking mutex\n");
+    return 1;
+  }
+
+  return reservation_id == 0 || make_durable();
+}
+
+int ems_reserve_multi(size_t num_parts, ReservationPart *parts, unsigned int *reservation_ids) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  if (num_parts == 0 || num_parts > MAX_MULTI_EVENTS) {
+    print_error("Invalid number of events\n");
+    return 1;
+  }
+
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    print_error("Error locking list rwl\n");
+    return 1;
+  }
+
+  // A single access to the state resolves every event
+  struct timespec delay = {0, state_access_delay_us * 1000};
+  nanosleep(&delay, NULL);  // Should not be removed
+
+  struct Event* events[MAX_MULTI_EVENTS];
+  for (size_t i = 0; i < num_parts; i++) {
+    events[i] = list_find(event_list, parts[i].event_id);
+  }
+
+  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    print_error("Error unlocking event list rwl\n");
+    return 1;
+  }
+
+  // The events are locked in the order of their ids, so that transactions never wait for each other in a cycle
+  size_t order[MAX_MULTI_EVENTS];
+  for (size_t i = 0; i < num_parts; i++) {
+    if (events[i] == NULL) {
+      print_error("Event not found\n");
+      return 1;
+    }
+    if (restore_on_access(events[i]) != 0) {
+      return 1;
+    }
+
+    size_t j = i;
+    while (j > 0 && parts[order[j - 1]].event_id > parts[i].event_id) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+
+    if (j > 0 && parts[order[j - 1]].event_id == parts[i].event_id) {
+      print_error("Event repeated in the reservation\n");
+      return 1;
+    }
+  }
+
+  size_t locked = 0;
+  int result = 0;
+  for (; locked < num_parts; locked++) {
+    if (pthread_mutex_lock(&events[order[locked]]->mutex) != 0) {
+      print_error("Error locking mutex\n");
+      result = 1;
+      break;
+    }
+  }
+
+  // Nothing is changed until every event is known to accept its seats
+  for (size_t i = 0; i < num_parts && result == 0; i++) {
+    ReservationPart *part = &parts[i];
+    if (check_seats(events[i], &part->num_seats, part->xs, part->ys) != 0) {
+      result = 1;
+    } else if (event_reserve_index(events[i], part->num_seats) != 0) {
+      print_error("Error allocating memory for the reservation index\n");
+      result = 1;
+    }
+  }
+
+  // Seats claimed without the mutex could still make a commit fail, so every part claims its seats first,
+  // with a tag of the transaction alone, and a failed claim only gives back the parts that were claimed
+  unsigned int tag = result == 0 ? event_provisional_tag() : 0;
+  size_t claimed = 0;
+  for (; claimed < num_parts && result == 0; claimed++) {
+    if (event_claim_seats(events[claimed], parts[claimed].num_seats, parts[claimed].xs, parts[claimed].ys, 0, tag) != 0) {
+      print_error("Seat already reserved\n");
+      result = 1;
+      break;
+    }
+  }
+  if (result != 0) {
+    while (claimed > 0) {
+      claimed--;
+      event_claim_seats(events[claimed], parts[claimed].num_seats, parts[claimed].xs, parts[claimed].ys, tag, 0);
+    }
+  }
+
+  for (size_t i = 0; i < num_parts && result == 0; i++) {
+    reservation_ids[i] = commit_reservation(events[i], parts[i].num_seats, parts[i].xs, parts[i].ys, tag);
+  }
+
+  while (locked > 0) {
+    if (pthread_mutex_unlock(&events[order[--locked]]->mutex) != 0) {
+      print_error("Error unlocking mutex\n");
+      result = 1;
+    }
+  }
+  watch_flush();
+
+  return result || make_durable();
+}
+
+/// Called by the timer wheel when a hold expires, releasing its seats.
+/// @param timer The timer of the hold.
+/// @return 0, or 1 to try again in the next tick if the event could not be locked.
+static unsigned long hold_expired(TimerNode *timer) {
+  struct Hold* hold = (struct Hold*)timer->arg;
+  struct Event* event = hold->event;
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  // The hold may have been confirmed or released while the timer was expiring, and then it is no longer ours
+  int expired = event_detach_hold(event, hold->reservation_id) == hold;
+  if (expired) {
+    size_t num_runs;
+    const struct SeatRun* seats = event_reservation_seats(event, hold->reservation_id, &num_runs);
+    if (seats != NULL) {
+      release_reservation(event, seats, num_runs, hold->reservation_id);
+    }
+  }
+
+  unlock_event(event);
+
+  if (expired) {
+    free(hold);
+  }
+  return 0;
+}
+
+/// Stops the timer of a hold detached from its reservation and deallocates it.
+/// @note The mutex of the event must not be held, since the timer may be waiting for it.
+/// @param hold The hold, or NULL if the reservation had none.
+static void stop_hold(struct Hold* hold) {
+  if (hold == NULL) {
+    return;
+  }
+
+  if (timer_wheel_cancel(timer_wheel, &hold->timer) != 0) {
+    print_error("Error cancelling the hold timer\n");
+  }
+  free(hold);
+}
+
+int ems_hold(unsigned int event_id, unsigned int hold_s, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* reservation_id) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  if (hold_s == 0) {
+    print_error("Invalid hold duration\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  // Allocated before the seats are reserved, so that nothing can fail after that
+  struct Hold* hold = (struct Hold*)malloc(sizeof(struct Hold));
+  if (hold == NULL) {
+    print_error("Error allocating memory for hold\n");
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    free(hold);
+    return 1;
+  }
+
+  *reservation_id = reserve_seats(event, num_seats, xs, ys);
+  if (*reservation_id == 0) {
+    unlock_event(event);
+    free(hold);
+    return 1;
+  }
+
+  // The timer cannot expire before the hold is attached, since its callback needs the event mutex
+  hold->event = event;
+  hold->reservation_id = *reservation_id;
+  timer_init(&hold->timer, hold_expired, hold);
+  event_attach_hold(event, *reservation_id, hold);
+
+  // A hold that could never expire would keep its seats forever, so its seats are given back
+  unsigned long ticks = timer_wheel_ms_to_ticks(timer_wheel, (unsigned long)hold_s * 1000);
+  if (timer_wheel_schedule(timer_wheel, &hold->timer, ticks) != 0) {
+    print_error("Error scheduling the hold timer\n");
+    event_detach_hold(event, *reservation_id);
+    size_t num_runs;
+    const struct SeatRun* seats = event_reservation_seats(event, *reservation_id, &num_runs);
+    if (seats != NULL) {
+      release_reservation(event, seats, num_runs, *reservation_id);
+    }
+    unlock_event(event);
+    stop_hold(hold);
+    return 1;
+  }
+
+  if (unlock_event(event) != 0) {
+    print_error("Error unlocking mutex\n");
+    return 1;
+  }
+
+  return make_durable();
+}
+
+/// Ends the hold of a reservation, keeping or releasing its seats.
+/// @param event_id Id of the event.
+/// @param reservation_id Id of the reservation.
+/// @param keep Whether the seats are kept as a regular reservation.
+/// @return 0 if the hold was ended successfully, 1 otherwise.
+static int end_hold(unsigned int event_id, unsigned int reservation_id, int keep) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  size_t num_runs;
+  const struct SeatRun* seats = event_reservation_seats(event, reservation_id, &num_runs);
+  struct Hold* hold = seats != NULL ? event_detach_hold(event, reservation_id) : NULL;
+  if (hold == NULL) {
+    print_error("Hold not found\n");
+    unlock_event(event);
+    return 1;
+  }
+
+  if (!keep) {
+    release_reservation(event, seats, num_runs, reservation_id);
+  }
+
+  if (unlock_event(event) != 0) {
+    print_error("Error unlocking mutex\n");
+    stop_hold(hold);
+    return 1;
+  }
+
+  stop_hold(hold);
+  return keep ? 0 : make_durable();
+}
+
+int ems_confirm(unsigned int event_id, unsigned int reservation_id) {
+  return end_hold(event_id, reservation_id, 1);
+}
+
+int ems_release(unsigned int event_id, unsigned int reservation_id) {
+  return end_hold(event_id, reservation_id, 0);
+}
+
+/// Starts a SHOW of a region of the given event.
+/// @param event The event to show.
+/// @param first_row First row of the region.
+/// @param first_col First column of the region.
+/// @param num_rows Number of rows of the region.
+/// @param num_cols Number of columns of the region.
+/// @param cursor The cursor to initialize.
+static void init_show_cursor(struct Event* event, size_t first_row, size_t first_col,
+                             size_t num_rows, size_t num_cols, ShowCursor *cursor) {
+  cursor->event = event;
+  cursor->first_row = first_row;
+  cursor->first_col = first_col;
+  cursor->num_rows = num_rows;
+  cursor->num_cols = num_cols;
+  cursor->next_row = 0;
+  cursor->seats = NULL;
+  cursor->num_seats = 0;
+  cursor->version = 0;
+  cursor->restarts = 0;
+
+  // Chunks of whole rows of about SHOW_CHUNK_BYTES, at least one row at a time
+  size_t row_size = num_cols * sizeof(unsigned int);
+  cursor->chunk_rows = row_size > 0 && row_size < SHOW_CHUNK_BYTES ? SHOW_CHUNK_BYTES / row_size : 1;
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  size_t num_runs;
+  const struct SeatRun* seats = event_reservation_seats(event, reservation_id, &num_runs);
+  if (seats == NULL) {
+    print_error("Reservation not found\n");
+    unlock_event(event);
+    return 1;
+  }
+
+  // A held reservation may also be cancelled, which ends the hold
+  struct Hold* hold = event_detach_hold(event, reservation_id);
+  release_reservation(event, seats, num_runs, reservation_id);
+
+  if (unlock_event(event) != 0) {
+    print_error("Error unlocking mutex\n");
+    stop_hold(hold);
+    return 1;
+  }
+
+  stop_hold(hold);
+  return make_durable();
+}
+
+/// Gets the row searched in a given position of the order of a RESERVE_BEST.
+/// @param priority Order in which the rows are searched, a value of enum ROW_PRIORITY.
+/// @param first_row First row of the search.
+/// @param last_row Last row of the search.
+/// @param position Position in the order, smaller than the number of rows searched.
+/// @return The row in that position.
+static size_t row_in_priority(int priority, size_t first_row, size_t last_row, size_t position) {
+  switch (priority) {
+    case ROWS_BACK:
+      return last_row - position;
+    case ROWS_CENTER: {
+      // Alternates around the middle row until the rows in front run out, then goes on to the back
+      size_t middle = first_row + (last_row - first_row) / 2;
+      size_t in_front = middle - first_row;
+      if (position > 2 * in_front) {
+        return middle + position - in_front;
+      }
+      size_t distance = (position + 1) / 2;
+      return position % 2 == 1 ? middle + distance : middle - distance;
+    }
+    default:
+      return first_row + position;
+  }
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, int priority, size_t first_row, size_t last_row,
+                     unsigned int *reservation_id, size_t *row, size_t *first_col) {
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (check_writable() != 0) {
+    return 1;
+  }
+
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
+    print_error("Invalid number of seats\n");
+    return 1;
+  }
+
+  if (priority != ROWS_FRONT && priority != ROWS_BACK && priority != ROWS_CENTER) {
+    print_error("Invalid row priority\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  if (first_row == 0) {
+    first_row = 1;
+  }
+  if (last_row == 0) {
+    last_row = event->rows;
+  }
+
+  if (first_row > last_row || last_row > event->rows || num_seats > event->cols) {
+    print_error("Seat out of bounds\n");
+    unlock_event(event);
+    return 1;
+  }
+
+  int found = 0;
+  for (size_t position = 0; position < last_row - first_row + 1 && !found; position++) {
+    size_t candidate = row_in_priority(priority, first_row, last_row, position);
+    if (event_find_free_run(event, candidate, num_seats, first_col) == 0) {
+      *row = candidate;
+      found = 1;
+    }
+  }
+
+  if (!found) {
+    print_error("Not enough consecutive free seats\n");
+    unlock_event(event);
+    return 1;
+  }
+
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    xs[i] = *row;
+    ys[i] = *first_col + i;
+  }
+  *reservation_id = commit_reservation(event, num_seats, xs, ys, 0);
+  if (*reservation_id == 0) {
+    unlock_event(event);
+    return 1;
+  }
+
+  if (unlock_event(event) != 0) {
+    print_error("Error unlocking mutex\n");
+    return 1;
+  }
+
+  return make_durable();
+}
+
+int ems_show(unsigned int event_id, ShowCursor *cursor) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  init_show_cursor(event, 1, 1, event->rows, event->cols, cursor);
+  return 0;
+}
+
+int ems_multi_show(size_t num_events, unsigned int *event_ids, int *results, ShowCursor *cursors) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (num_events > MAX_SHOW_EVENTS) {
+    print_error("Too many events to show\n");
+    return 1;
+  }
+
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    print_error("Error locking list rwl\n");
+    return 1;
+  }
+
+  // A single access to the state resolves every event
+  struct timespec delay = {0, state_access_delay_us * 1000};
+  nanosleep(&delay, NULL);  // Should not be removed
+
+  struct Event* events[MAX_SHOW_EVENTS];
+  for (size_t i = 0; i < num_events; i++) {
+    events[i] = list_find(event_list, event_ids[i]);
+  }
+
+  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
+    print_error("Error unlocking event list rwl\n");
+    return 1;
+  }
+
+  for (size_t i = 0; i < num_events; i++) {
+    results[i] = events[i] == NULL || restore_on_access(events[i]) != 0;
+    if (events[i] == NULL) {
+      print_error("Event not found\n");
+      continue;
+    }
+    if (results[i] != 0) {
+      continue;
+    }
+    init_show_cursor(events[i], 1, 1, events[i]->rows, events[i]->cols, &cursors[i]);
+  }
+  return 0;
+}
+
+int ems_show_region(unsigned int event_id, size_t first_row, size_t first_col, size_t last_row,
+                    size_t last_col, ShowCursor *cursor) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  // The dimensions of an event never change, so the region is checked without locking
+  if (first_row == 0 || first_row > last_row || last_row > event->rows ||
+      first_col == 0 || first_col > last_col || last_col > event->cols) {
+    print_error("Region out of bounds\n");
+    return 1;
+  }
+
+  init_show_cursor(event, first_row, first_col, last_row - first_row + 1, last_col - first_col + 1, cursor);
+  return 0;
+}
+
+int ems_free_count(unsigned int event_id, size_t *free_seats) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  *free_seats = event->free_seats;
+
+  if (pthread_mutex_unlock(&event->mutex) != 0) {
+    print_error("Error unlocking mutex\n");
+    return 1;
+  }
+  return 0;
+}
+
+int ems_row_availability(unsigned int event_id, size_t **row_free, size_t *num_rows) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  *num_rows = event->rows;
+  *row_free = (size_t*)malloc(event->rows * sizeof(size_t) + 1);
+  if (*row_free == NULL) {
+    print_error("Error allocating the row availability\n");
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    free(*row_free);
+    *row_free = NULL;
+    return 1;
+  }
+
+  memcpy(*row_free, event->row_free, event->rows * sizeof(size_t));
+
+  if (pthread_mutex_unlock(&event->mutex) != 0) {
+    print_error("Error unlocking mutex\n");
+    free(*row_free);
+    *row_free = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+int ems_show_since(unsigned int event_id, unsigned int since_version, unsigned int *version,
+                   struct WatchDelta **changes, size_t *num_changes, ShowCursor *cursor) {
+
+  if (event_list == NULL) {
+    print_error("EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Event* event = find_event(event_id);
+  if (event == NULL) {
+    return 1;
+  }
+
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
+    return 1;
+  }
+
+  *version = event->version;
+  int full = event_log_since(event, since_version, changes, num_changes);
+
+  if (pthread_mutex_unlock(&event->mutex) != 0) {
+    print_error("Error unlocking mutex\n");
+    free(*changes);
+    return 1;
+  }
+
+  // Chunks copied after the version was read may already have newer changes, which
+  // is harmless since the client applies them again on its next incremental SHOW
+  if (full) {
+    init_show_cursor(event, 1, 1, event->rows, event->cols, cursor);
+  } else {
+    cursor->event = NULL;
+  }
+  return 0;
+}
+
+/// Copies a region of the seats of an event as they were between two changes. The seats are copied
+/// without the mutex and kept if the version of the event did not change meanwhile, so that large
+/// copies do not delay the reservations. Only after OPTIMISTIC_COPIES changes is the mutex held.
+/// @note Returns with the mutex of the event held if the seats were copied.
+/// @param event The event.
+/// @param seats Array to copy the rows * cols seats to.
+/// @param first_row First row of the region.
+/// @param first_col First column of the region.
+/// @param rows Number of rows of the region.
+/// @param cols Number of columns of the region.
+/// @return 0 if the seats were copied, 1 otherwise.
+static int copy_seats_locked(struct Event* event, unsigned int* seats, size_t first_row, size_t first_col,
+                             size_t rows, size_t cols) {
+  unsigned int copied_version = 0;
+
+  for (int attempt = 0;; attempt++) {
+    if (pthread_mutex_lock(&event->mutex) != 0) {
+      print_error("Error locking mutex\n");
+      return 1;
+    }
+
+    // The previous copy is kept if nothing changed, or the next one is made with the mutex held
+    if (attempt > 0 && event->version == copied_version) {
+      return 0;
+    }
+    int locked = attempt == OPTIMISTIC_COPIES;
+    copied_version = event->version;
+    if (!locked && pthread_mutex_unlock(&event->mutex) != 0) {
+      print_error("Error unlocking mutex\n");
+      return 1;
+    }
+
+    if (cols == event->cols) {
+      event_copy_seats(event, seats, seat_index(event, first_row, 1), rows * cols);
+    } else {
+      for (size_t i = 0; i < rows; i++) {
+        event_copy_seats(event, seats + i * cols, seat_index(event, first_row + i, first_col), cols);
+      }
+    }
+
+    if (locked) {
+      return 0;
+    }
+  }
+}
+
+/// Copies rows of the region of a SHOW to a new buffer, releasing the copy of the previous chunk.
+/// @param cursor The position of the SHOW.
+/// @param first_row Row of the region the copy starts at, counted from 0.
+/// @param rows Number of rows to copy.
+/// @return 0 if the rows were copied successfully, 1 otherwise.
+static int copy_show_rows(ShowCursor *cursor, size_t first_row, size_t rows) {
+
+  struct Event* event = cursor->event;
+  size_t cols = cursor->num_cols;
+
+  // The pages of the previous chunk may have been handed to the pipe, so they are never written again
+  ems_show_end(cursor);
+  cursor->seats = alloc_pipe_buffer(rows * cols);
+  if (cursor->seats == NULL) {
+    print_error("Error allocating the event seats\n");
+    return 1;
+  }
+  cursor->num_seats = rows * cols;
+
+  if (copy_seats_locked(event, cursor->seats, cursor->first_row + first_row, cursor->first_col, rows, cols) != 0) {
+    ems_show_end(cursor);
     return 1;
   }
 
-  if (pthread_mutex_lock(&buffer->mutex) != 0) {
-    print_error("Error locking request list rwl\n");
-    return 1;
+  // The changes applied to the chunks are the ones made after the first was copied
+  if (first_row == 0) {
+    cursor->version = event->version;
   }
 
-  free_DynamicBuffer(buffer);
-  if (pthread_mutex_unlock(&buffer->mutex) != 0) {
-    print_error("Error unlocking event list rwl\n");
+  if (pthread_mutex_unlock(&event->mutex) != 0) {
+    print_error("Error unlocking mutex\n");
+    ems_show_end(cursor);
     return 1;
   }
-
-  free(threads);
-
   return 0;
 }
 
+int ems_show_next(ShowCursor *cursor, unsigned int **seats, size_t *num_rows) {
 
-int make_session_request(char *req_pipe_path, char *resp_pipe_path,
-                        DynamicBuffer *buffer) {
-
-  if (pthread_mutex_lock(&active_sessions_mutex) != 0) {
-    print_error("Error locking active_sessions_mutex\n");
-    return 1;
+  size_t cols = cursor->num_cols;
+  size_t rows = cursor->num_rows - cursor->next_row;
+  if (rows > cursor->chunk_rows) {
+    rows = cursor->chunk_rows;
   }
 
-  // Waits for a session to terminate if all sessions are active 
-  while (active_sessions == MAX_SESSION_COUNT) {
-    pthread_cond_wait(&session_terminated_cond, &active_sessions_mutex);
+  *seats = NULL;
+  *num_rows = rows;
+  if (rows == 0) {
+    return 0;
   }
 
-  if (pthread_mutex_unlock(&active_sessions_mutex) != 0) {
-    print_error("Error unlocking active_sessions_mutex\n");
-    return 1;
+  // A SHOW whose changes kept leaving the log is copied whole, and its chunks are taken from that copy
+  if (cursor->restarts == SHOW_RESTARTS) {
+    if (cursor->next_row == 0 && copy_show_rows(cursor, 0, cursor->num_rows) != 0) {
+      return 1;
+    }
+    *seats = cursor->seats + cursor->next_row * cols;
+  } else {
+    if (copy_show_rows(cursor, cursor->next_row, rows) != 0) {
+      return 1;
+    }
+    *seats = cursor->seats;
   }
 
-  Session *session = createSession(req_pipe_path, resp_pipe_path);
-  if (session == NULL)
-    return 1;
-
-  // Writes new client to the producer-consumer buffer
-  if (addSessionRequest(buffer, session) != 0) {return 1;}
-
+  cursor->next_row += rows;
   return 0;
 }
 
-int ems_setup(Session *session) {
-
-  char *req_pipe_path = session->req_pipe_path;
-  char *resp_pipe_path = session->resp_pipe_path;
-  int session_id = session->session_id;
+int ems_show_changes(ShowCursor *cursor, struct WatchDelta **changes, size_t *num_changes, int *restart) {
 
-  // Opens req_pipe_path
-  int req_pipe = open(session->req_pipe_path, O_RDONLY);
-  if (req_pipe == -1) {
-    pthread_mutex_lock(&mutex_terminal);
-    fprintf(stderr, "[ERR]: open of %s failed: %s\n", req_pipe_path, strerror(errno));
-    pthread_mutex_unlock(&mutex_terminal);
-    return 1;
-  }
+  struct Event* event = cursor->event;
+  *changes = NULL;
+  *num_changes = 0;
+  *restart = 0;
 
-  // Opens resp_pipe_path
-  int resp_pipe = open(session->resp_pipe_path, O_WRONLY);
-  if (resp_pipe == -1) {
-    pthread_mutex_lock(&mutex_terminal);
-    fprintf(stderr, "[ERR]: open of %s failed: %s\n", resp_pipe_path, strerror(errno));
-    pthread_mutex_unlock(&mutex_terminal);
-    return 1;
+  // A region copied whole has no changes to apply
+  if (cursor->restarts == SHOW_RESTARTS) {
+    return 0;
   }
 
-  if (pthread_mutex_lock(&active_sessions_mutex) != 0) {
-    print_error("Error locking active_sessions_mutex\n");
+  if (pthread_mutex_lock(&event->mutex) != 0) {
+    print_error("Error locking mutex\n");
     return 1;
   }
-
-  // This session is now active
-  active_sessions++;
-
-  if (pthread_mutex_unlock(&active_sessions_mutex) != 0) {
-    print_error("Error unlocking active_sessions_mutex\n");
+  int lost = event_log_since(event, cursor->version, changes, num_changes);
+  if (pthread_mutex_unlock(&event->mutex) != 0) {
+    print_error("Error unlocking mutex\n");
+    free(*changes);
+    *changes = NULL;
     return 1;
   }
 
-  // Returns the session ID to the client
-  int print_value = print_int_pipe(resp_pipe, session_id);
-  if (print_value == 1) {return 1;}
-  if (print_value == PIPE_CLOSED) {
-    return PIPE_CLOSED;
+  if (lost) {
+    ems_show_end(cursor);
+    cursor->next_row = 0;
+    cursor->restarts++;
+    *restart = 1;
+    return 0;
   }
 
-  session->req_pipe = req_pipe;
-  session->resp_pipe = resp_pipe;
+  // Only the changes to the region are kept, clipped to it and counted from its first seat
+  size_t kept = 0;
+  size_t last_row = cursor->first_row + cursor->num_rows - 1;
+  size_t last_col = cursor->first_col + cursor->num_cols - 1;
+  for (size_t i = 0; i < *num_changes; i++) {
+    struct WatchDelta change = (*changes)[i];
+    size_t first = change.first_col > cursor->first_col ? change.first_col : cursor->first_col;
+    size_t last = change.first_col + change.num_seats - 1 < last_col ? change.first_col + change.num_seats - 1 : last_col;
+    if (change.row < cursor->first_row || change.row > last_row || first > last) {
+      continue;
+    }
 
+    change.row -= cursor->first_row - 1;
+    change.first_col = first - cursor->first_col + 1;
+    change.num_seats = last - first + 1;
+    (*changes)[kept++] = change;
+  }
+  *num_changes = kept;
+  if (kept == 0) {
+    free(*changes);
+    *changes = NULL;
+  }
   return 0;
 }
 
+void ems_show_end(ShowCursor *cursor) {
+  free_pipe_buffer(cursor->seats, cursor->num_seats);
+  cursor->seats = NULL;
+  cursor->num_seats = 0;
+}
 
-int ems_quit(Session *session) {
-
-  // Closes the pipes and session
-  close(session->req_pipe);
-  close(session->resp_pipe);
-  if (closeSession(session) != 0) {return 1;}
-
-  if (pthread_mutex_lock(&active_sessions_mutex) != 0) {
-    print_error("Error locking active_sessions_mutex\n");
-    return 1;
-  }
+/// Removes the first subscriptions of a queue from their events.
+/// @param queue The queue of the subscriptions.
+/// @param num_subscriptions Number of subscriptions to remove.
+/// @return 0 if it was successfully made, 1 otherwise.
+static int unsubscribe(WatchQueue *queue, size_t num_subscriptions) {
+  for (size_t i = 0; i < num_subscriptions; i++) {
+    WatchSubscription *subscription = &queue->subscriptions[i];
+    struct Event* event = subscription->event;
+
+    if (pthread_mutex_lock(&event->mutex) != 0) {
+      print_error("Error locking mutex\n");
+      return 1;
+    }
 
-  active_sessions--;
-  // Signal that a session has terminated
-  pthread_cond_signal(&session_terminated_cond);
+    WatchSubscription **link = &event->watchers;
+    while (*link != subscription) {
+      link = &(*link)->next;
+    }
+    *link = subscription->next;
 
-  if (pthread_mutex_unlock(&active_sessions_mutex) != 0) {
-    print_error("Error unlocking active_sessions_mutex\n");
-    return 1;
+    if (pthread_mutex_unlock(&event->mutex) != 0) {
+      print_error("Error unlocking mutex\n");
+      return 1;
+    }
   }
-
   return 0;
 }
 
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+int ems_watch(Session *session, size_t num_events, unsigned int *event_ids) {
 
   if (event_list == NULL) {
     print_error("EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
-    print_error("Error locking list rwl\n");
+  if (session->watch != NULL) {
+    print_error("Session is already watching events\n");
     return 1;
   }
 
-  if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
-    print_error("Event already exists\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+  if (num_events == 0 || num_events > MAX_WATCHED_EVENTS) {
+    print_error("Invalid number of events to watch\n");
     return 1;
   }
 
-  struct Event* event = malloc(sizeof(struct Event));
-
-  if (event == NULL) {
-    print_error("Error allocating memory for event\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    return 1;
+  struct Event* events[MAX_WATCHED_EVENTS];
+  for (size_t i = 0; i < num_events; i++) {
+    events[i] = find_event(event_ids[i]);
+    if (events[i] == NULL) {
+      return 1;
+    }
   }
 
-  event->id = event_id;
-  event->rows = num_rows;
-  event->cols = num_cols;
-  event->reservations = 0;
-  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event);
+  WatchQueue *queue = watch_queue_create();
+  if (queue == NULL) {
+    print_error("Error creating the watch queue\n");
     return 1;
   }
 
-  event->data = calloc(num_rows * num_cols, sizeof(unsigned int));
+  for (size_t i = 0; i < num_events; i++) {
+    WatchSubscription *subscription = &queue->subscriptions[i];
+    subscription->event = events[i];
+    subscription->queue = queue;
+    // The watcher starts from a snapshot of the event
+    subscription->needs_resync = 1;
+
+    if (pthread_mutex_lock(&events[i]->mutex) != 0) {
+      print_error("Error locking mutex\n");
+      unsubscribe(queue, i);
+      watch_queue_destroy(queue);
+      return 1;
+    }
 
-  if (event->data == NULL) {
-    print_error("Error allocating memory for event data\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event);
-    return 1;
-  }
+    subscription->next = events[i]->watchers;
+    events[i]->watchers = subscription;
 
-  if (append_to_list(event_list, event) != 0) {
-    print_error("Error appending event to list\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event->data);
-    free(event);
-    return 1;
+    if (pthread_mutex_unlock(&events[i]->mutex) != 0) {
+      print_error("Error unlocking mutex\n");
+      unsubscribe(queue, i + 1);
+      watch_queue_destroy(queue);
+      return 1;
+    }
   }
 
-  event_list->num_events++;
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-    print_error("Error unlocking event list rwl\n");
-    return 1;
-  }
+  queue->num_subscriptions = num_events;
+  atomic_store(&queue->resync_pending, 1);
+  session->watch = queue;
 
-  return 0;
+  return arm_session_timer(session);
 }
 
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
-  if (event_list == NULL) {
-    print_error("EMS state must be initialized\n");
-    return 1;
+int ems_unwatch(Session *session) {
+
+  WatchQueue *queue = session->watch;
+  if (queue == NULL) {
+    return 0;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    print_error("Error locking list rwl\n");
+  if (unsubscribe(queue, queue->num_subscriptions) != 0) {
     return 1;
   }
 
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  session->watch = NULL;
+  watch_queue_destroy(queue);
+  return 0;
+}
 
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-    print_error("Error unlocking event list rwl\n");
-    return 1;
-  }
+int ems_watch_resync(WatchSubscription *subscription, struct WatchResync *resync, unsigned int **seats) {
 
-  if (event == NULL) {
-    print_error("Event not found\n");
-    return 1;
-  }
+  struct Event* event = subscription->event;
+  size_t num_seats = event->rows * event->cols;
+  *seats = NULL;
 
+  // Only the subscriptions that fell behind are copied, a later one is resynced on the next pass
   if (pthread_mutex_lock(&event->mutex) != 0) {
     print_error("Error locking mutex\n");
     return 1;
   }
-
-  for (size_t i = 0; i < num_seats; i++) {
-    if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
-      print_error("Seat out of bounds\n");
-      pthread_mutex_unlock(&event->mutex);
-      return 1;
-    }
+  int needs_resync = subscription->needs_resync;
+  if (pthread_mutex_unlock(&event->mutex) != 0) {
+    print_error("Error unlocking mutex\n");
+  }
+  if (!needs_resync) {
+    return 0;
   }
 
-  for (size_t i = 0; i < event->rows * event->cols; i++) {
-    for (size_t j = 0; j < num_seats; j++) {
-      if (seat_index(event, xs[j], ys[j]) != i) {
-        continue;
-      }
-
-      if (event->data[i] != 0) {
-        print_error("Seat already reserved\n");
-        pthread_mutex_unlock(&event->mutex);
-        return 1;
-      }
-
-      break;
-    }
+  *seats = alloc_pipe_buffer(num_seats);
+  if (*seats == NULL) {
+    print_error("Error allocating the event seats\n");
+    return 1;
   }
 
-  unsigned int reservation_id = ++event->reservations;
+  // Deltas published after the version of the copy are queued once the resync is cleared
+  if (copy_seats_locked(event, *seats, 1, 1, event->rows, event->cols) != 0) {
+    free_pipe_buffer(*seats, num_seats);
+    *seats = NULL;
+    return 1;
+  }
 
-  for (size_t i = 0; i < num_seats; i++) {
-    event->data[seat_index(event, xs[i], ys[i])] = reservation_id;
+  needs_resync = subscription->needs_resync;
+  if (needs_resync) {
+    resync->event_id = event->id;
+    resync->version = event->version;
+    resync->rows = event->rows;
+    resync->cols = event->cols;
+    subscription->needs_resync = 0;
   }
 
   if (pthread_mutex_unlock(&event->mutex) != 0) {
     print_error("Error unlocking mutex\n");
-    return 1;
   }
 
+  if (!needs_resync) {
+    free_pipe_buffer(*seats, num_seats);
+    *seats = NULL;
+  }
   return 0;
 }
 
-int ems_show(unsigned int event_id, unsigned int **seats, size_t *num_rows, size_t *num_cols) {
-
+int ems_list_events(unsigned int cursor, size_t page_size, unsigned int *event_ids,
+                    size_t *num_events, int *more) {
   if (event_list == NULL) {
     print_error("EMS state must be initialized\n");
     return 1;
   }
 
+  if (check_current() != 0) {
+    return 1;
+  }
+
   if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
     print_error("Error locking list rwl\n");
     return 1;
   }
 
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  // Only the page is copied, however many events exist
+  size_t first = list_lower_bound(event_list, cursor);
+  size_t count = event_list->num_events - first;
+  if (count > page_size) {
+    count = page_size;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    event_ids[i] = event_list->index[first + i]->id;
+  }
+  *num_events = count;
+  *more = first + count < event_list->num_events;
 
   if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
     print_error("Error unlocking event list rwl\n");
     return 1;
   }
+  return 0;
+}
 
-  if (event == NULL) {
-    print_error("Event not found\n");
+
+/// Writes every event to the snapshot while the server goes on serving requests.
+/// @note Events are copied in the order of their ids, and the mutex of each one is taken before
+/// the one of the previous event is released, the order RESERVE_MULTI takes them in. A transaction
+/// can then never overtake the copy, so it is in the snapshot whole or not at all, and only the
+/// two events being copied wait for it. Every event is copied before the snapshot is written, so
+/// no mutex is held while seats are packed or written. Events created after the copy started are
+/// not in the snapshot, but their records all come after the LSN, so replaying the log adds them.
+/// @param lsn LSN of the write-ahead log before which every change is durable and in the state.
+/// @return 0 if the snapshot was written successfully, 1 otherwise.
+static int write_snapshot(uint64_t lsn) {
+  // Events are never removed, so the ones that exist now can be copied without the list lock
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
     return 1;
   }
+  size_t num_events = event_list->num_events;
+  struct Event** events = malloc((num_events > 0 ? num_events : 1) * sizeof(struct Event*));
+  if (events != NULL) {
+    memcpy(events, event_list->index, num_events * sizeof(struct Event*));
+  }
+  pthread_rwlock_unlock(&event_list->rwl);
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    print_error("Error locking mutex\n");
+  if (events == NULL) {
     return 1;
   }
 
-  *seats = (unsigned int*)malloc(sizeof(unsigned int) * event->cols * event->rows);
-  if (*seats == NULL){
-    print_error("Error allocating the event seats\n");
+  // The seats of every event are copied to one buffer, which only exists while the snapshot is written
+  size_t total_seats = 0;
+  for (size_t i = 0; i < num_events; i++) {
+    total_seats += events[i]->rows * events[i]->cols;
+  }
+  struct SnapshotEvent* saved = malloc((num_events > 0 ? num_events : 1) * sizeof(struct SnapshotEvent));
+  unsigned int* seats = malloc((total_seats > 0 ? total_seats : 1) * sizeof(unsigned int));
+  if (saved == NULL || seats == NULL) {
+    free(saved);
+    free(seats);
+    free(events);
     return 1;
   }
 
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1; j <= event->cols; j++) {
-      size_t index = (i-1) * event->cols + (j-1);
-      (*seats)[index] = event->data[seat_index(event, i, j)];
+  int result = 0;
+  size_t offset = 0;
+  struct Event* previous = NULL;
+  for (size_t i = 0; i < num_events; i++) {
+    struct Event* event = events[i];
+    if (restore_on_access(event) != 0 || pthread_mutex_lock(&event->mutex) != 0) {
+      result = 1;
+      break;
+    }
+    if (previous != NULL) {
+      pthread_mutex_unlock(&previous->mutex);
     }
+    previous = event;
+    copy_event(event, &saved[i], &seats[offset]);
+    offset += event->rows * event->cols;
   }
-  *num_rows = event->rows;
-  *num_cols = event->cols;
-  if (pthread_mutex_unlock(&event->mutex) != 0) {
-    print_error("Error unlocking mutex\n");
+  if (previous != NULL) {
+    pthread_mutex_unlock(&previous->mutex);
+  }
+  free(events);
+
+  SnapshotWriter* writer = result == 0 ? snapshot_create(snapshot_path, lsn, (uint32_t)num_events) : NULL;
+  offset = 0;
+  for (size_t i = 0; writer != NULL && i < num_events && result == 0; i++) {
+    result = snapshot_add_event(writer, &saved[i], &seats[offset]);
+    offset += (size_t)(saved[i].rows * saved[i].cols);
+  }
+  free(saved);
+  free(seats);
+
+  if (writer == NULL) {
+    return 1;
+  }
+  if (result != 0) {
+    snapshot_abort(writer);
     return 1;
   }
+  return snapshot_commit(writer);
+}
 
-  return 0;
+static void* snapshot_writer(void* arg) {
+  (void)arg;
+
+  // Signals are handled by the other threads
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  // Only records that already reached the file are taken as being in the snapshot
+  if (write_snapshot(wal != NULL ? wal_durable(wal) : 0) != 0) {
+    print_error("Error writing the snapshot\n");
+  } else {
+    atomic_fetch_add(&server_stats.snapshots, 1);
+  }
+
+  pthread_mutex_lock(&snapshot_mutex);
+  snapshot_running = 0;
+  pthread_cond_broadcast(&snapshot_done);
+  pthread_mutex_unlock(&snapshot_mutex);
+  return NULL;
 }
 
-int ems_list_events(unsigned int **event_ids, size_t *num_events) {
+int ems_snapshot() {
   if (event_list == NULL) {
     print_error("EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    print_error("Error locking list rwl\n");
+  if (snapshot_path == NULL) {
+    print_error("The server has no snapshot file\n");
     return 1;
   }
 
-  struct ListNode* to = event_list->tail;
-  struct ListNode* current = event_list->head;
-
-  if (current == NULL) {
-    if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-      print_error("Error unlocking event list rwl\n");
-      return 1;
-    }
-    *num_events = 0;
-    return 0;
+  pthread_mutex_lock(&snapshot_mutex);
+  if (snapshot_running) {
+    pthread_mutex_unlock(&snapshot_mutex);
+    print_error("A snapshot is already being written\n");
+    return 1;
   }
 
-  *event_ids = (unsigned int*) malloc(sizeof(unsigned int) * event_list->num_events);
-  if (*event_ids == NULL){
-    print_error("Error allocating the event ids\n");
+  pthread_t writer;
+  if (pthread_create(&writer, NULL, snapshot_writer, NULL) != 0) {
+    pthread_mutex_unlock(&snapshot_mutex);
+    print_error("Error creating the snapshot thread\n");
     return 1;
   }
+  pthread_detach(writer);
+  snapshot_running = 1;
+  pthread_mutex_unlock(&snapshot_mutex);
+  return 0;
+}
 
-  size_t k = 0;
-
+/// Prints the seats of a SHOW to the stdout a chunk at a time, like the responses to the clients,
+/// followed by the seats that changed while they were printed.
+/// @param cursor The position of the SHOW.
+/// @return 0 if the seats were printed successfully, 1 otherwise.
+static int print_show_stdout(ShowCursor* cursor) {
   while (1) {
-    (*event_ids)[k] = (current->event)->id;
-    if (current == to) {
-      break;
+    while (cursor->next_row < cursor->num_rows) {
+      unsigned int* seats;
+      size_t rows;
+      if (ems_show_next(cursor, &seats, &rows) != 0) {
+        return 1;
+      }
+      if (print_output_show(STDOUT, rows, cursor->num_cols, seats) != 0) {
+        ems_show_end(cursor);
+        return 1;
+      }
     }
-    current = current->next;
-    k++;
-  }
 
-  *num_events = event_list->num_events;
-  if (pthread_rwlock_unlock(&event_list->rwl) != 0) {
-    print_error("Error unlocking event list rwl\n");
-    return 1;
+    struct WatchDelta* changes;
+    size_t num_changes;
+    int restart;
+    if (ems_show_changes(cursor, &changes, &num_changes, &restart) != 0) {
+      ems_show_end(cursor);
+      return 1;
+    }
+    if (restart) {
+      fprintf(stdout, "Changed while printing, printed again:\n");
+      fflush(stdout);
+      continue;
+    }
+
+    for (size_t i = 0; i < num_changes; i++) {
+      fprintf(stdout, "Changed while printing: (%zu,%zu) to (%zu,%zu) is %u\n", changes[i].row,
+              changes[i].first_col, changes[i].row, changes[i].first_col + changes[i].num_seats - 1,
+              changes[i].reservation_id);
+    }
+    fflush(stdout);
+    free(changes);
+    ems_show_end(cursor);
+    return 0;
   }
-  return 0;
 }
 
-
 // Function to print events informations
 int print_info() {
 
@@ -471,20 +2887,15 @@ int print_info() {
     return 0; // There are no events created
   }
 
-  unsigned int *event_seats = NULL;
-
   while (1) {
 
-    size_t rows;
-    size_t cols;
+    ShowCursor cursor;
 
     fprintf(stdout, "Event: %u\n", (current->event)->id);
-    if (ems_show((current->event)->id, &event_seats, &rows, &cols) != 0) {
-      pthread_rwlock_unlock(&event_list->rwl);
-      pthread_mutex_unlock(&mutex_terminal);
-      return 1; 
-    }
-    if (print_output_show(STDOUT, (current->event)->rows, (current->event)->cols, event_seats) != 0) {
+    fflush(stdout);
+    init_show_cursor(current->event, 1, 1, (current->event)->rows, (current->event)->cols, &cursor);
+
+    if (print_show_stdout(&cursor) != 0) {
       pthread_rwlock_unlock(&event_list->rwl);
       pthread_mutex_unlock(&mutex_terminal);
       return 1;
@@ -2,15 +2,53 @@
 #define SERVER_OPERATIONS_H
 
 #include <stddef.h>
+#include <stdatomic.h>
+#include <signal.h>
 
 #include "common/constants.h"
 #include "queue_operations.h"
+#include "timer_wheel.h"
+#include "watch.h"
 
 // Mutex for the server's terminal
 extern pthread_mutex_t mutex_terminal;
 
+// Signal used to interrupt a worker blocked on a session that timed out
+#define SESSION_TIMEOUT_SIGNAL SIGUSR2
+
 typedef struct dynamicBuffer DynamicBuffer;
+struct Event;
+
+
+// Position of a SHOW whose seats are streamed in chunks of rows
+typedef struct {
+  struct Event *event;   /// Event being shown
+  size_t first_row;      /// First row of the region being shown
+  size_t first_col;      /// First column of the region being shown
+  size_t num_rows;       /// Number of rows of the region
+  size_t num_cols;       /// Number of columns of the region
+  size_t next_row;       /// Number of rows already copied
+  size_t chunk_rows;     /// Maximum number of rows streamed at a time
+  unsigned int *seats;   /// Copy of the last chunk, or of the whole region once it restarted SHOW_RESTARTS times
+  size_t num_seats;      /// Number of seats of the copy
+  unsigned int version;  /// Version of the event when the first chunk was copied
+  int restarts;          /// Number of times the chunks were copied again from the first row
+} ShowCursor;
 
+// Seats of one of the events of a RESERVE_MULTI
+typedef struct {
+  unsigned int event_id;              /// Event of the seats
+  size_t num_seats;                   /// Number of seats
+  size_t xs[MAX_RESERVATION_SIZE];    /// Rows of the seats
+  size_t ys[MAX_RESERVATION_SIZE];    /// Columns of the seats
+} ReservationPart;
+
+// Reasons for a session to be closed by the server
+enum SessionTimeout {
+  TIMEOUT_NONE = 0,
+  TIMEOUT_IDLE,     // No request was received for the idle timeout
+  TIMEOUT_TOTAL,    // The session exceeded its maximum lifetime
+};
 
 typedef struct struct_session {
   int session_id;                           /// Session id
@@ -18,6 +56,13 @@ typedef struct struct_session {
   char resp_pipe_path[MAX_FIFO_PATHNAME];   /// Response server -> client
   int req_pipe;                             /// File descriptor request pipe
   int resp_pipe;                            /// File descriptor response pipe
+  pthread_t worker;                         /// Thread serving the session
+  unsigned long started_ms;                 /// Time in which the session was set up
+  TimerNode timer;                          /// Timer for the session timeouts
+  enum SessionTimeout timer_kind;           /// Timeout the timer is armed for
+  atomic_int timed_out;                     /// Timeout that expired, TIMEOUT_NONE if none
+  enum SHOW_ENCODING show_encoding;         /// Encoding negotiated for the SHOW responses
+  WatchQueue *watch;                        /// Changes to be pushed, NULL if not watching events
 } Session;
 
 
@@ -29,6 +74,64 @@ int ems_init(unsigned int delay_us);
 /// Destroys the EMS state.
 int ems_terminate();
 
+/// Sets the timeouts after which the server closes a client session.
+/// @param idle_timeout_s Seconds without requests before a session is closed, 0 to disable.
+/// @param total_timeout_s Maximum lifetime of a session in seconds, 0 to disable.
+void ems_set_session_timeouts(unsigned int idle_timeout_s, unsigned int total_timeout_s);
+
+/// Restores the events of a persistent store, in which the new events are kept too.
+/// @param path Pathname of the file of the store, created if it does not exist.
+/// @param sync_interval_ms Milliseconds between the syncs of the store to its file.
+/// @return 0 if the store was opened successfully, 1 otherwise.
+int ems_open_store(const char* path, unsigned int sync_interval_ms);
+
+/// Replays a write-ahead log, to which the changes to the state are appended from then on.
+/// Changes already in the state, from a loaded snapshot, are not applied again.
+/// @note A persistent store cannot be used along with the log, as the pages of the store reach its
+/// file in no particular order, so the reservations in the store tell nothing of what is durable.
+/// @note With a checkpoint, its events are loaded first and only the log after it is replayed,
+/// and a new checkpoint is written periodically, after which the log drops the records it has.
+/// @param path Pathname of the log, created if it does not exist.
+/// @param checkpoint Pathname of the checkpoint, NULL to replay the whole log.
+/// @param checkpoint_interval Seconds between the checkpoints.
+/// @return 0 if the log was replayed and opened successfully, 1 otherwise.
+int ems_open_wal(const char* path, const char* checkpoint, unsigned int checkpoint_interval);
+
+/// Sets how RESERVE claims the seats of an event.
+/// @param enabled 1 to claim them with compare-and-swap before taking the mutex of the event,
+/// 0 to claim them with the mutex held.
+void ems_set_lock_free_reserve(int enabled);
+
+/// Sets when the reservations of an event start being combined under a single lock acquisition.
+/// @param threshold Contended reservations of an event after which it uses combining, 0 to use
+/// it for every event all the time.
+void ems_set_combine_threshold(unsigned int threshold);
+
+/// Starts feeding every committed change to a file, a named pipe or a Unix socket, in the record
+/// format of the write-ahead log, for downstream systems and standby servers. The output first
+/// gets the whole state each time it is opened, and then the numbered changes. With a log, which
+/// must be opened first, changes are fed once they are durable. Changes the output does not keep
+/// up with are dropped, leaving a gap in the numbers.
+/// @param path Pathname of a named pipe, of the socket of a standby, or of a file to append to.
+/// @return 0 if the feed was opened successfully, 1 otherwise.
+int ems_open_cdc(const char* path);
+
+/// Adds the events of a snapshot to the state, other than the ones it already has.
+/// @param path Pathname of the snapshot.
+/// @return 0 if the snapshot was loaded successfully, 1 otherwise.
+int ems_load_snapshot(const char* path);
+
+/// Makes the server a standby of a primary server, which applies the change feed of the primary
+/// in order and refuses the requests that change the state. Requests that read the events are
+/// refused too, except while the standby has every change of a primary that is connected.
+/// @param path Pathname of a named pipe, or of a Unix socket to create, the primary feeds its changes to.
+/// @return 0 if the feed is being received, 1 otherwise.
+int ems_open_standby(const char* path);
+
+/// Sets the file that SNAPSHOT writes the events to.
+/// @param path Pathname of the snapshot, NULL to refuse snapshots.
+void ems_set_snapshot_path(const char* path);
+
 /// Adds a session request to the buffer.
 /// @param req_pipe_path The filepath to the client's request pipe.
 /// @param resp_pipe_path The filepath to the client's response pipe.
@@ -46,6 +149,11 @@ void print_error(const char * error);
 /// @return 0 if it was successfully made, 1 otherwise.
 int ems_setup(Session *session);
 
+/// Restarts the idle timeout of the session after receiving a request.
+/// @param session The session that received the request.
+/// @return 0 if it was successfully made, 1 otherwise.
+int ems_touch_session(Session *session);
+
 /// Closes the active session.
 /// @param session The session to be closed.
 /// @return 0 if it was successfully made, 1 otherwise.
@@ -66,19 +174,170 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
 
-/// Prints the given event.
+/// Starts showing the given event, whose seats are then copied in chunks with ems_show_next.
 /// @param event_id Id of the event to print.
-/// @param seats Variable to store the seats matrix.
-/// @param num_rows Variable to store the number of rows of the event.
-/// @param num_cols Variable to store the number of rows of the event.
-/// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show(unsigned int event_id, unsigned int **seats, size_t *num_rows, size_t *num_cols);
-
-/// Prints all the events.
-/// @param event_ids Pointer to register the IDs of the existing events.
-/// @param num_events Number of existing events.
-/// @return 0 if the events were printed successfully, 1 otherwise.
-int ems_list_events(unsigned int **event_ids, size_t *num_events);
+/// @param cursor Variable to store the position of the SHOW.
+/// @return 0 if the event was found, 1 otherwise.
+int ems_show(unsigned int event_id, ShowCursor *cursor);
+
+/// Starts showing several events, which are all looked up with a single access to the state.
+/// @param num_events Number of events to show.
+/// @param event_ids Ids of the events to show.
+/// @param results Array to store, for each event, 0 if it was found or 1 otherwise.
+/// @param cursors Array to store the positions of the SHOWs of the events that were found.
+/// @return 0 if the events were looked up, 1 otherwise.
+int ems_multi_show(size_t num_events, unsigned int *event_ids, int *results, ShowCursor *cursors);
+
+/// Starts showing a rectangular region of the given event, whose seats are then
+/// copied in chunks with ems_show_next.
+/// @param event_id Id of the event to print.
+/// @param first_row First row of the region.
+/// @param first_col First column of the region.
+/// @param last_row Last row of the region.
+/// @param last_col Last column of the region.
+/// @param cursor Variable to store the position of the SHOW.
+/// @return 0 if the event was found and the region is valid, 1 otherwise.
+int ems_show_region(unsigned int event_id, size_t first_row, size_t first_col, size_t last_row,
+                    size_t last_col, ShowCursor *cursor);
+
+/// Gets the number of seats of an event without a reservation.
+/// @param event_id Id of the event.
+/// @param free_seats Variable to store the number of free seats.
+/// @return 0 if the event was found, 1 otherwise.
+int ems_free_count(unsigned int event_id, size_t *free_seats);
+
+/// Gets the number of seats without a reservation in each row of an event.
+/// @param event_id Id of the event.
+/// @param row_free Variable to store the free seats of each row, to be released with free.
+/// @param num_rows Variable to store the number of rows.
+/// @return 0 if the event was found, 1 otherwise.
+int ems_row_availability(unsigned int event_id, size_t **row_free, size_t *num_rows);
+
+/// Creates a reservation in each of several events, either all of them or none.
+/// @param num_parts Number of events.
+/// @param parts The seats to reserve in each event, with no event repeated.
+/// @param reservation_ids Array to store the id of the reservation of each event in.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_parts, ReservationPart *parts, unsigned int *reservation_ids);
+
+/// Reserves seats for a limited time, after which they are released unless the hold is confirmed.
+/// @param event_id Id of the event.
+/// @param hold_s Number of seconds the seats are held for.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param reservation_id Variable to store the id of the reservation of the hold.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int hold_s, size_t num_seats, size_t *xs, size_t *ys,
+             unsigned int *reservation_id);
+
+/// Confirms a hold that has not expired, keeping its seats as a regular reservation.
+/// @param event_id Id of the event.
+/// @param reservation_id Id of the reservation of the hold.
+/// @return 0 if the hold was confirmed successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int reservation_id);
+
+/// Releases a hold that has not expired, freeing its seats.
+/// @param event_id Id of the event.
+/// @param reservation_id Id of the reservation of the hold.
+/// @return 0 if the hold was released successfully, 1 otherwise.
+int ems_release(unsigned int event_id, unsigned int reservation_id);
+
+/// Cancels a reservation, freeing its seats.
+/// @param event_id Id of the event.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Reserves consecutive free seats of a row, choosing the first row with enough of them.
+/// @param event_id Id of the event.
+/// @param num_seats Number of seats to reserve.
+/// @param priority Order in which the rows are searched, a value of enum ROW_PRIORITY.
+/// @param first_row First row that may be chosen, 0 for the first row of the event.
+/// @param last_row Last row that may be chosen, 0 for the last row of the event.
+/// @param reservation_id Variable to store the id of the reservation.
+/// @param row Variable to store the row of the seats.
+/// @param first_col Variable to store the column of the first seat.
+/// @return 0 if the seats were reserved successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, int priority, size_t first_row, size_t last_row,
+                     unsigned int *reservation_id, size_t *row, size_t *first_col);
+
+/// Gets the changes made to the seats of an event after the version known by the client,
+/// or starts showing the whole event when they are no longer in its change log.
+/// @param event_id Id of the event to print.
+/// @param since_version Version of the event known by the client.
+/// @param version Variable to store the current version of the event.
+/// @param changes Variable to store the changes, to be released with free. NULL if there are none.
+/// @param num_changes Variable to store the number of changes.
+/// @param cursor Variable to store the position of the SHOW. Its event is NULL when the
+/// changes were returned instead.
+/// @return 0 if the event was found, 1 otherwise.
+int ems_show_since(unsigned int event_id, unsigned int since_version, unsigned int *version,
+                   struct WatchDelta **changes, size_t *num_changes, ShowCursor *cursor);
+
+/// Gets the next chunk of rows of a SHOW.
+/// @note Each chunk is copied when it is taken, between two reservations, so only one chunk is in
+/// memory however large the region is. The chunks are made consistent with the changes returned
+/// by ems_show_changes once the last one was taken.
+/// @param cursor The position of the SHOW.
+/// @param seats Variable to store the seats of the chunk, which belong to the cursor until the next chunk.
+/// @param num_rows Variable to store the number of rows of the chunk, 0 once all were returned.
+/// @return 0 if the chunk was copied successfully, 1 otherwise.
+int ems_show_next(ShowCursor *cursor, unsigned int **seats, size_t *num_rows);
+
+/// Gets the changes made to the region of a SHOW since its first chunk was copied. Applied in order
+/// to the chunks, they show the whole region between the same two reservations. When the change
+/// log of the event no longer has them, the SHOW starts over from its first row instead.
+/// @param cursor The position of the SHOW, whose chunks were all returned.
+/// @param changes Variable to store the changes, with rows and columns counted from the region,
+/// to be released with free. NULL if there are none.
+/// @param num_changes Variable to store the number of changes.
+/// @param restart Variable to store whether the SHOW started over instead.
+/// @return 0 if the changes were copied or the SHOW started over, 1 otherwise.
+int ems_show_changes(ShowCursor *cursor, struct WatchDelta **changes, size_t *num_changes, int *restart);
+
+/// Releases the copy of the seats of a SHOW, whether or not all of its chunks were returned.
+/// @param cursor The position of the SHOW.
+void ems_show_end(ShowCursor *cursor);
+
+/// Subscribes the session to the changes of the given events. A snapshot of each
+/// event is queued first, followed by the deltas of every reservation made afterwards.
+/// @note The idle timeout does not apply to a session while it is watching events.
+/// @param session The session that watches the events.
+/// @param num_events Number of events to watch.
+/// @param event_ids Ids of the events to watch.
+/// @return 0 if the session is now watching the events, 1 otherwise.
+int ems_watch(Session *session, size_t num_events, unsigned int *event_ids);
+
+/// Cancels all the subscriptions of the session, discarding the changes not yet pushed.
+/// @param session The session that stops watching events.
+/// @return 0 if it was successfully made, 1 otherwise.
+int ems_unwatch(Session *session);
+
+/// Takes a snapshot of a watched event if the subscriber fell behind its deltas.
+/// @param subscription The subscription to the event.
+/// @param resync Variable to store the description of the snapshot.
+/// @param seats Variable to store the seats of the snapshot, to be released with free_pipe_buffer.
+/// Set to NULL if the subscription did not need a snapshot.
+/// @return 0 if it was successfully made, 1 otherwise.
+int ems_watch_resync(WatchSubscription *subscription, struct WatchResync *resync, unsigned int **seats);
+
+/// Gets a page of the ids of the existing events, in increasing order.
+/// @param cursor Lowest id to be listed.
+/// @param page_size Maximum number of ids to be listed.
+/// @param event_ids Array to store the ids in, with room for page_size ids.
+/// @param num_events Variable to store the number of ids listed.
+/// @param more Variable to store whether there are events after the page.
+/// @return 0 if the events were listed successfully, 1 otherwise.
+int ems_list_events(unsigned int cursor, size_t page_size, unsigned int *event_ids,
+                    size_t *num_events, int *more);
+
+/// Starts writing every event to the snapshot file in a thread, while the server goes on
+/// serving requests.
+/// @note Each event is only locked while it is copied, and transactions are in the snapshot
+/// whole or not at all. Creating events waits for the snapshot.
+/// @return 0 if the snapshot was started successfully, 1 otherwise.
+int ems_snapshot();
 
 /// Prints all the information about all the existing events. 
 /// @return 0 if the events were printed successfully, 1 otherwise.
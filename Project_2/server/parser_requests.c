@@ -1,6 +1,7 @@
 
 #include "common/io.h"
 #include "common/constants.h"
+#include "parser_requests.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -55,6 +56,8 @@ int parse_reserve(int req_pipe, unsigned int *event_id,
   if (parse_value == 1) {return 1;}
   if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
 
+  if (*num_seats > MAX_RESERVATION_SIZE) {return 1;}
+
   parse_value = parse_size_t_array_pipe(req_pipe, xs, *num_seats);
   if (parse_value == 1) {return 1;}
   if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
@@ -66,6 +69,72 @@ int parse_reserve(int req_pipe, unsigned int *event_id,
   return 0;
 }
 
+int parse_reserve_multi(int req_pipe, size_t *num_parts, ReservationPart *parts, size_t max_parts) {
+
+  int parse_value = parse_size_t_pipe(req_pipe, num_parts);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  if (*num_parts > max_parts) {return 1;}
+
+  for (size_t i = 0; i < *num_parts; i++) {
+    parse_value = parse_reserve(req_pipe, &parts[i].event_id, &parts[i].num_seats, parts[i].xs, parts[i].ys);
+    if (parse_value == 1) {return 1;}
+    if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+  }
+
+  return 0;
+}
+
+int parse_hold(int req_pipe, unsigned int *hold_s, unsigned int *event_id,
+               size_t *num_seats, size_t *xs, size_t *ys) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, hold_s);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  return parse_reserve(req_pipe, event_id, num_seats, xs, ys);
+}
+
+int parse_cancel(int req_pipe, unsigned int *event_id, unsigned int *reservation_id) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, event_id);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  parse_value = parse_uns_int_pipe(req_pipe, reservation_id);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  return 0;
+}
+
+int parse_reserve_best(int req_pipe, unsigned int *event_id, size_t *num_seats, int *priority,
+                       size_t *first_row, size_t *last_row) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, event_id);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  parse_value = parse_size_t_pipe(req_pipe, num_seats);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  parse_value = parse_int_pipe(req_pipe, priority);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  size_t rows[2];
+  parse_value = parse_size_t_array_pipe(req_pipe, rows, 2);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  *first_row = rows[0];
+  *last_row = rows[1];
+
+  return 0;
+}
+
 int parse_show(int req_pipe, unsigned int *event_id) {
 
   int parse_value = parse_uns_int_pipe(req_pipe, event_id);
@@ -74,3 +143,79 @@ int parse_show(int req_pipe, unsigned int *event_id) {
 
   return 0;
 }
+
+int parse_show_since(int req_pipe, unsigned int *event_id, unsigned int *version) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, event_id);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  parse_value = parse_uns_int_pipe(req_pipe, version);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  return 0;
+}
+
+int parse_show_region(int req_pipe, unsigned int *event_id, size_t *first_row, size_t *first_col,
+                      size_t *last_row, size_t *last_col) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, event_id);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  size_t corners[4];
+  parse_value = parse_size_t_array_pipe(req_pipe, corners, 4);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  *first_row = corners[0];
+  *first_col = corners[1];
+  *last_row = corners[2];
+  *last_col = corners[3];
+
+  return 0;
+}
+
+int parse_list_events(int req_pipe, unsigned int *cursor, size_t *page_size) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, cursor);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  parse_value = parse_size_t_pipe(req_pipe, page_size);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  return 0;
+}
+
+int parse_encoding(int req_pipe, unsigned int *encodings) {
+
+  int parse_value = parse_uns_int_pipe(req_pipe, encodings);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  return 0;
+}
+
+int parse_event_ids(int req_pipe, size_t *num_events, unsigned int *event_ids, size_t max_events) {
+
+  int parse_value = parse_size_t_pipe(req_pipe, num_events);
+  if (parse_value == 1) {return 1;}
+  if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+  // Ids beyond the maximum are still read, so that the request is consumed entirely
+  for (size_t i = 0; i < *num_events; i++) {
+    unsigned int event_id;
+    parse_value = parse_uns_int_pipe(req_pipe, &event_id);
+    if (parse_value == 1) {return 1;}
+    if (parse_value == PIPE_CLOSED) {return PIPE_CLOSED;}
+
+    if (i < max_events) {
+      event_ids[i] = event_id;
+    }
+  }
+
+  return 0;
+}
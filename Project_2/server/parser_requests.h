@@ -1,6 +1,10 @@
 #ifndef PARSER_REQUESTS_H
 #define PARSER_REQUESTS_H
 
+#include <stddef.h>
+
+#include "operations.h"
+
 /// Parses the request setup from the client.
 /// @param rx The server's pipe filedescriptor to read the request from.
 /// @param req_pipe_path The pointer to store the client's request pipe path.
@@ -26,10 +30,87 @@ int parse_create(int req_pipe, unsigned int *event_id, size_t *num_rows, size_t
 int parse_reserve(int req_pipe, unsigned int *event_id, 
                   size_t *num_seats, size_t *xs, size_t *ys);
 
+/// Parses a request for the command reserve of seats of several events, which is a number of
+/// events followed by a reserve request for each of them.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param num_parts The variable to store the number of events.
+/// @param parts The array to store the seats to reserve in each event.
+/// @param max_parts The maximum number of events stored in parts.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_reserve_multi(int req_pipe, size_t *num_parts, ReservationPart *parts, size_t max_parts);
+
+/// Parses a request for the command hold, which is a reserve request preceded by the duration of the hold.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param hold_s The variable to store the number of seconds the seats are held for.
+/// @param event_id The variable to store the event ID to hold the seats.
+/// @param num_seats The variable to store the number of seats to hold.
+/// @param xs The pointer to store the coordinate X of the seats to hold.
+/// @param ys The pointer to store the coordinate Y of the seats to hold.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_hold(int req_pipe, unsigned int *hold_s, unsigned int *event_id,
+               size_t *num_seats, size_t *xs, size_t *ys);
+
+/// Parses a request for the command cancel, also used by confirm and release.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param event_id The variable to store the event ID of the reservation.
+/// @param reservation_id The variable to store the ID of the reservation to cancel.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_cancel(int req_pipe, unsigned int *event_id, unsigned int *reservation_id);
+
+/// Parses a request for the command reserve of the best available seats.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param event_id The variable to store the event ID to reserve the seats.
+/// @param num_seats The variable to store the number of seats to reserve.
+/// @param priority The variable to store the order in which the rows are searched.
+/// @param first_row The variable to store the first row that may be chosen.
+/// @param last_row The variable to store the last row that may be chosen.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_reserve_best(int req_pipe, unsigned int *event_id, size_t *num_seats, int *priority,
+                       size_t *first_row, size_t *last_row);
+
 /// Parses a request for the command show. 
 /// @param req_pipe The client's request pipe filedescriptor to read from.
 /// @param event_id The variable to store the event ID to show
 /// @return 0 if the parsing was successfully made, 1 otherwise.
 int parse_show(int req_pipe, unsigned int *event_id);
 
+/// Parses a request for the command show of the changes since a version.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param event_id The variable to store the event ID to show.
+/// @param version The variable to store the version of the event known by the client.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_show_since(int req_pipe, unsigned int *event_id, unsigned int *version);
+
+/// Parses a request for the command show of a region.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param event_id The variable to store the event ID to show.
+/// @param first_row The variable to store the first row of the region.
+/// @param first_col The variable to store the first column of the region.
+/// @param last_row The variable to store the last row of the region.
+/// @param last_col The variable to store the last column of the region.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_show_region(int req_pipe, unsigned int *event_id, size_t *first_row, size_t *first_col,
+                      size_t *last_row, size_t *last_col);
+
+/// Parses a request for a page of the list of events.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param cursor The variable to store the lowest event ID to list.
+/// @param page_size The variable to store the maximum number of events to list.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_list_events(int req_pipe, unsigned int *cursor, size_t *page_size);
+
+/// Parses a request for the negotiation of the SHOW encoding.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param encodings The variable to store the bitmask of the encodings supported by the client.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_encoding(int req_pipe, unsigned int *encodings);
+
+/// Parses a request that refers to a list of events, such as WATCH or MULTI_SHOW.
+/// @param req_pipe The client's request pipe filedescriptor to read from.
+/// @param num_events The variable to store the number of events.
+/// @param event_ids The array to store the IDs of the events.
+/// @param max_events The maximum number of IDs stored in event_ids.
+/// @return 0 if the parsing was successfully made, 1 otherwise.
+int parse_event_ids(int req_pipe, size_t *num_events, unsigned int *event_ids, size_t max_events);
+
 #endif
\ No newline at end of file
@@ -139,6 +139,12 @@ Session *createSession(char req_pipe_path[], char resp_pipe_path[]) {
 
     strcpy(session->req_pipe_path, req_pipe_path);
     strcpy(session->resp_pipe_path, resp_pipe_path);
+    session->req_pipe = -1;
+    session->resp_pipe = -1;
+    session->timer_kind = TIMEOUT_NONE;
+    atomic_init(&session->timed_out, TIMEOUT_NONE);
+    session->show_encoding = ENCODING_RAW;
+    session->watch = NULL;
 
     return session;
 }
@@ -0,0 +1,228 @@
+#include "replica.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cdc.h"
+#include "stats.h"
+
+
+/// Opens the input of the feed if it is not open, waiting a while for a primary to connect.
+/// @param replica The receiver.
+/// @return 0 if the input is open, 1 otherwise.
+static int open_input(Replica *replica) {
+  if (replica->fd != -1) {
+    return 0;
+  }
+
+  // Reading does not wait for a writer, and a primary that leaves is seen as the end of the pipe
+  if (replica->listen_fd == -1) {
+    replica->fd = open(replica->path, O_RDONLY | O_NONBLOCK);
+    if (replica->fd == -1) {
+      poll(NULL, 0, REPLICA_POLL_INTERVAL_MS);
+      return 1;
+    }
+    return 0;
+  }
+
+  struct pollfd listener = {.fd = replica->listen_fd, .events = POLLIN};
+  if (poll(&listener, 1, REPLICA_POLL_INTERVAL_MS) <= 0) {
+    return 1;
+  }
+  replica->fd = accept(replica->listen_fd, NULL, NULL);
+  return replica->fd == -1;
+}
+
+/// Closes the input of the feed, discarding the part of a record that was read. The state is not
+/// current until the next primary sends its own.
+/// @param replica The receiver.
+static void close_input(Replica *replica) {
+  close(replica->fd);
+  replica->fd = -1;
+  replica->length = 0;
+  replica->sequence = 0;
+  atomic_store(&replica->current, 0);
+}
+
+/// Applies every complete record that was read, and keeps the rest for the next read.
+/// @param replica The receiver.
+/// @return 0 if the records were applied, 1 if the feed is corrupted or misses a record.
+static int apply_records(Replica *replica) {
+  const struct WalRecord *last = NULL;
+  size_t offset = 0;
+  int result = 0;
+
+  while (replica->length - offset >= sizeof(struct WalRecord)) {
+    const struct WalRecord *record = (const struct WalRecord *)&replica->buffer[offset];
+    if (record->size != sizeof(struct WalRecord) + record->num_runs * sizeof(struct WalRun)) {
+      result = 1;
+      break;
+    }
+    if (record->size > replica->length - offset) {
+      break;  // The rest of the record is still to be read
+    }
+    if (wal_checksum(record) != record->checksum) {
+      result = 1;
+      break;
+    }
+
+    // The state of the primary starts the feed over, and nothing after a missing record is applied
+    if (record->sequence != 1 && record->sequence != replica->sequence + 1) {
+      result = 1;
+      break;
+    }
+    if (record->sequence == 1) {
+      atomic_store(&replica->current, 0);
+    }
+
+    if (replica->apply(record, replica->arg) != 0) {
+      atomic_fetch_add(&server_stats.replica_errors, 1);
+    }
+    atomic_fetch_add(&server_stats.replica_records, 1);
+    replica->sequence = record->sequence;
+    if (record->type == WAL_SYNC) {
+      atomic_store(&replica->current, 1);
+    }
+    last = record;
+    offset += record->size;
+  }
+
+  // The primary stamped the last record with the same clock when it made the change
+  if (last != NULL) {
+    atomic_store(&server_stats.replica_lag_ms, (unsigned long)(uint32_t)(cdc_time_ms() - last->time_ms));
+  }
+
+  memmove(replica->buffer, &replica->buffer[offset], replica->length - offset);
+  replica->length -= offset;
+  return result;
+}
+
+static void *replica_receiver(void *arg) {
+  Replica *replica = (Replica *)arg;
+
+  // Signals are handled by the other threads
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  while (!atomic_load(&replica->stop)) {
+    if (open_input(replica) != 0) {
+      continue;
+    }
+
+    struct pollfd input = {.fd = replica->fd, .events = POLLIN};
+    if (poll(&input, 1, REPLICA_POLL_INTERVAL_MS) <= 0) {
+      continue;
+    }
+
+    // Whatever the primary wrote meanwhile is read at once, and applied while it writes more
+    ssize_t size = read(replica->fd, &replica->buffer[replica->length], REPLICA_BUFFER_SIZE - replica->length);
+    if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+      continue;
+    }
+    if (size <= 0) {
+      close_input(replica);
+      continue;
+    }
+
+    // A feed that is corrupted or misses a record is closed, and kept so for long enough that the
+    // primary sees it and sends its state again to the next one
+    replica->length += (size_t)size;
+    if (apply_records(replica) != 0) {
+      atomic_fetch_add(&server_stats.replica_errors, 1);
+      close_input(replica);
+      poll(NULL, 0, REPLICA_POLL_INTERVAL_MS);
+    }
+  }
+
+  return NULL;
+}
+
+/// Frees a receiver whose thread is not running.
+/// @param replica The receiver.
+static void free_replica(Replica *replica) {
+  if (replica->fd != -1) close(replica->fd);
+  if (replica->listen_fd != -1) {
+    close(replica->listen_fd);
+    unlink(replica->path);
+  }
+  free(replica->buffer);
+  free(replica);
+}
+
+Replica *replica_open(const char *path, wal_apply apply, void *arg) {
+  Replica *replica = (Replica *)malloc(sizeof(Replica));
+  if (replica == NULL) {
+    return NULL;
+  }
+
+  replica->buffer = (unsigned char *)malloc(REPLICA_BUFFER_SIZE);
+  if (replica->buffer == NULL) {
+    free(replica);
+    return NULL;
+  }
+
+  replica->listen_fd = -1;
+  replica->fd = -1;
+  replica->path = path;
+  replica->length = 0;
+  replica->sequence = 0;
+  replica->apply = apply;
+  replica->arg = arg;
+  atomic_init(&replica->stop, 0);
+  atomic_init(&replica->current, 0);
+
+  // Unless the path is a named pipe, the primary connects to a socket there
+  struct stat file_stat;
+  int exists = stat(path, &file_stat) == 0;
+  if (!exists || !S_ISFIFO(file_stat.st_mode)) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if ((exists && !S_ISSOCK(file_stat.st_mode)) || strlen(path) >= sizeof(address.sun_path) ||
+        (exists && unlink(path) != 0)) {
+      free_replica(replica);
+      return NULL;
+    }
+    strcpy(address.sun_path, path);
+
+    replica->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (replica->listen_fd == -1) {
+      free_replica(replica);
+      return NULL;
+    }
+    if (bind(replica->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+      close(replica->listen_fd);
+      replica->listen_fd = -1;
+      free_replica(replica);
+      return NULL;
+    }
+    if (listen(replica->listen_fd, 1) != 0) {
+      free_replica(replica);
+      return NULL;
+    }
+  }
+
+  if (pthread_create(&replica->thread, NULL, replica_receiver, replica) != 0) {
+    free_replica(replica);
+    return NULL;
+  }
+
+  return replica;
+}
+
+int replica_current(Replica *replica) { return atomic_load(&replica->current); }
+
+void replica_close(Replica *replica) {
+  if (replica == NULL) return;
+
+  atomic_store(&replica->stop, 1);
+  pthread_join(replica->thread, NULL);
+  free_replica(replica);
+}
@@ -0,0 +1,52 @@
+#ifndef SERVER_REPLICA_H
+#define SERVER_REPLICA_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wal.h"
+
+#define REPLICA_BUFFER_SIZE ((size_t)1 << 21)  // Bytes read from the primary at a time, more than any record
+#define REPLICA_POLL_INTERVAL_MS 100           // Time the receiver waits for the primary before checking if it should stop
+
+// Receiver of the change feed of a primary server, which a standby applies to its state in the
+// order of the feed. The feed comes through a named pipe, or through a Unix socket the receiver
+// listens on. The records of a primary that leaves midway through one are discarded, and the
+// receiver waits for the next primary.
+//
+// A primary starts with its whole state, and the standby is current from the WAL_SYNC record
+// that ends it until the feed stops or misses a record. A feed that misses a record, or that is
+// corrupted, is closed so that the primary sends its state again.
+typedef struct {
+  int listen_fd;           /// Listening socket, -1 if the feed comes through a named pipe
+  int fd;                  /// File descriptor the feed is read from, -1 while there is no primary
+  const char *path;        /// Pathname of the pipe or socket
+  unsigned char *buffer;   /// Bytes read and not yet applied, starting at a record
+  size_t length;           /// Number of bytes in the buffer
+  uint64_t sequence;       /// Number of the last record applied from the input, 0 if none
+  atomic_int current;      /// Whether the state has every change of a primary that is connected
+  wal_apply apply;         /// Function called with each record
+  void *arg;               /// Argument given to the function
+  atomic_int stop;         /// Whether the receiver should terminate
+  pthread_t thread;        /// The receiver thread
+} Replica;
+
+/// Starts receiving the change feed of a primary server.
+/// @param path Pathname of a named pipe, or of a Unix socket to create, replacing any socket there.
+/// @param apply Function called with each record, in the order of the feed.
+/// @param arg Argument given to the function.
+/// @return The receiver, NULL on failure.
+Replica *replica_open(const char *path, wal_apply apply, void *arg);
+
+/// Tells whether the state has every change of the primary, which is connected and sent its state.
+/// @param replica The receiver.
+/// @return 1 if the state is current, 0 otherwise.
+int replica_current(Replica *replica);
+
+/// Stops receiving the change feed and closes the receiver.
+/// @param replica The receiver.
+void replica_close(Replica *replica);
+
+#endif  // SERVER_REPLICA_H
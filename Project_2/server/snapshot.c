@@ -0,0 +1,317 @@
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/io.h"
+
+
+/// Gets the bytes taken by the packed seats of an event.
+/// @param event The entry of the event.
+/// @return The size of the seats, a multiple of 8 bytes.
+static size_t packed_size(const struct SnapshotEvent *event) {
+  return (event->rows * event->cols * event->seat_bits + 63) / 64 * 8;
+}
+
+/// Hashes whole words, a word at a time, so that checking a file is not slower than reading it.
+/// @param data The words.
+/// @param size Number of bytes, a multiple of 8.
+/// @param hash Hash of the bytes before them.
+/// @return The hash of the bytes so far.
+static uint64_t hash_words(const void *data, size_t size, uint64_t hash) {
+  // The words are copied out, since they may belong to structures of other types
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i += 8) {
+    uint64_t word;
+    memcpy(&word, &bytes[i], sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/// Folds a hash into a checksum.
+/// @param hash The hash.
+/// @return The checksum.
+static uint32_t fold(uint64_t hash) {
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/// Computes the checksum of the header and the directory of a snapshot.
+/// @param header The header.
+/// @param directory The entries of the events.
+/// @return The checksum.
+static uint32_t directory_checksum(const struct SnapshotHeader *header, const struct SnapshotEvent *directory) {
+  struct SnapshotHeader copy = *header;
+  copy.checksum = 0;
+  uint64_t hash = hash_words(&copy, sizeof(copy), 0xcbf29ce484222325ull);
+  return fold(hash_words(directory, header->num_events * sizeof(struct SnapshotEvent), hash));
+}
+
+/// Writes a buffer to a snapshot, remembering if it failed.
+/// @param writer The writer.
+/// @param buffer The bytes to write.
+/// @param size Number of bytes.
+static void write_all(SnapshotWriter *writer, const void *buffer, size_t size) {
+  const char *bytes = (const char *)buffer;
+  for (size_t done = 0; done < size && !writer->failed;) {
+    ssize_t written = write(writer->fd, bytes + done, size - done);
+    if (written < 0) {
+      writer->failed = 1;
+    } else {
+      done += (size_t)written;
+    }
+  }
+}
+
+/// Frees a writer.
+/// @param writer The writer.
+static void free_writer(SnapshotWriter *writer) {
+  free(writer->path);
+  free(writer->temporary_path);
+  free(writer->directory);
+  free(writer->packed);
+  free(writer);
+}
+
+SnapshotWriter *snapshot_create(const char *path, uint64_t lsn, uint32_t max_events) {
+  SnapshotWriter *writer = (SnapshotWriter *)calloc(1, sizeof(SnapshotWriter));
+  if (writer == NULL) {
+    return NULL;
+  }
+
+  size_t length = strlen(path);
+  writer->path = (char *)malloc(length + 1);
+  writer->temporary_path = (char *)malloc(length + 5);
+  writer->directory = (struct SnapshotEvent *)calloc(max_events > 0 ? max_events : 1, sizeof(struct SnapshotEvent));
+  if (writer->path == NULL || writer->temporary_path == NULL || writer->directory == NULL) {
+    free_writer(writer);
+    return NULL;
+  }
+  strcpy(writer->path, path);
+  snprintf(writer->temporary_path, length + 5, "%s.tmp", path);
+
+  writer->fd = open(writer->temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+  if (writer->fd == -1) {
+    free_writer(writer);
+    return NULL;
+  }
+
+  // The seats are written first, after the room left for the header and the directory
+  writer->header.magic = SNAPSHOT_MAGIC;
+  writer->header.version = SNAPSHOT_VERSION;
+  writer->header.lsn = lsn;
+  writer->max_events = max_events;
+  writer->end = sizeof(struct SnapshotHeader) + (uint64_t)max_events * sizeof(struct SnapshotEvent);
+  if (lseek(writer->fd, (off_t)writer->end, SEEK_SET) == -1) {
+    writer->failed = 1;
+  }
+  return writer;
+}
+
+int snapshot_add_event(SnapshotWriter *writer, const struct SnapshotEvent *event, const unsigned int *seats) {
+  uint32_t num_events = writer->header.num_events;
+  if (num_events == writer->max_events ||
+      (num_events > 0 && writer->directory[num_events - 1].event_id >= event->event_id)) {
+    writer->failed = 1;
+    return 1;
+  }
+
+  // The largest reservation id sets the width the seats are packed with
+  size_t num_seats = event->rows * event->cols;
+  unsigned int max_seat = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    max_seat = seats[i] > max_seat ? seats[i] : max_seat;
+  }
+
+  struct SnapshotEvent *entry = &writer->directory[num_events];
+  *entry = *event;
+  entry->seat_bits = 0;
+  while (entry->seat_bits < 32 && (1u << entry->seat_bits) <= max_seat) {
+    entry->seat_bits = entry->seat_bits == 0 ? 1 : entry->seat_bits * 2;
+  }
+  entry->data_offset = writer->end;
+
+  size_t size = packed_size(entry);
+  size_t num_words = size / 8;
+  if (num_words > writer->packed_capacity) {
+    uint64_t *packed = realloc(writer->packed, num_words * sizeof(uint64_t));
+    if (packed == NULL) {
+      writer->failed = 1;
+      return 1;
+    }
+    writer->packed = packed;
+    writer->packed_capacity = num_words;
+  }
+
+  // Seats are packed from the low bits of each word, and never cross into the next word
+  if (entry->seat_bits > 0) {
+    memset(writer->packed, 0, size);
+    size_t per_word = 64 / entry->seat_bits;
+    for (size_t i = 0; i < num_seats; i++) {
+      writer->packed[i / per_word] |= (uint64_t)seats[i] << (i % per_word * entry->seat_bits);
+    }
+  }
+
+  entry->checksum = fold(hash_words(writer->packed, size, 0xcbf29ce484222325ull));
+  write_all(writer, writer->packed, size);
+  writer->end += size;
+  writer->header.num_events++;
+  return writer->failed;
+}
+
+int snapshot_commit(SnapshotWriter *writer) {
+  writer->header.checksum = directory_checksum(&writer->header, writer->directory);
+
+  if (!writer->failed &&
+      (pwrite(writer->fd, &writer->header, sizeof(writer->header), 0) != sizeof(writer->header) ||
+       pwrite(writer->fd, writer->directory, writer->header.num_events * sizeof(struct SnapshotEvent),
+              sizeof(writer->header)) != (ssize_t)(writer->header.num_events * sizeof(struct SnapshotEvent)) ||
+       fsync(writer->fd) != 0)) {
+    writer->failed = 1;
+  }
+
+  // The previous snapshot is only replaced by a complete one, and the rename is durable with the directory
+  int result = writer->failed || close(writer->fd) != 0 || rename(writer->temporary_path, writer->path) != 0;
+  if (result == 0 && sync_directory(writer->path) != 0) {
+    result = 1;
+  }
+  if (writer->failed) {
+    close(writer->fd);
+  }
+  if (result) {
+    unlink(writer->temporary_path);
+  }
+
+  free_writer(writer);
+  return result;
+}
+
+void snapshot_abort(SnapshotWriter *writer) {
+  writer->failed = 1;
+  snapshot_commit(writer);
+}
+
+/// Unpacks seats of a given width, which is a constant wherever this is inlined.
+/// @param words The packed seats.
+/// @param seats Array to store the seats in.
+/// @param num_seats Number of seats.
+/// @param bits Bits of each seat.
+static inline void unpack_words(const uint64_t *words, unsigned int *seats, size_t num_seats, unsigned int bits) {
+  size_t per_word = 64 / bits;
+  uint64_t mask = ((uint64_t)1 << bits) - 1;
+
+  // Whole words first, so the inner loop has a fixed number of steps
+  size_t i = 0;
+  for (; i + per_word <= num_seats; i += per_word) {
+    uint64_t word = words[i / per_word];
+    for (size_t j = 0; j < per_word; j++) {
+      seats[i + j] = (unsigned int)((word >> (j * bits)) & mask);
+    }
+  }
+  for (size_t j = 0; i + j < num_seats; j++) {
+    seats[i + j] = (unsigned int)((words[i / per_word] >> (j * bits)) & mask);
+  }
+}
+
+void snapshot_unpack_seats(const struct SnapshotEvent *event, const void *packed, unsigned int *seats) {
+  size_t num_seats = event->rows * event->cols;
+  const uint64_t *words = (const uint64_t *)packed;
+
+  // Every seat is a reservation id at full width, or none is reserved and the seats stay zeroed
+  switch (event->seat_bits) {
+    case 0:
+      break;
+    case 1:
+      unpack_words(words, seats, num_seats, 1);
+      break;
+    case 2:
+      unpack_words(words, seats, num_seats, 2);
+      break;
+    case 4:
+      unpack_words(words, seats, num_seats, 4);
+      break;
+    case 8:
+      unpack_words(words, seats, num_seats, 8);
+      break;
+    case 16:
+      unpack_words(words, seats, num_seats, 16);
+      break;
+    default:
+      memcpy(seats, packed, num_seats * sizeof(unsigned int));
+      break;
+  }
+}
+
+/// Checks that the entry of an event describes seats that are inside the file and intact.
+/// @param event The entry of the event.
+/// @param previous The entry before it, NULL for the first one.
+/// @param file The mapped file.
+/// @param file_size Bytes of the file.
+/// @return 0 if the entry is valid, 1 otherwise.
+static int check_event(const struct SnapshotEvent *event, const struct SnapshotEvent *previous,
+                       const unsigned char *file, size_t file_size) {
+  if ((previous != NULL && previous->event_id >= event->event_id) ||
+      (event->seat_bits != 0 && (event->seat_bits & (event->seat_bits - 1)) != 0) || event->seat_bits > 32 ||
+      event->data_offset % 8 != 0 || event->rows == 0 || event->cols == 0 ||
+      event->cols > SIZE_MAX / event->rows / 32) {
+    return 1;
+  }
+
+  size_t size = packed_size(event);
+  if (event->data_offset > file_size || size > file_size - event->data_offset) {
+    return 1;
+  }
+  return fold(hash_words(&file[event->data_offset], size, 0xcbf29ce484222325ull)) != event->checksum;
+}
+
+int snapshot_load(const char *path, snapshot_apply apply, void *arg, uint64_t *lsn) {
+  *lsn = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return errno != ENOENT;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(struct SnapshotHeader)) {
+    close(fd);
+    return 1;
+  }
+
+  size_t file_size = (size_t)file_stat.st_size;
+  const unsigned char *file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    return 1;
+  }
+
+  // The pages are read ahead, since all of them are used
+  posix_madvise((void *)file, file_size, POSIX_MADV_WILLNEED);
+
+  const struct SnapshotHeader *header = (const struct SnapshotHeader *)file;
+  const struct SnapshotEvent *directory = (const struct SnapshotEvent *)(header + 1);
+  int result = header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+               header->num_events > (file_size - sizeof(*header)) / sizeof(struct SnapshotEvent) ||
+               directory_checksum(header, directory) != header->checksum;
+
+  // Nothing is loaded from a file that is damaged anywhere
+  for (uint32_t i = 0; i < header->num_events && result == 0; i++) {
+    result = check_event(&directory[i], i > 0 ? &directory[i - 1] : NULL, file, file_size);
+  }
+
+  for (uint32_t i = 0; i < header->num_events && result == 0; i++) {
+    result = apply(&directory[i], &file[directory[i].data_offset], arg);
+  }
+
+  if (result == 0) {
+    *lsn = header->lsn;
+  }
+  munmap((void *)file, file_size);
+  return result;
+}
@@ -0,0 +1,90 @@
+#ifndef SERVER_SNAPSHOT_H
+#define SERVER_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_MAGIC 0x50534d45u  // "EMSP", identifies a snapshot file
+#define SNAPSHOT_VERSION 1          // Version of the format, files of other versions are refused
+
+// Start of a snapshot file. It is followed by the directory of the events, sorted by id, and then
+// by the packed seats of each event. Every part takes a multiple of 8 bytes.
+struct SnapshotHeader {
+  uint32_t magic;       /// SNAPSHOT_MAGIC.
+  uint32_t version;     /// SNAPSHOT_VERSION.
+  uint32_t num_events;  /// Number of events in the directory.
+  uint32_t checksum;    /// Checksum of the header, taken as 0 here, and of the directory.
+  uint64_t lsn;         /// Every change logged before this LSN of the write-ahead log is in the snapshot.
+};
+
+// Entry of an event in the directory of a snapshot
+struct SnapshotEvent {
+  uint32_t event_id;      /// Event id.
+  uint32_t reservations;  /// Number of reservations made for the event.
+  uint64_t rows;          /// Number of rows.
+  uint64_t cols;          /// Number of columns.
+  uint64_t data_offset;   /// Offset of the packed seats in the file.
+  uint32_t seat_bits;     /// Bits of each seat, a power of 2 up to 32, or 0 if every seat is free.
+  uint32_t checksum;      /// Checksum of the packed seats.
+};
+
+// Snapshot being written, which replaces the file at its path once committed
+typedef struct {
+  int fd;                          /// File descriptor of the temporary file
+  char *path;                      /// Pathname of the snapshot
+  char *temporary_path;            /// Pathname the snapshot is written to
+  struct SnapshotHeader header;    /// Header, written once every event is
+  struct SnapshotEvent *directory; /// Entries of the events, written along with the header
+  uint32_t max_events;             /// Number of entries the directory has room for
+  uint64_t *packed;                /// Buffer to pack the seats of an event in
+  size_t packed_capacity;          /// Number of words that fit in the buffer
+  uint64_t end;                    /// Offset after the seats written so far
+  int failed;                      /// Whether a write failed
+} SnapshotWriter;
+
+/// Function called with each event of a snapshot that is loaded.
+/// @param event The entry of the event.
+/// @param packed The packed seats of the event, to give to snapshot_unpack_seats.
+/// @param arg Argument given to snapshot_load.
+/// @return 0 to go on with the next event, 1 to stop loading.
+typedef int (*snapshot_apply)(const struct SnapshotEvent *event, const void *packed, void *arg);
+
+/// Starts writing a snapshot next to the given path.
+/// @param path Pathname of the snapshot.
+/// @param lsn LSN of the write-ahead log the snapshot starts at.
+/// @param max_events Maximum number of events the snapshot will have.
+/// @return The writer, NULL on failure.
+SnapshotWriter *snapshot_create(const char *path, uint64_t lsn, uint32_t max_events);
+
+/// Writes an event to a snapshot, packing its seats in as few bits as its reservation ids need.
+/// @note Events must be written in increasing order of id.
+/// @param writer The writer.
+/// @param event The event, of which the id, reservations, rows and cols are used.
+/// @param seats The rows * cols seats of the event.
+/// @return 0 if the event was written successfully, 1 otherwise.
+int snapshot_add_event(SnapshotWriter *writer, const struct SnapshotEvent *event, const unsigned int *seats);
+
+/// Makes a snapshot durable and replaces the previous one with it, then frees the writer.
+/// @param writer The writer.
+/// @return 0 if the snapshot was committed successfully, 1 otherwise.
+int snapshot_commit(SnapshotWriter *writer);
+
+/// Discards a snapshot being written and frees the writer.
+/// @param writer The writer.
+void snapshot_abort(SnapshotWriter *writer);
+
+/// Unpacks the seats of an event of a snapshot.
+/// @param event The entry of the event.
+/// @param packed The packed seats of the event.
+/// @param seats Array of rows * cols seats to store them in, which must start zeroed.
+void snapshot_unpack_seats(const struct SnapshotEvent *event, const void *packed, unsigned int *seats);
+
+/// Reads the events of a snapshot in order of id, once the whole file is verified.
+/// @param path Pathname of the snapshot, which may not exist.
+/// @param apply Function called with each event.
+/// @param arg Argument given to the function.
+/// @param lsn Variable to store the LSN of the snapshot in, 0 if there is none.
+/// @return 0 if the snapshot was loaded successfully or does not exist, 1 otherwise.
+int snapshot_load(const char *path, snapshot_apply apply, void *arg, uint64_t *lsn);
+
+#endif  // SERVER_SNAPSHOT_H
@@ -0,0 +1,58 @@
+#include "stats.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "common/io.h"
+
+
+struct ServerStats server_stats;
+
+
+int print_stats(int fd) {
+  char buffer[1024];
+
+  int len = snprintf(buffer, sizeof(buffer),
+                     "Sessions started: %lu\n"
+                     "Sessions idle timeout: %lu\n"
+                     "Sessions total timeout: %lu\n"
+                     "Watch deltas: %lu\n"
+                     "Watch resyncs: %lu\n"
+                     "Combine passes: %lu\n"
+                     "Combined reservations: %lu\n"
+                     "Claim conflicts: %lu\n"
+                     "WAL records: %lu\n"
+                     "WAL commits: %lu\n"
+                     "Checkpoints: %lu\n"
+                     "Snapshots: %lu\n"
+                     "CDC records: %lu\n"
+                     "CDC lag: %lu\n"
+                     "CDC dropped: %lu\n"
+                     "Replicated records: %lu\n"
+                     "Replication lag ms: %lu\n"
+                     "Replication errors: %lu\n",
+                     atomic_load(&server_stats.sessions_started),
+                     atomic_load(&server_stats.sessions_idle_timeout),
+                     atomic_load(&server_stats.sessions_total_timeout),
+                     atomic_load(&server_stats.watch_deltas),
+                     atomic_load(&server_stats.watch_resyncs),
+                     atomic_load(&server_stats.combine_passes),
+                     atomic_load(&server_stats.combined_reservations),
+                     atomic_load(&server_stats.claim_conflicts),
+                     atomic_load(&server_stats.wal_records),
+                     atomic_load(&server_stats.wal_commits),
+                     atomic_load(&server_stats.checkpoints),
+                     atomic_load(&server_stats.snapshots),
+                     atomic_load(&server_stats.cdc_records),
+                     atomic_load(&server_stats.cdc_records) - atomic_load(&server_stats.cdc_written),
+                     atomic_load(&server_stats.cdc_dropped),
+                     atomic_load(&server_stats.replica_records),
+                     atomic_load(&server_stats.replica_lag_ms),
+                     atomic_load(&server_stats.replica_errors));
+
+  if (len < 0 || (size_t)len >= sizeof(buffer)) {
+    return 1;
+  }
+
+  return print_str(fd, buffer);
+}
@@ -0,0 +1,35 @@
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <stdatomic.h>
+
+// Counters about the activity of the server
+struct ServerStats {
+  atomic_ulong sessions_started;        /// Sessions successfully set up
+  atomic_ulong sessions_idle_timeout;   /// Sessions closed for being idle for too long
+  atomic_ulong sessions_total_timeout;  /// Sessions closed for exceeding the session lifetime
+  atomic_ulong watch_deltas;            /// Deltas published to the sessions watching events
+  atomic_ulong watch_resyncs;           /// Times a watcher fell behind and was sent a snapshot instead
+  atomic_ulong combine_passes;          /// Passes of a combiner over the reservations of a hot event
+  atomic_ulong combined_reservations;   /// Reservations applied by a combiner
+  atomic_ulong claim_conflicts;         /// Lock-free reservations that found a seat already claimed
+  atomic_ulong wal_records;             /// Records appended to the write-ahead log
+  atomic_ulong wal_commits;             /// Writes of the log shared by the records appended meanwhile
+  atomic_ulong checkpoints;             /// Checkpoints written, after which the log is replayed from
+  atomic_ulong snapshots;               /// Snapshots written by the snapshot thread
+  atomic_ulong cdc_records;             /// Records added to the change feed
+  atomic_ulong cdc_written;             /// Records of the change feed written to its output
+  atomic_ulong cdc_dropped;             /// Records dropped because the change feed was full
+  atomic_ulong replica_records;          /// Records of the feed of the primary applied by a standby
+  atomic_ulong replica_lag_ms;          /// Milliseconds from a change on the primary to the standby applying it, for the last one
+  atomic_ulong replica_errors;          /// Records of the primary a standby could not apply, and feeds it found corrupted
+};
+
+extern struct ServerStats server_stats;
+
+/// Writes the server statistics to the given file descriptor.
+/// @param fd The file descriptor to write to.
+/// @return 0 if the statistics were written successfully, 1 otherwise.
+int print_stats(int fd);
+
+#endif  // SERVER_STATS_H
@@ -0,0 +1,125 @@
+#include "store.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+Store *store_open(const char *path) {
+  Store *store = (Store *)malloc(sizeof(Store));
+  if (store == NULL) {
+    return NULL;
+  }
+
+  store->fd = open(path, O_RDWR | O_CREAT, 0640);
+  if (store->fd == -1) {
+    free(store);
+    return NULL;
+  }
+
+  struct stat file_stat;
+  if (fstat(store->fd, &file_stat) != 0) {
+    close(store->fd);
+    free(store);
+    return NULL;
+  }
+
+  // A new file only has room for the header, which starts zeroed
+  int created = file_stat.st_size == 0;
+  store->file_size = created ? sizeof(struct StoreHeader) : (size_t)file_stat.st_size;
+  if ((created && ftruncate(store->fd, (off_t)store->file_size) != 0) || store->file_size < sizeof(struct StoreHeader)) {
+    close(store->fd);
+    free(store);
+    return NULL;
+  }
+
+  // The whole address space is reserved at once, so the seats never move when the file grows
+  void *mapping = mmap(NULL, STORE_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(store->fd);
+    free(store);
+    return NULL;
+  }
+  store->header = (struct StoreHeader *)mapping;
+
+  if (created) {
+    store->header->magic = STORE_MAGIC;
+    store->header->num_events = 0;
+    store->header->size = sizeof(struct StoreHeader);
+  }
+
+  if (store->header->magic != STORE_MAGIC || store->header->size > store->file_size ||
+      store->header->num_events > STORE_MAX_EVENTS) {
+    munmap(mapping, STORE_MAP_SIZE);
+    close(store->fd);
+    free(store);
+    return NULL;
+  }
+
+  return store;
+}
+
+void store_close(Store *store) {
+  if (store == NULL) return;
+
+  store_sync(store);
+  munmap(store->header, STORE_MAP_SIZE);
+  close(store->fd);
+  free(store);
+}
+
+int store_prepare_event(Store *store, unsigned int event_id, size_t rows, size_t cols, struct StoreEntry **entry,
+                        unsigned int **data) {
+  if (store->header->num_events == STORE_MAX_EVENTS) {
+    return 1;
+  }
+
+  size_t offset = (store->header->size + STORE_ALIGNMENT - 1) / STORE_ALIGNMENT * STORE_ALIGNMENT;
+  size_t end = offset + rows * cols * sizeof(unsigned int);
+  if (end > STORE_MAP_SIZE) {
+    return 1;
+  }
+
+  // The file grows with zeros, but the space of an event that was never committed may be reused
+  if (offset < store->file_size) {
+    size_t reused = (end < store->file_size ? end : store->file_size) - offset;
+    memset((char *)store->header + offset, 0, reused);
+  }
+  if (end > store->file_size) {
+    if (ftruncate(store->fd, (off_t)end) != 0) {
+      return 1;
+    }
+    store->file_size = end;
+  }
+
+  struct StoreEntry *new_entry = &store->header->entries[store->header->num_events];
+  new_entry->event_id = event_id;
+  new_entry->reservations = 0;
+  new_entry->rows = rows;
+  new_entry->cols = cols;
+  new_entry->data_offset = offset;
+
+  *entry = new_entry;
+  *data = store_event_data(store, new_entry);
+  return 0;
+}
+
+void store_commit_event(Store *store) {
+  struct StoreEntry *entry = &store->header->entries[store->header->num_events];
+  store->header->size = entry->data_offset + entry->rows * entry->cols * sizeof(unsigned int);
+  store->header->num_events++;
+}
+
+unsigned int *store_event_data(Store *store, const struct StoreEntry *entry) {
+  return (unsigned int *)((char *)store->header + entry->data_offset);
+}
+
+int store_sync(Store *store) {
+  if (msync(store->header, store->header->size, MS_SYNC) != 0) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef SERVER_STORE_H
+#define SERVER_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STORE_MAGIC 0x31534d45u             // "EMS1", identifies a store file
+#define STORE_MAX_EVENTS 4096               // Events the directory of a store has room for
+#define STORE_MAP_SIZE ((size_t)1 << 36)    // Address space reserved for the mapping, the file grows within it
+#define STORE_ALIGNMENT 64                  // Alignment of the seats of each event in the file
+
+// Entry of the directory of a store, describing an event and where its seats are
+struct StoreEntry {
+  uint32_t event_id;      /// Event id.
+  uint32_t reservations;  /// Number of reservations made for the event.
+  uint64_t rows;          /// Number of rows.
+  uint64_t cols;          /// Number of columns.
+  uint64_t data_offset;   /// Position in the file of the rows * cols seats of the event.
+};
+
+// Start of a store file, followed by the seats of every event
+struct StoreHeader {
+  uint32_t magic;                               /// STORE_MAGIC.
+  uint32_t num_events;                          /// Number of entries of the directory in use.
+  uint64_t size;                                /// Bytes of the file in use.
+  struct StoreEntry entries[STORE_MAX_EVENTS];  /// Directory of the events, in the order they were created.
+};
+
+// File with the events and their seats, mapped in memory so that the seats of the
+// events are used in place. The kernel writes the changes back to the file, and
+// store_sync makes them durable.
+typedef struct {
+  int fd;                      /// File descriptor of the file
+  struct StoreHeader *header;  /// Start of the mapping
+  size_t file_size;            /// Current size of the file
+} Store;
+
+/// Opens a store, creating an empty one if the file does not exist.
+/// @param path Pathname of the file.
+/// @return The store, NULL on failure.
+Store *store_open(const char *path);
+
+/// Syncs and unmaps a store.
+/// @param store The store to be closed.
+void store_close(Store *store);
+
+/// Makes room in a store for the seats of a new event, all of them free.
+/// @note Events must be added one at a time. The event is only part of the store once committed.
+/// @param store The store.
+/// @param event_id Id of the event.
+/// @param rows Number of rows of the event.
+/// @param cols Number of columns of the event.
+/// @param entry Variable to store the entry of the event in.
+/// @param data Variable to store the seats of the event in.
+/// @return 0 if there is room for the event, 1 otherwise.
+int store_prepare_event(Store *store, unsigned int event_id, size_t rows, size_t cols, struct StoreEntry **entry,
+                        unsigned int **data);
+
+/// Adds the event prepared last to the directory of a store.
+/// @param store The store.
+void store_commit_event(Store *store);
+
+/// Gets the seats of an event of a store.
+/// @param store The store.
+/// @param entry Entry of the event.
+/// @return The rows * cols seats of the event.
+unsigned int *store_event_data(Store *store, const struct StoreEntry *entry);
+
+/// Writes the changes made to a store to its file.
+/// @param store The store.
+/// @return 0 if the changes are durable, 1 otherwise.
+int store_sync(Store *store);
+
+#endif  // SERVER_STORE_H
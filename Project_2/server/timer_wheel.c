@@ -0,0 +1,252 @@
+#include "timer_wheel.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+/// Gets the number of milliseconds elapsed on the monotonic clock.
+/// @return The current time in milliseconds.
+static unsigned long now_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)now.tv_sec * 1000 + (unsigned long)now.tv_nsec / 1000000;
+}
+
+static void list_init(TimerNode *sentinel) {
+  sentinel->prev = sentinel;
+  sentinel->next = sentinel;
+}
+
+static void list_append(TimerNode *sentinel, TimerNode *timer) {
+  timer->prev = sentinel->prev;
+  timer->next = sentinel;
+  sentinel->prev->next = timer;
+  sentinel->prev = timer;
+}
+
+static void list_remove(TimerNode *timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+}
+
+/// Inserts a timer in the level whose range covers its expiration tick.
+/// @note The wheel mutex must be held.
+static void wheel_place(TimerWheel *wheel, TimerNode *timer) {
+  unsigned long expires = timer->expires > wheel->current_tick ? timer->expires : wheel->current_tick;
+  unsigned long delta = expires - wheel->current_tick;
+
+  size_t level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >> (TIMER_WHEEL_BITS * (level + 1)) != 0) {
+    level++;
+  }
+
+  // Timers beyond the range of the last level are placed at its end, and placed again when it is reached
+  unsigned long range = 1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS);
+  if (delta >= range) {
+    expires = wheel->current_tick + range - 1;
+  }
+
+  size_t slot = (expires >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+  list_append(&wheel->slots[level][slot], timer);
+}
+
+/// Schedules a timer to expire after a number of ticks.
+/// @note The wheel mutex must be held.
+static void wheel_insert(TimerWheel *wheel, TimerNode *timer, unsigned long ticks) {
+  if (ticks == 0) {
+    ticks = 1;
+  }
+  timer->expires = wheel->current_tick + ticks;
+  wheel_place(wheel, timer);
+}
+
+/// Moves the timers of the slot of a level that the current tick reached to the lower levels.
+/// @note The wheel mutex must be held.
+static void wheel_cascade(TimerWheel *wheel, size_t level) {
+  size_t slot = (wheel->current_tick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+  TimerNode *sentinel = &wheel->slots[level][slot];
+
+  TimerNode cascading;
+  list_init(&cascading);
+  while (sentinel->next != sentinel) {
+    TimerNode *timer = sentinel->next;
+    list_remove(timer);
+    list_append(&cascading, timer);
+  }
+
+  while (cascading.next != &cascading) {
+    TimerNode *timer = cascading.next;
+    list_remove(timer);
+    wheel_place(wheel, timer);
+  }
+}
+
+/// Moves the expired timers of the current tick to the pending list and fires them.
+/// @note The wheel mutex must be held, it is released while the callbacks run.
+static void wheel_advance(TimerWheel *wheel) {
+  // Higher levels are cascaded first, since their timers may fall into the lower slots reached now
+  for (size_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+    unsigned long mask = (1UL << (TIMER_WHEEL_BITS * level)) - 1;
+    if ((wheel->current_tick & mask) == 0) {
+      wheel_cascade(wheel, level);
+    }
+  }
+
+  TimerNode *slot = &wheel->slots[0][wheel->current_tick & (TIMER_WHEEL_SLOTS - 1)];
+
+  for (TimerNode *timer = slot->next; timer != slot;) {
+    TimerNode *next = timer->next;
+    if (timer->expires <= wheel->current_tick) {
+      list_remove(timer);
+      list_append(&wheel->pending, timer);
+    }
+    timer = next;
+  }
+
+  while (wheel->pending.next != &wheel->pending) {
+    TimerNode *timer = wheel->pending.next;
+    list_remove(timer);
+    wheel->running = timer;
+
+    pthread_mutex_unlock(&wheel->mutex);
+    unsigned long rearm = timer->callback(timer);
+    pthread_mutex_lock(&wheel->mutex);
+
+    // The timer may have been rescheduled while its callback was running
+    if (rearm > 0 && timer->next == NULL) {
+      wheel_insert(wheel, timer, rearm);
+    }
+    wheel->running = NULL;
+    pthread_cond_broadcast(&wheel->callback_done);
+  }
+}
+
+static void *wheel_thread(void *arg) {
+  TimerWheel *wheel = (TimerWheel *)arg;
+
+  // Signals are handled by the other threads
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  unsigned long start = now_ms();
+  struct timespec tick = {wheel->tick_ms / 1000, (long)(wheel->tick_ms % 1000) * 1000000};
+
+  pthread_mutex_lock(&wheel->mutex);
+  while (!wheel->stop) {
+    pthread_mutex_unlock(&wheel->mutex);
+    nanosleep(&tick, NULL);
+    pthread_mutex_lock(&wheel->mutex);
+
+    // Catches up with the clock if the thread was delayed
+    unsigned long target = (now_ms() - start) / wheel->tick_ms;
+    while (wheel->current_tick < target && !wheel->stop) {
+      wheel->current_tick++;
+      wheel_advance(wheel);
+    }
+  }
+  pthread_mutex_unlock(&wheel->mutex);
+
+  return NULL;
+}
+
+TimerWheel *timer_wheel_create(unsigned int tick_ms) {
+  TimerWheel *wheel = (TimerWheel *)malloc(sizeof(TimerWheel));
+  if (!wheel) return NULL;
+
+  for (size_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+      list_init(&wheel->slots[level][i]);
+    }
+  }
+  list_init(&wheel->pending);
+  wheel->running = NULL;
+  wheel->current_tick = 0;
+  wheel->tick_ms = tick_ms > 0 ? tick_ms : 1;
+  wheel->stop = 0;
+
+  if (pthread_mutex_init(&wheel->mutex, NULL) != 0) {
+    free(wheel);
+    return NULL;
+  }
+
+  if (pthread_cond_init(&wheel->callback_done, NULL) != 0) {
+    pthread_mutex_destroy(&wheel->mutex);
+    free(wheel);
+    return NULL;
+  }
+
+  if (pthread_create(&wheel->thread, NULL, wheel_thread, wheel) != 0) {
+    pthread_cond_destroy(&wheel->callback_done);
+    pthread_mutex_destroy(&wheel->mutex);
+    free(wheel);
+    return NULL;
+  }
+
+  return wheel;
+}
+
+void timer_wheel_destroy(TimerWheel *wheel) {
+  if (!wheel) return;
+
+  pthread_mutex_lock(&wheel->mutex);
+  wheel->stop = 1;
+  pthread_mutex_unlock(&wheel->mutex);
+  pthread_join(wheel->thread, NULL);
+
+  pthread_cond_destroy(&wheel->callback_done);
+  pthread_mutex_destroy(&wheel->mutex);
+  free(wheel);
+}
+
+void timer_init(TimerNode *timer, timer_callback callback, void *arg) {
+  timer->prev = NULL;
+  timer->next = NULL;
+  timer->expires = 0;
+  timer->callback = callback;
+  timer->arg = arg;
+}
+
+unsigned long timer_wheel_ms_to_ticks(TimerWheel *wheel, unsigned long ms) {
+  return (ms + wheel->tick_ms - 1) / wheel->tick_ms;
+}
+
+int timer_wheel_schedule(TimerWheel *wheel, TimerNode *timer, unsigned long ticks) {
+  if (pthread_mutex_lock(&wheel->mutex) != 0) {
+    return 1;
+  }
+
+  if (timer->next != NULL) {
+    list_remove(timer);
+  }
+  wheel_insert(wheel, timer, ticks);
+
+  if (pthread_mutex_unlock(&wheel->mutex) != 0) {
+    return 1;
+  }
+  return 0;
+}
+
+int timer_wheel_cancel(TimerWheel *wheel, TimerNode *timer) {
+  if (pthread_mutex_lock(&wheel->mutex) != 0) {
+    return 1;
+  }
+
+  // The callback may reschedule the timer, so it must finish before unlinking it
+  while (wheel->running == timer) {
+    pthread_cond_wait(&wheel->callback_done, &wheel->mutex);
+  }
+
+  if (timer->next != NULL) {
+    list_remove(timer);
+  }
+
+  if (pthread_mutex_unlock(&wheel->mutex) != 0) {
+    return 1;
+  }
+  return 0;
+}
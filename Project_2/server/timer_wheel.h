@@ -0,0 +1,77 @@
+#ifndef SERVER_TIMER_WHEEL_H
+#define SERVER_TIMER_WHEEL_H
+
+#include <pthread.h>
+
+#define TIMER_WHEEL_BITS 6                        // Bits of the expiration tick indexing each level
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)  // Slots of each level
+#define TIMER_WHEEL_LEVELS 4                      // Timers further in the future wait in the last level
+
+typedef struct TimerNode TimerNode;
+
+/// Function called by the wheel thread when a timer expires.
+/// @param timer The timer that expired.
+/// @return 0 to stop the timer, or the number of ticks after which it should fire again.
+typedef unsigned long (*timer_callback)(TimerNode *timer);
+
+// Intrusive timer, meant to be embedded in the structure it times out
+struct TimerNode {
+  TimerNode *prev;           /// Previous timer in the slot (NULL if not scheduled)
+  TimerNode *next;           /// Next timer in the slot (NULL if not scheduled)
+  unsigned long expires;     /// Tick in which the timer expires
+  timer_callback callback;   /// Function called when the timer expires
+  void *arg;                 /// Argument available to the callback
+};
+
+// Hierarchical timer wheel serviced by a single background thread. Each level covers
+// TIMER_WHEEL_SLOTS times the range of the previous one, and its timers are moved down a
+// level when the lower levels wrap around, so scheduling and expiring a timer are O(1).
+typedef struct {
+  TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  /// Sentinels of the lists of each slot
+  TimerNode pending;                   /// Sentinel of the list of expired timers
+  TimerNode *running;                  /// Timer whose callback is being executed
+  unsigned long current_tick;          /// Last tick processed by the wheel
+  unsigned int tick_ms;                /// Duration of a tick in milliseconds
+  int stop;                            /// Whether the wheel thread should terminate
+  pthread_t thread;                    /// The thread servicing the wheel
+  pthread_mutex_t mutex;               /// Mutex to protect the wheel
+  pthread_cond_t callback_done;        /// Signaled when the running callback returns
+} TimerWheel;
+
+/// Creates a new timer wheel and starts the thread servicing it.
+/// @param tick_ms Duration of a tick in milliseconds.
+/// @return Newly created timer wheel, NULL on failure.
+TimerWheel *timer_wheel_create(unsigned int tick_ms);
+
+/// Stops the wheel thread and deallocates the wheel.
+/// @note Scheduled timers are discarded without being fired.
+/// @param wheel The wheel to be destroyed.
+void timer_wheel_destroy(TimerWheel *wheel);
+
+/// Initializes a timer so that it can be scheduled.
+/// @param timer The timer to be initialized.
+/// @param callback Function to be called when the timer expires.
+/// @param arg Argument available to the callback.
+void timer_init(TimerNode *timer, timer_callback callback, void *arg);
+
+/// Converts a duration in milliseconds to wheel ticks, rounding up.
+/// @param wheel The wheel the duration refers to.
+/// @param ms The duration in milliseconds.
+/// @return The number of ticks.
+unsigned long timer_wheel_ms_to_ticks(TimerWheel *wheel, unsigned long ms);
+
+/// Schedules a timer, rescheduling it if it was already scheduled.
+/// @param wheel The wheel to schedule the timer in.
+/// @param timer The timer to be scheduled.
+/// @param ticks Number of ticks from now after which the timer expires.
+/// @return 0 if the timer was scheduled successfully, 1 otherwise.
+int timer_wheel_schedule(TimerWheel *wheel, TimerNode *timer, unsigned long ticks);
+
+/// Cancels a timer. When this function returns the callback of the timer is
+/// guaranteed not to be running, so the timer can be safely deallocated.
+/// @param wheel The wheel the timer was scheduled in.
+/// @param timer The timer to be cancelled.
+/// @return 0 if the timer was cancelled successfully, 1 otherwise.
+int timer_wheel_cancel(TimerWheel *wheel, TimerNode *timer);
+
+#endif  // SERVER_TIMER_WHEEL_H
@@ -0,0 +1,515 @@
+#include "wal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/io.h"
+#include "stats.h"
+
+
+uint32_t wal_checksum(const struct WalRecord *record) {
+  // FNV-1a, enough to tell a record apart from the torn end of the file
+  const unsigned char *bytes = (const unsigned char *)record;
+  uint32_t hash = 2166136261u;
+  for (size_t i = offsetof(struct WalRecord, type); i < record->size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/// Finds the end of the complete records that follow an LSN.
+/// @param wal The log.
+/// @param start LSN of the first record.
+/// @return LSN after the last complete record, start if the first one is not complete.
+static uint64_t ready_end(Wal *wal, uint64_t start) {
+  uint64_t reserved = atomic_load(&wal->reserved);
+  uint64_t end = start;
+
+  // The ring holds at most a full buffer of records after the start, anything further is not theirs
+  uint64_t limit = start + WAL_BUFFER_SIZE;
+  if (reserved > limit) {
+    reserved = limit;
+  }
+
+  while (end < reserved) {
+    uint32_t size = __atomic_load_n((uint32_t *)&wal->ring[end % WAL_BUFFER_SIZE], __ATOMIC_ACQUIRE);
+    if (size == 0 || size > reserved - end) {
+      break;  // The record is still being copied, the next ones wait for it
+    }
+    end += size;
+  }
+  return end;
+}
+
+/// Writes a buffer to a file.
+/// @param fd File descriptor of the file.
+/// @param buffer The bytes to write.
+/// @param size Number of bytes.
+/// @return 0 if every byte was written, 1 otherwise.
+static int write_bytes(int fd, const void *buffer, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)buffer;
+  for (size_t done = 0; done < size;) {
+    ssize_t written = write(fd, &bytes[done], size - done);
+    if (written < 0) {
+      return 1;
+    }
+    done += (size_t)written;
+  }
+  return 0;
+}
+
+/// Reads the header of a log, if it has one.
+/// @param fd File descriptor of the log.
+/// @param file_size Bytes of the log.
+/// @param base Variable to store the LSN of the first record in.
+/// @param header_size Variable to store the bytes of the header in, 0 if the log has none.
+static void read_header(int fd, size_t file_size, uint64_t *base, size_t *header_size) {
+  struct WalHeader header;
+  if (file_size >= sizeof(header) && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+      header.magic == WAL_MAGIC) {
+    *base = header.base;
+    *header_size = sizeof(header);
+  } else {
+    *base = 0;
+    *header_size = 0;
+  }
+}
+
+/// Writes the records of the ring between two LSNs to the file and makes them durable.
+/// @param wal The log.
+/// @param start LSN of the first record.
+/// @param end LSN after the last record.
+/// @return 0 if the records are durable, 1 otherwise.
+static int write_records(Wal *wal, uint64_t start, uint64_t end) {
+  int result = 0;
+
+  // The records may wrap around the end of the ring
+  for (uint64_t lsn = start; lsn < end;) {
+    size_t position = lsn % WAL_BUFFER_SIZE;
+    size_t length = WAL_BUFFER_SIZE - position;
+    if (length > end - lsn) {
+      length = end - lsn;
+    }
+
+    if (result == 0) {
+      result = write_bytes(wal->fd, &wal->ring[position], length);
+    }
+
+    // The space is cleared, so that the size of the record written there next starts as 0
+    memset(&wal->ring[position], 0, length);
+    lsn += length;
+  }
+
+  if (result == 0 && fdatasync(wal->fd) != 0) {
+    result = 1;
+  }
+  return result;
+}
+
+/// Copies the records of the log from an LSN to a new file, which then replaces the log.
+/// @note Only the flusher writes to the file, so it is the one that replaces it, between two commits.
+/// @param wal The log.
+/// @param lsn LSN of the first record kept, which is durable.
+/// @return 0 if the log was replaced, 1 otherwise.
+static int rotate_log(Wal *wal, uint64_t lsn) {
+  if (lsn <= wal->base) {
+    return 0;
+  }
+
+  off_t end = lseek(wal->fd, 0, SEEK_CUR);
+  off_t from = (off_t)(wal->header_size + (lsn - wal->base));
+  if (end == -1 || from > end) {
+    return 1;
+  }
+
+  int fd = open(wal->temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+  if (fd == -1) {
+    return 1;
+  }
+
+  struct WalHeader header = {.magic = WAL_MAGIC, .base = lsn};
+  int result = write_bytes(fd, &header, sizeof(header));
+
+  unsigned char buffer[WAL_COPY_BYTES];
+  for (off_t offset = from; offset < end && result == 0;) {
+    size_t length = (size_t)(end - offset) < sizeof(buffer) ? (size_t)(end - offset) : sizeof(buffer);
+    ssize_t size = pread(wal->fd, buffer, length, offset);
+    if (size <= 0) {
+      result = 1;
+    } else {
+      result = write_bytes(fd, buffer, (size_t)size);
+      offset += size;
+    }
+  }
+
+  if (result != 0 || fsync(fd) != 0 || rename(wal->temporary_path, wal->path) != 0) {
+    close(fd);
+    unlink(wal->temporary_path);
+    return 1;
+  }
+
+  // From here the records are appended to the new file, so they are only durable once its name is
+  close(wal->fd);
+  wal->fd = fd;
+  wal->base = lsn;
+  wal->header_size = sizeof(header);
+  if (sync_directory(wal->path) != 0) {
+    wal->failed = 1;
+    return 1;
+  }
+  return 0;
+}
+
+static void *wal_flusher(void *arg) {
+  Wal *wal = (Wal *)arg;
+
+  // Signals are handled by the other threads
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  uint64_t written = atomic_load(&wal->durable);
+
+  pthread_mutex_lock(&wal->mutex);
+  while (1) {
+    int stop = wal->stop;
+    if (!stop && atomic_load(&wal->reserved) - written < WAL_COMMIT_BYTES) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += WAL_COMMIT_INTERVAL_US * 1000;
+      if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&wal->wake, &wal->mutex, &deadline);
+      stop = wal->stop;
+    }
+    pthread_mutex_unlock(&wal->mutex);
+
+    // Every record that is complete is written at once, the group commit
+    uint64_t end = ready_end(wal, written);
+    int result = end > written ? write_records(wal, written, end) : 0;
+
+    pthread_mutex_lock(&wal->mutex);
+    if (end > written) {
+      if (result != 0) {
+        wal->failed = 1;
+      }
+      written = end;
+      atomic_store(&wal->durable, end);
+      atomic_fetch_add(&server_stats.wal_commits, 1);
+      pthread_cond_broadcast(&wal->flushed);
+    }
+
+    // Records a checkpoint has are dropped between commits, while appends go on in the ring
+    if (wal->truncate_lsn != 0) {
+      uint64_t lsn = wal->truncate_lsn;
+      pthread_mutex_unlock(&wal->mutex);
+      int truncated = rotate_log(wal, lsn);
+      pthread_mutex_lock(&wal->mutex);
+      wal->truncate_lsn = 0;
+      wal->truncate_result = truncated;
+      pthread_cond_broadcast(&wal->flushed);
+    }
+
+    // Nothing is appended once the log is being closed
+    if (stop && written == atomic_load(&wal->reserved)) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&wal->mutex);
+
+  return NULL;
+}
+
+// Records of the events that one thread of a replay applies, in the order of the log
+struct ReplayPartition {
+  const struct WalRecord **records;  /// Records of the partition.
+  size_t num_records;                /// Number of records.
+  size_t capacity;                   /// Number of records that fit in the array.
+  wal_apply apply;                   /// Function called with each record.
+  void *arg;                         /// Argument given to the function.
+  int result;                        /// 0 if every record was applied, 1 otherwise.
+  pthread_t thread;                  /// Thread applying the records.
+};
+
+/// Adds a record to the end of a partition.
+/// @param partition The partition.
+/// @param record The record.
+/// @return 0 if the record was added successfully, 1 otherwise.
+static int add_to_partition(struct ReplayPartition *partition, const struct WalRecord *record) {
+  if (partition->num_records == partition->capacity) {
+    size_t capacity = partition->capacity == 0 ? 1024 : partition->capacity * 2;
+    const struct WalRecord **records = realloc(partition->records, capacity * sizeof(*records));
+    if (records == NULL) {
+      return 1;
+    }
+    partition->records = records;
+    partition->capacity = capacity;
+  }
+
+  partition->records[partition->num_records++] = record;
+  return 0;
+}
+
+/// Applies the records of a partition, in order.
+/// @param partition The partition.
+static void replay_partition(struct ReplayPartition *partition) {
+  for (size_t i = 0; i < partition->num_records && partition->result == 0; i++) {
+    partition->result = partition->apply(partition->records[i], partition->arg);
+  }
+}
+
+static void *replay_thread(void *arg) {
+  // Signals are handled by the other threads
+  sigset_t signal_mask;
+  sigfillset(&signal_mask);
+  pthread_sigmask(SIG_BLOCK, &signal_mask, NULL);
+
+  replay_partition((struct ReplayPartition *)arg);
+  return NULL;
+}
+
+int wal_replay(const char *path, uint64_t start, size_t num_threads, wal_apply apply, void *arg, size_t *valid_size) {
+  *valid_size = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return errno != ENOENT || start != 0;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return 1;
+  }
+
+  // A checkpoint taken after the end of the log, or before the records the log starts with, does not belong to it
+  size_t file_size = (size_t)file_stat.st_size;
+  uint64_t base;
+  size_t header_size;
+  read_header(fd, file_size, &base, &header_size);
+  if (start < base || start - base > file_size - header_size) {
+    close(fd);
+    return 1;
+  }
+  size_t first = header_size + (size_t)(start - base);
+  if (file_size == first) {
+    close(fd);
+    *valid_size = file_size;
+    return 0;
+  }
+
+  const unsigned char *log = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (log == MAP_FAILED) {
+    return 1;
+  }
+
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+  struct ReplayPartition *partitions = calloc(num_threads, sizeof(struct ReplayPartition));
+  if (partitions == NULL) {
+    munmap((void *)log, file_size);
+    return 1;
+  }
+
+  // The records of an event all go to the same partition, so they are applied in order. Events are
+  // created while the log is read instead, so that they are added to the state in the order of the log.
+  size_t position = first;
+  int result = 0;
+  while (position + sizeof(struct WalRecord) <= file_size && result == 0) {
+    const struct WalRecord *record = (const struct WalRecord *)&log[position];
+
+    // A crash may leave part of a record at the end, where the valid records stop
+    if (record->size != sizeof(struct WalRecord) + record->num_runs * sizeof(struct WalRun) ||
+        position + record->size > file_size || record->checksum != wal_checksum(record)) {
+      break;
+    }
+
+    if (record->type == WAL_CREATE) {
+      result = apply(record, arg);
+    } else {
+      result = add_to_partition(&partitions[record->event_id % num_threads], record);
+    }
+    position += record->size;
+  }
+
+  size_t started = 0;
+  for (size_t i = 0; i < num_threads && result == 0; i++) {
+    partitions[i].apply = apply;
+    partitions[i].arg = arg;
+    if (i + 1 == num_threads) {
+      replay_partition(&partitions[i]);  // The last partition is applied by this thread, keeping its signals
+    } else if (pthread_create(&partitions[i].thread, NULL, replay_thread, &partitions[i]) != 0) {
+      result = 1;
+    } else {
+      started++;
+    }
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    if (i < started) {
+      pthread_join(partitions[i].thread, NULL);
+    }
+    if (partitions[i].result != 0) {
+      result = 1;
+    }
+    free(partitions[i].records);
+  }
+
+  free(partitions);
+  munmap((void *)log, file_size);
+  *valid_size = position;
+  return result;
+}
+
+/// Frees a log whose flusher is not running.
+/// @param wal The log.
+static void free_wal(Wal *wal) {
+  if (wal->fd != -1) close(wal->fd);
+  free(wal->path);
+  free(wal->temporary_path);
+  free(wal->ring);
+  free(wal);
+}
+
+Wal *wal_open(const char *path, size_t valid_size) {
+  Wal *wal = (Wal *)calloc(1, sizeof(Wal));
+  if (wal == NULL) {
+    return NULL;
+  }
+  wal->fd = -1;
+
+  size_t length = strlen(path);
+  wal->path = (char *)malloc(length + 1);
+  wal->temporary_path = (char *)malloc(length + 5);
+  wal->ring = (unsigned char *)calloc(WAL_BUFFER_SIZE, 1);
+  if (wal->path == NULL || wal->temporary_path == NULL || wal->ring == NULL) {
+    free_wal(wal);
+    return NULL;
+  }
+  strcpy(wal->path, path);
+  snprintf(wal->temporary_path, length + 5, "%s.tmp", path);
+
+  // The torn end left by a crash is discarded, so new records follow the valid ones
+  wal->fd = open(path, O_RDWR | O_CREAT, 0640);
+  if (wal->fd == -1 || ftruncate(wal->fd, (off_t)valid_size) != 0 ||
+      lseek(wal->fd, (off_t)valid_size, SEEK_SET) == -1) {
+    free_wal(wal);
+    return NULL;
+  }
+
+  read_header(wal->fd, valid_size, &wal->base, &wal->header_size);
+  atomic_init(&wal->reserved, wal->base + (valid_size - wal->header_size));
+  atomic_init(&wal->durable, wal->base + (valid_size - wal->header_size));
+  wal->stop = 0;
+  wal->failed = 0;
+  wal->truncate_lsn = 0;
+
+  if (pthread_mutex_init(&wal->mutex, NULL) != 0) {
+    free_wal(wal);
+    return NULL;
+  }
+
+  if (pthread_cond_init(&wal->flushed, NULL) != 0 || pthread_cond_init(&wal->wake, NULL) != 0 ||
+      pthread_create(&wal->thread, NULL, wal_flusher, wal) != 0) {
+    pthread_mutex_destroy(&wal->mutex);
+    free_wal(wal);
+    return NULL;
+  }
+
+  return wal;
+}
+
+void wal_close(Wal *wal) {
+  if (wal == NULL) return;
+
+  pthread_mutex_lock(&wal->mutex);
+  wal->stop = 1;
+  pthread_cond_signal(&wal->wake);
+  pthread_mutex_unlock(&wal->mutex);
+  pthread_join(wal->thread, NULL);
+
+  pthread_cond_destroy(&wal->wake);
+  pthread_cond_destroy(&wal->flushed);
+  pthread_mutex_destroy(&wal->mutex);
+  free_wal(wal);
+}
+
+uint64_t wal_append(Wal *wal, struct WalRecord *record) {
+  uint32_t size = (uint32_t)(sizeof(struct WalRecord) + record->num_runs * sizeof(struct WalRun));
+  record->size = size;
+  record->checksum = wal_checksum(record);
+
+  uint64_t lsn = atomic_fetch_add(&wal->reserved, size);
+
+  // The space of the record is only reused once the records before it are in the file
+  if (lsn + size - atomic_load(&wal->durable) > WAL_BUFFER_SIZE) {
+    pthread_mutex_lock(&wal->mutex);
+    while (lsn + size - atomic_load(&wal->durable) > WAL_BUFFER_SIZE) {
+      pthread_cond_signal(&wal->wake);
+      pthread_cond_wait(&wal->flushed, &wal->mutex);
+    }
+    pthread_mutex_unlock(&wal->mutex);
+  }
+
+  // The size is stored last, since the flusher takes a record as complete once it sees it
+  const unsigned char *bytes = (const unsigned char *)record;
+  for (size_t done = sizeof(uint32_t); done < size;) {
+    size_t position = (lsn + done) % WAL_BUFFER_SIZE;
+    size_t length = WAL_BUFFER_SIZE - position < size - done ? WAL_BUFFER_SIZE - position : size - done;
+    memcpy(&wal->ring[position], &bytes[done], length);
+    done += length;
+  }
+  __atomic_store_n((uint32_t *)&wal->ring[lsn % WAL_BUFFER_SIZE], size, __ATOMIC_RELEASE);
+
+  if (lsn + size - atomic_load(&wal->durable) >= WAL_COMMIT_BYTES) {
+    pthread_cond_signal(&wal->wake);
+  }
+  return lsn + size;
+}
+
+uint64_t wal_end(Wal *wal) {
+  return atomic_load(&wal->reserved);
+}
+
+uint64_t wal_durable(Wal *wal) {
+  return atomic_load(&wal->durable);
+}
+
+int wal_truncate(Wal *wal, uint64_t lsn) {
+  if (lsn == 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&wal->mutex);
+  wal->truncate_lsn = lsn;
+  pthread_cond_signal(&wal->wake);
+  while (wal->truncate_lsn != 0) {
+    pthread_cond_wait(&wal->flushed, &wal->mutex);
+  }
+  int result = wal->truncate_result;
+  pthread_mutex_unlock(&wal->mutex);
+  return result;
+}
+
+int wal_wait(Wal *wal, uint64_t lsn) {
+  if (atomic_load(&wal->durable) < lsn) {
+    pthread_mutex_lock(&wal->mutex);
+    while (atomic_load(&wal->durable) < lsn) {
+      pthread_cond_wait(&wal->flushed, &wal->mutex);
+    }
+    pthread_mutex_unlock(&wal->mutex);
+  }
+  return wal->failed;
+}
@@ -0,0 +1,143 @@
+#ifndef SERVER_WAL_H
+#define SERVER_WAL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WAL_BUFFER_SIZE ((size_t)1 << 22)   // Bytes of records that may wait for the flusher, a power of 2
+#define WAL_COMMIT_INTERVAL_US 2000         // Maximum time a record waits to be written
+#define WAL_COMMIT_BYTES ((size_t)1 << 16)  // Bytes of records after which they are written right away
+#define WAL_MAGIC 0x4c534d45u               // "EMSL", starts a log whose first records were dropped
+#define WAL_COPY_BYTES ((size_t)1 << 16)    // Bytes copied at a time when the first records are dropped
+
+enum WAL_RECORD_TYPE {
+  WAL_CREATE = 1,  // An event was created
+  WAL_RESERVE,     // A reservation was made, followed by its runs of seats
+  WAL_RELEASE,     // The seats of a reservation were freed
+  WAL_RESET,       // Every seat of an event was freed and its reservation ids start over, in a change feed
+  WAL_SYNC,        // A change feed sent the whole state before it, and the changes that follow are new
+};
+
+// Record of a change to the state, as appended to the log. Records and runs take a
+// multiple of 8 bytes, so the size of a record is never split by the end of the ring.
+struct WalRecord {
+  uint32_t size;            /// Bytes of the record, including its runs of seats.
+  uint32_t checksum;        /// Checksum of the bytes of the record after the sequence.
+  uint64_t sequence;        /// Position of the record in a change feed, counted from 1 at each output it opens, 0 in a log.
+  uint16_t type;            /// Value of enum WAL_RECORD_TYPE.
+  uint16_t num_runs;        /// Number of runs of seats after the record.
+  uint32_t event_id;        /// Event id.
+  uint32_t reservation_id;  /// Id of the reservation, for WAL_RESERVE and WAL_RELEASE.
+  uint32_t time_ms;         /// Milliseconds of the monotonic clock, modulo 2^32, when a change feed took the record.
+  uint64_t rows;            /// Number of rows, for WAL_CREATE.
+  uint64_t cols;            /// Number of columns, for WAL_CREATE.
+};
+
+// Start of a log whose records before an LSN were dropped, once a checkpoint had them. A log
+// without it starts with the record at LSN 0.
+struct WalHeader {
+  uint32_t magic;    /// WAL_MAGIC, which is never the size of a record.
+  uint32_t padding;
+  uint64_t base;     /// LSN of the record after the header.
+};
+
+// Consecutive seats of a row taken by a WAL_RESERVE
+struct WalRun {
+  uint32_t row;        /// Row of the seats.
+  uint32_t first_col;  /// Column of the first seat.
+  uint32_t num_seats;  /// Number of seats.
+  uint32_t padding;
+};
+
+// Append-only log of the changes to the state. Workers copy their records to a ring
+// without locks, and a flusher thread writes every record that is complete with a
+// single write and fdatasync, so that many requests share the cost of each sync.
+// Positions in the log (LSNs) are offsets in its file, counted from the base of its header.
+typedef struct {
+  int fd;                          /// File descriptor of the log
+  char *path;                      /// Pathname of the log
+  char *temporary_path;            /// Pathname the records are copied to when the first ones are dropped
+  uint64_t base;                   /// LSN of the first record in the file
+  size_t header_size;              /// Bytes of the header of the file, 0 if it has none
+  unsigned char *ring;             /// Records not yet written, at their LSN modulo WAL_BUFFER_SIZE
+  atomic_uint_least64_t reserved;  /// LSN after the last record that a worker started appending
+  atomic_uint_least64_t durable;   /// Every record before this LSN is in the file
+  pthread_mutex_t mutex;           /// Mutex to wait for the flusher with
+  pthread_cond_t flushed;          /// Signaled when the durable LSN advances
+  pthread_cond_t wake;             /// Signaled when the flusher should write right away
+  int stop;                        /// Whether the flusher should terminate
+  int failed;                      /// Whether writing the log failed, after which nothing is durable
+  uint64_t truncate_lsn;           /// LSN the records before which should be dropped, 0 if none
+  int truncate_result;             /// 0 if the records were dropped, 1 otherwise
+  pthread_t thread;                /// The flusher thread
+} Wal;
+
+/// Computes the checksum of the bytes of a record after its header fields size, checksum and sequence.
+/// @param record The record.
+/// @return The checksum.
+uint32_t wal_checksum(const struct WalRecord *record);
+
+/// Function called with each record of a log that is replayed.
+/// @param record The record, followed by its runs of seats.
+/// @param arg Argument given to wal_replay.
+/// @return 0 to go on with the next record, 1 to stop the replay.
+typedef int (*wal_apply)(const struct WalRecord *record, void *arg);
+
+/// Reads the records of a log from an LSN, up to the first one that is torn or corrupted.
+/// @note The records are partitioned by event id among the threads, so the function is
+/// called concurrently for different events, but in the order of the log for each event.
+/// WAL_CREATE records are all applied first, in the order of the log.
+/// @param path Pathname of the log, which may not exist.
+/// @param start LSN of the first record to replay.
+/// @param num_threads Number of threads applying the records.
+/// @param apply Function called with each record.
+/// @param arg Argument given to the function.
+/// @param valid_size Variable to store the bytes of the header and valid records at the start of the file in.
+/// @return 0 if the log was replayed successfully, 1 otherwise, such as when the records from the
+/// LSN were dropped.
+int wal_replay(const char *path, uint64_t start, size_t num_threads, wal_apply apply, void *arg,
+               size_t *valid_size);
+
+/// Opens a log to append records after the ones it has, and starts the flusher.
+/// @param path Pathname of the log, created if it does not exist.
+/// @param valid_size Bytes of the header and valid records at the start of the file, the rest is discarded.
+/// @return The log, NULL on failure.
+Wal *wal_open(const char *path, size_t valid_size);
+
+/// Writes the remaining records, stops the flusher and closes the log.
+/// @param wal The log.
+void wal_close(Wal *wal);
+
+/// Appends a record to the log, without waiting for it to be written.
+/// @note Only waits if the ring is full. The size and checksum of the record are filled in.
+/// @param wal The log.
+/// @param record The record, followed by its runs of seats.
+/// @return The LSN after the record.
+uint64_t wal_append(Wal *wal, struct WalRecord *record);
+
+/// Gets the LSN after the last record that was appended.
+/// @param wal The log.
+/// @return The LSN.
+uint64_t wal_end(Wal *wal);
+
+/// Gets the LSN before which every record is in the file.
+/// @param wal The log.
+/// @return The LSN.
+uint64_t wal_durable(Wal *wal);
+
+/// Drops the records before an LSN, which a checkpoint has. The flusher copies the records after
+/// it to a new file, which replaces the log, so that the log does not keep growing.
+/// @param wal The log.
+/// @param lsn The LSN, before which every record must be durable.
+/// @return 0 if the records were dropped, 1 if the log was kept as it was.
+int wal_truncate(Wal *wal, uint64_t lsn);
+
+/// Waits for every record before an LSN to be in the file.
+/// @param wal The log.
+/// @param lsn The LSN.
+/// @return 0 if the records are durable, 1 if writing the log failed.
+int wal_wait(Wal *wal, uint64_t lsn);
+
+#endif  // SERVER_WAL_H
@@ -0,0 +1,172 @@
+#include "watch.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+// Queues the calling thread must wake up the workers of, once it releases the mutex of the event
+static _Thread_local WatchQueue **pending_wake_ups = NULL;
+static _Thread_local size_t num_pending_wake_ups = 0;
+static _Thread_local size_t pending_wake_ups_capacity = 0;
+
+/// Wakes up the worker of the session, unless it was already woken up.
+/// @param queue The queue with something to push.
+static void notify_worker(WatchQueue *queue) {
+  char byte = 0;
+  // The pipe is non-blocking, so a failed write means a notification is already pending
+  ssize_t written = write(queue->notify[1], &byte, 1);
+  (void)written;
+}
+
+/// Remembers to wake up the worker of a session in watch_flush.
+/// @note The mutex of the queue must be held.
+/// @param queue The queue with something to push.
+/// @return 0 if the wake-up was deferred, 1 if there was no memory to remember it.
+static int defer_wake_up(WatchQueue *queue) {
+  if (num_pending_wake_ups == pending_wake_ups_capacity) {
+    size_t capacity = pending_wake_ups_capacity > 0 ? pending_wake_ups_capacity * 2 : 16;
+    WatchQueue **queues = (WatchQueue **)realloc(pending_wake_ups, capacity * sizeof(WatchQueue *));
+    if (queues == NULL) {
+      return 1;
+    }
+    pending_wake_ups = queues;
+    pending_wake_ups_capacity = capacity;
+  }
+
+  pending_wake_ups[num_pending_wake_ups++] = queue;
+  queue->wake_ups++;
+  return 0;
+}
+
+WatchQueue *watch_queue_create() {
+  WatchQueue *queue = (WatchQueue *)malloc(sizeof(WatchQueue));
+  if (!queue) return NULL;
+
+  queue->head = 0;
+  queue->count = 0;
+  queue->num_subscriptions = 0;
+  atomic_init(&queue->resync_pending, 0);
+
+  queue->wake_ups = 0;
+
+  if (pthread_mutex_init(&queue->mutex, NULL) != 0) {
+    free(queue);
+    return NULL;
+  }
+
+  if (pthread_cond_init(&queue->woken, NULL) != 0) {
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue);
+    return NULL;
+  }
+
+  if (pipe(queue->notify) != 0) {
+    pthread_cond_destroy(&queue->woken);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue);
+    return NULL;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    int flags = fcntl(queue->notify[i], F_GETFL);
+    if (flags == -1 || fcntl(queue->notify[i], F_SETFL, flags | O_NONBLOCK) == -1) {
+      watch_queue_destroy(queue);
+      return NULL;
+    }
+  }
+
+  return queue;
+}
+
+void watch_queue_destroy(WatchQueue *queue) {
+  if (!queue) return;
+
+  // Nothing can publish to the queue anymore, but publishers may still have to wake it up
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->wake_ups > 0) {
+    pthread_cond_wait(&queue->woken, &queue->mutex);
+  }
+  pthread_mutex_unlock(&queue->mutex);
+
+  close(queue->notify[0]);
+  close(queue->notify[1]);
+  pthread_cond_destroy(&queue->woken);
+  pthread_mutex_destroy(&queue->mutex);
+  free(queue);
+}
+
+int watch_queue_fd(WatchQueue *queue) { return queue->notify[0]; }
+
+size_t watch_publish(WatchSubscription *watchers, const struct WatchDelta *deltas, size_t num_deltas) {
+  size_t fell_behind = 0;
+
+  for (WatchSubscription *watcher = watchers; watcher != NULL; watcher = watcher->next) {
+    WatchQueue *queue = watcher->queue;
+
+    // Deltas are pointless until the snapshot is taken, it already includes them
+    if (watcher->needs_resync) {
+      continue;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    int was_empty = queue->count == 0;
+    int fits = queue->count + num_deltas <= WATCH_QUEUE_SIZE;
+
+    if (fits) {
+      for (size_t i = 0; i < num_deltas; i++) {
+        queue->deltas[(queue->head + queue->count) % WATCH_QUEUE_SIZE] = deltas[i];
+        queue->count++;
+      }
+    }
+
+    // Writing to the pipe waits until the mutex of the event is released
+    int wake_up = !fits || was_empty;
+    int deferred = wake_up && defer_wake_up(queue) == 0;
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (!fits) {
+      watcher->needs_resync = 1;
+      atomic_store(&queue->resync_pending, 1);
+      fell_behind++;
+    }
+    if (wake_up && !deferred) {
+      notify_worker(queue);
+    }
+  }
+
+  return fell_behind;
+}
+
+void watch_flush() {
+  for (size_t i = 0; i < num_pending_wake_ups; i++) {
+    WatchQueue *queue = pending_wake_ups[i];
+    notify_worker(queue);
+
+    pthread_mutex_lock(&queue->mutex);
+    if (--queue->wake_ups == 0) {
+      pthread_cond_broadcast(&queue->woken);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+  }
+  num_pending_wake_ups = 0;
+}
+
+size_t watch_queue_take(WatchQueue *queue, struct WatchDelta *deltas, size_t max) {
+  char bytes[64];
+
+  // Cleared before looking at the ring, so that nothing queued afterwards is missed
+  while (read(queue->notify[0], bytes, sizeof(bytes)) > 0)
+    ;
+
+  pthread_mutex_lock(&queue->mutex);
+  size_t taken = queue->count < max ? queue->count : max;
+  for (size_t i = 0; i < taken; i++) {
+    deltas[i] = queue->deltas[queue->head];
+    queue->head = (queue->head + 1) % WATCH_QUEUE_SIZE;
+  }
+  queue->count -= taken;
+  pthread_mutex_unlock(&queue->mutex);
+
+  return taken;
+}
@@ -0,0 +1,78 @@
+#ifndef SERVER_WATCH_H
+#define SERVER_WATCH_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "common/constants.h"
+#include "common/watch.h"
+
+#define WATCH_QUEUE_SIZE 1024   // Deltas queued for a session before it must resync
+#define WATCH_BATCH_SIZE 64     // Deltas pushed to a session at a time
+
+struct Event;
+typedef struct WatchQueue WatchQueue;
+
+// Subscription of a session to the changes of an event
+typedef struct WatchSubscription {
+  struct Event *event;             /// Event being watched
+  WatchQueue *queue;               /// Queue of the watching session
+  int needs_resync;                /// Whether deltas were dropped, protected by the event mutex
+  struct WatchSubscription *next;  /// Next subscription to the same event
+} WatchSubscription;
+
+// Deltas waiting to be pushed to a watching session. Reservations only take the
+// queue mutex for as long as it takes to copy the deltas, so a slow watcher never
+// delays them: once its queue is full it is sent a snapshot of the event instead.
+// The worker of the session is woken up once the mutex of the event is released.
+struct WatchQueue {
+  pthread_mutex_t mutex;                                /// Mutex to protect the ring of deltas
+  pthread_cond_t woken;                                 /// Signaled when the last pending wake-up is sent
+  size_t wake_ups;                                      /// Wake-ups publishers still have to send
+  struct WatchDelta deltas[WATCH_QUEUE_SIZE];           /// Ring of queued deltas
+  size_t head;                                          /// Position of the oldest delta
+  size_t count;                                         /// Number of queued deltas
+  atomic_int resync_pending;                            /// Whether any subscription needs a resync
+  int notify[2];                                        /// Pipe that wakes up the worker of the session
+  WatchSubscription subscriptions[MAX_WATCHED_EVENTS];  /// Subscriptions of the session
+  size_t num_subscriptions;                             /// Number of subscriptions
+};
+
+/// Creates the queue of a session that starts watching events.
+/// @return Newly created queue, NULL on failure.
+WatchQueue *watch_queue_create();
+
+/// Deallocates a queue whose subscriptions were already removed from the events, once the
+/// publishers sent the wake-ups they owe it.
+/// @param queue The queue to be destroyed.
+void watch_queue_destroy(WatchQueue *queue);
+
+/// Gets the file descriptor that becomes readable when the queue has something to push.
+/// @param queue The queue to wait on.
+/// @return The file descriptor.
+int watch_queue_fd(WatchQueue *queue);
+
+/// Queues the deltas of a reservation for all the subscribers of an event.
+/// @note The mutex of the event must be held. The workers of the subscribers are only
+/// woken up by watch_flush, once it is released.
+/// @param watchers The subscriptions to the event.
+/// @param deltas The deltas of the reservation.
+/// @param num_deltas The number of deltas.
+/// @return Number of subscribers that fell behind and must resync.
+size_t watch_publish(WatchSubscription *watchers, const struct WatchDelta *deltas, size_t num_deltas);
+
+/// Wakes up the workers of the sessions the calling thread queued deltas for.
+/// @note Must be called after releasing the mutex of the event the deltas were published for.
+void watch_flush();
+
+/// Takes the oldest queued deltas.
+/// @note Clears the notification of the queue, so it must be called until it returns 0
+/// before waiting on the queue again.
+/// @param queue The queue to take the deltas from.
+/// @param deltas The array to store the deltas in.
+/// @param max The maximum number of deltas to take.
+/// @return Number of deltas taken.
+size_t watch_queue_take(WatchQueue *queue, struct WatchDelta *deltas, size_t max);
+
+#endif  // SERVER_WATCH_H